@@ -59,8 +59,10 @@ class _MyHomePageState extends State<MyHomePage> {
     if (data == null) {
       return;
     }
-    int newHumidity = data[0];
-    double newTemperature = (data[3].toDouble() + data[2].toDouble() / 10) * 1.8 + 32;
+    // little endian hundredths of a degree celsius and of a percent
+    int centiCelsius = (data[0] | (data[1] << 8)).toSigned(16);
+    int newHumidity = ((data[2] | (data[3] << 8)) / 100).round();
+    double newTemperature = centiCelsius / 100 * 1.8 + 32;
     setState(() {
       temperature = newTemperature;
       humidity = newHumidity;
@@ -0,0 +1,13 @@
+// new readings are pushed by the server, the browser reconnects on its own
+const live = new EventSource("/api/live");
+live.onmessage = (event) => {
+    const sample = JSON.parse(event.data);
+    const pad = (value) => String(Math.round(value)).padStart(2, "0");
+    document.getElementById("fh").textContent = pad(sample.temperature * 1.8 + 32);
+    document.getElementById("cs").textContent = pad(sample.temperature);
+    document.getElementById("hm").textContent = pad(sample.humidity);
+    if (sample.pressure !== undefined) {
+        document.getElementById("pr").textContent = sample.pressure.toFixed(1);
+        document.getElementById("pressure").hidden = false;
+    }
+};
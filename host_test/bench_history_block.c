@@ -0,0 +1,159 @@
+// Compression and speed of the history blocks over a year of one-minute
+// samples with a daily cycle, sensor noise, outages and clock steps. The
+// samples are encoded into blocks and decoded again, then appended through
+// history_append to a history partition image and exported as CSV.
+//
+//   bench_history_block [days]
+//
+// Sizes are what the device stores, times are those of the host.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "check.h"
+#include "dht_waveform.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "history.h"
+#include "history_block.h"
+#include "retained.h"
+
+#define DEFAULT_DAYS 365
+#define START_TIME 1704067200 // 2024-01-01
+#define SAMPLE_PERIOD 60
+// size in partitions.csv
+#define HISTORY_PARTITION_SIZE (768 * 1024)
+// the fixed record history used before the blocks: timestamp, temperature and humidity
+#define FIXED_RECORD_LEN 8
+
+static uint32_t seed = 29;
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// a DHT22 in a room: a daily swing in tenths of a degree and of a percent,
+// flickering by one step now and then
+static size_t generate(struct history_record *records, int days) {
+    size_t count = 0;
+    uint32_t end = START_TIME + days * 86400;
+    for (uint32_t t = START_TIME; t < end; t += SAMPLE_PERIOD) {
+        uint32_t day = (t - START_TIME) / 86400;
+        uint32_t phase = t % 86400;
+        int32_t triangle = phase < 43200 ? phase : 86400 - phase;
+        uint32_t r = dht_waveform_random(&seed);
+
+        // an evening without power every month and a half
+        if (day % 45 == 20 && phase >= 64800 && phase < 79200) continue;
+        struct history_record record = {
+            .timestamp = t,
+            .sd = {
+                .temperature = (1800 + triangle / 90) / 10 * 10 + (r % 16 == 0 ? 10 : 0),
+                .humidity = (5500 - triangle / 40) / 10 * 10 + ((r >> 8) % 16 == 0 ? 10 : 0),
+                .channels = SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY
+            }
+        };
+        // SNTP steps the clock by a second or two every few days
+        if ((r >> 16) % 5000 == 0) {
+            record.timestamp += 1 + (r >> 24) % 2;
+        }
+        records[count++] = record;
+    }
+    return count;
+}
+
+static size_t encode(const struct history_record *records, size_t count, struct history_block *blocks) {
+    struct history_block_state state;
+    size_t num_blocks = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (num_blocks == 0 || !history_block_append(&blocks[num_blocks - 1], &state, &records[i])) {
+            history_block_start(&blocks[num_blocks++], &state, &records[i]);
+        }
+    }
+    return num_blocks;
+}
+
+static size_t decode(const struct history_block *blocks, size_t num_blocks, struct history_record *records) {
+    struct history_block_state state;
+    size_t count = 0;
+    for (size_t b = 0; b < num_blocks; b++) {
+        history_block_reader_init(&blocks[b], &state);
+        while (history_block_next(&blocks[b], &state, &records[count])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    int days = argc > 1 ? atoi(argv[1]) : DEFAULT_DAYS;
+    CHECK(days > 0);
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    size_t max_records = (size_t)days * 86400 / SAMPLE_PERIOD;
+    struct history_record *records = malloc(max_records * sizeof(*records));
+    struct history_record *decoded = malloc(max_records * sizeof(*decoded));
+    struct history_block *blocks = malloc(max_records * sizeof(*blocks));
+    CHECK(records != NULL && decoded != NULL && blocks != NULL);
+    size_t count = generate(records, days);
+
+    int64_t start = now_ns();
+    size_t num_blocks = encode(records, count, blocks);
+    int64_t encode_ns = now_ns() - start;
+    start = now_ns();
+    CHECK(decode(blocks, num_blocks, decoded) == count);
+    int64_t decode_ns = now_ns() - start;
+    for (size_t i = 0; i < count; i++) {
+        CHECK(decoded[i].timestamp == records[i].timestamp);
+        CHECK(decoded[i].sd.temperature == records[i].sd.temperature);
+        CHECK(decoded[i].sd.humidity == records[i].sd.humidity);
+    }
+
+    // the same samples through the firmware's history into flash, then exported
+    retained_init();
+    CHECK(host_partition_create("history", HISTORY_PARTITION_SIZE, NULL) != NULL);
+    history_init();
+    start = now_ns();
+    for (size_t i = 0; i < count; i++) {
+        history_append(records[i].timestamp, records[i].sd);
+    }
+    int64_t append_ns = now_ns() - start;
+
+    struct history_cursor cursor;
+    struct history_record batch[32];
+    char line[HISTORY_CSV_LINE_LEN];
+    size_t exported = 0, csv_bytes = 0, n;
+    uint32_t first = 0, last = 0;
+    history_cursor_init(&cursor);
+    start = now_ns();
+    while ((n = history_read(&cursor, batch, 32)) > 0) {
+        if (exported == 0) first = batch[0].timestamp;
+        for (size_t i = 0; i < n; i++) {
+            csv_bytes += history_format_csv(batch[i], line, sizeof(line));
+        }
+        last = batch[n - 1].timestamp;
+        exported += n;
+    }
+    int64_t export_ns = now_ns() - start;
+    CHECK(exported > 0 && last == records[count - 1].timestamp);
+
+    double stored = (double)num_blocks * sizeof(struct history_block) / count;
+    printf("%zu samples over %d days in %zu blocks, all round tripped\n", count, days, num_blocks);
+    printf("%.2f B/sample, %.1fx smaller than the %d-byte record and %.1fx smaller than CSV\n",
+        stored, FIXED_RECORD_LEN / stored, FIXED_RECORD_LEN, (double)csv_bytes / exported / stored);
+    printf("encode %.1f M samples/s, decode %.1f M samples/s\n",
+        count * 1e3 / encode_ns, count * 1e3 / decode_ns);
+    printf("history_append %.2f M samples/s, CSV export %.2f M samples/s\n",
+        count * 1e3 / append_ns, exported * 1e3 / export_ns);
+    printf("the %d KB partition holds the last %.0f days (%zu samples)\n",
+        HISTORY_PARTITION_SIZE / 1024, (last - first) / 86400.0, exported);
+
+    free(records);
+    free(decoded);
+    free(blocks);
+    return 0;
+}
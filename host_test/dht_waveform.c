@@ -0,0 +1,61 @@
+#include "dht_waveform.h"
+
+// datasheet timings, the start tail is whatever the receiver saw of the host's pulse
+#define START_TAIL_US 12
+#define PULL_UP_US 30
+#define RESPONSE_US 80
+#define BIT_LOW_US 50
+#define BIT_ZERO_US 27
+#define BIT_ONE_US 70
+
+uint32_t dht_waveform_random(uint32_t *seed) {
+    // xorshift32, so a failing case replays from its seed
+    uint32_t x = *seed ? *seed : 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+void dht_waveform_frame(uint8_t frame[DHT_FRAME_LEN], uint8_t humidity, uint8_t humidity_low, uint8_t temperature, uint8_t temperature_low) {
+    frame[0] = humidity;
+    frame[1] = humidity_low;
+    frame[2] = temperature;
+    frame[3] = temperature_low;
+    frame[4] = humidity + humidity_low + temperature + temperature_low;
+}
+
+static void add_pulse(struct dht_pulse *pulses, size_t *num_pulses, struct dht_waveform_options *options, uint8_t level, uint16_t duration_us) {
+    if (options->jitter_us > 0) {
+        int span = 2 * options->jitter_us + 1;
+        duration_us += (int)(dht_waveform_random(&options->seed) % span) - options->jitter_us;
+    }
+    pulses[(*num_pulses)++] = (struct dht_pulse){level, duration_us};
+}
+
+size_t dht_waveform(const uint8_t frame[DHT_FRAME_LEN], struct dht_waveform_options *options, struct dht_pulse *pulses) {
+    size_t num_pulses = 0;
+    add_pulse(pulses, &num_pulses, options, 0, START_TAIL_US);
+    if (options->no_response) {
+        return num_pulses;
+    }
+    add_pulse(pulses, &num_pulses, options, 1, PULL_UP_US);
+    add_pulse(pulses, &num_pulses, options, 0, RESPONSE_US);
+    add_pulse(pulses, &num_pulses, options, 1, RESPONSE_US);
+
+    int num_bits = options->truncate_bits >= 0 ? options->truncate_bits : DHT_FRAME_LEN * 8;
+    for (int bit = 0; bit < num_bits; bit++) {
+        uint8_t byte = frame[bit / 8];
+        if (bit / 8 == DHT_FRAME_LEN - 1 && options->bad_checksum) {
+            byte ^= 0x01;
+        }
+        add_pulse(pulses, &num_pulses, options, 0, BIT_LOW_US);
+        add_pulse(pulses, &num_pulses, options, 1, (byte >> (7 - bit % 8)) & 1 ? BIT_ONE_US : BIT_ZERO_US);
+    }
+    // the sensor releases the bus after a last low, the idle high ends the capture
+    if (num_bits == DHT_FRAME_LEN * 8) {
+        add_pulse(pulses, &num_pulses, options, 0, BIT_LOW_US);
+    }
+    return num_pulses;
+}
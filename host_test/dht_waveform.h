@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dht.h"
+
+// Pulse trains of a DHT11/DHT22 answering a start pulse, as the RMT
+// receiver records them: the tail of the start pulse, the sensor pulling
+// the bus up, the 80 us low / 80 us high response and the 40 data bits.
+
+#define DHT_WAVEFORM_MAX_PULSES 96
+
+struct dht_waveform_options {
+    // every pulse is off by up to this much either way
+    uint16_t jitter_us;
+    // the sensor stops answering after this many bits, -1 sends them all
+    int truncate_bits;
+    // the sensor never answers the start pulse
+    bool no_response;
+    // the last byte doesn't match the sum of the others
+    bool bad_checksum;
+    // state of the pseudo random jitter, changed by every call
+    uint32_t seed;
+};
+
+void dht_waveform_frame(uint8_t frame[DHT_FRAME_LEN], uint8_t humidity, uint8_t humidity_low, uint8_t temperature, uint8_t temperature_low);
+size_t dht_waveform(const uint8_t frame[DHT_FRAME_LEN], struct dht_waveform_options *options, struct dht_pulse *pulses);
+uint32_t dht_waveform_random(uint32_t *seed);
@@ -0,0 +1,120 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "lcd_recorder.h"
+
+// wiring and timings of lcd.c and the datasheet
+#define RS 23
+#define RW 22
+#define E 21
+#define DDRAM_SIZE 0x80
+#define LINE_LEN 0x28
+#define EXEC_US 37
+#define CLEAR_US 1520
+
+static const gpio_num_t data_pins[8] = {19, 18, 17, 16, 4, 15, 13, 27};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t pins[GPIO_NUM_MAX];
+static char ddram[DDRAM_SIZE];
+static uint8_t address = 0;
+static bool increment = true;
+static bool display_on = false;
+static int64_t busy_until_us = 0;
+static struct lcd_recorder_stats stats;
+
+// the second line starts at 0x40, each line holds 40 characters
+static uint8_t next_address(uint8_t current) {
+    if (current == LINE_LEN - 1) return 0x40;
+    if (current == 0x40 + LINE_LEN - 1) return 0x00;
+    return current + 1;
+}
+
+static uint8_t previous_address(uint8_t current) {
+    if (current == 0x00) return 0x40 + LINE_LEN - 1;
+    if (current == 0x40) return LINE_LEN - 1;
+    return current - 1;
+}
+
+static void execute(bool rs, uint8_t value) {
+    int64_t now_us = esp_timer_get_time();
+    if (now_us < busy_until_us) {
+        stats.busy_violations++;
+        return;
+    }
+    busy_until_us = now_us + EXEC_US;
+
+    if (rs) {
+        ddram[address] = value;
+        address = increment ? next_address(address) : previous_address(address);
+        stats.data_writes++;
+        return;
+    }
+
+    stats.instructions++;
+    if (value & 0x80) {
+        address = value & 0x7F;
+    } else if (value & 0x40) {
+        // character generator RAM, not modelled
+    } else if (value & 0x20) {
+        // function set, lcd.c always asks for 8 bits and two lines
+    } else if (value & 0x10) {
+        // cursor or display shift, not modelled
+    } else if (value & 0x08) {
+        display_on = value & 0x04;
+    } else if (value & 0x04) {
+        increment = value & 0x02;
+    } else if (value & 0x02) {
+        address = 0;
+        busy_until_us = now_us + CLEAR_US;
+    } else if (value & 0x01) {
+        memset(ddram, ' ', sizeof(ddram));
+        address = 0;
+        increment = true;
+        busy_until_us = now_us + CLEAR_US;
+        stats.clears++;
+    }
+}
+
+static void on_level(gpio_num_t pin, uint32_t level, void *ctx) {
+    pthread_mutex_lock(&lock);
+    bool falling = pin == E && pins[E] && !level;
+    pins[pin] = level;
+    if (falling) {
+        if (pins[RW]) {
+            stats.reads++;
+        } else {
+            uint8_t value = 0;
+            for (int i = 0; i < 8; i++) {
+                value |= pins[data_pins[i]] << i;
+            }
+            execute(pins[RS], value);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void lcd_recorder_init() {
+    // what the controller holds after power-on
+    memset(ddram, ' ', sizeof(ddram));
+    host_gpio_set_listener(on_level, NULL);
+}
+
+void lcd_recorder_line(int row, char line[LCD_COLS + 1]) {
+    pthread_mutex_lock(&lock);
+    memcpy(line, ddram + (row == 0 ? 0x00 : 0x40), LCD_COLS);
+    pthread_mutex_unlock(&lock);
+    line[LCD_COLS] = '\0';
+}
+
+bool lcd_recorder_display_on() {
+    return display_on;
+}
+
+void lcd_recorder_get_stats(struct lcd_recorder_stats *out) {
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lcd.h"
+
+// An HD44780 on the parallel bus lcd.c drives. Pin changes are taken from
+// the GPIO stand-in, every falling edge of E latches RS and D0-D7 into the
+// controller model, and writes that come before the previous instruction
+// had time to execute are counted instead of being obeyed.
+
+struct lcd_recorder_stats {
+    uint32_t instructions;
+    uint32_t data_writes;
+    uint32_t clears;
+    // E fell while RW was high, a read the 5 V display would drive onto the bus
+    uint32_t reads;
+    // instructions latched while the controller was still busy
+    uint32_t busy_violations;
+};
+
+void lcd_recorder_init();
+// the 16 characters shown on a row, terminated
+void lcd_recorder_line(int row, char line[LCD_COLS + 1]);
+bool lcd_recorder_display_on();
+void lcd_recorder_get_stats(struct lcd_recorder_stats *stats);
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Load test the host build of the web server against the committed baseline.
+
+Starts sim_http_server, runs tools/http_bench.py on it with its peak memory
+and compares the results to http_bench_baseline.json. Host timings vary from
+machine to machine and run to run, so only a path that got several times
+worse fails the run. The server is then stopped in the middle of a log
+download by a client that stopped reading, which must not hold it up.
+After a deliberate change, record a new baseline:
+
+    python3 host_test/run_http_bench.py build_host/sim_http_server --update
+"""
+
+import argparse
+import os
+import signal
+import socket
+import subprocess
+import sys
+import urllib.parse
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+HTTP_BENCH = os.path.join(HERE, "..", "tools", "http_bench.py")
+BASELINE = os.path.join(HERE, "http_bench_baseline.json")
+CLIENTS = 3
+DURATION_S = 2
+DAYS = 30
+# a path fails when it is this much worse than the baseline, 2 is three times as bad
+TOLERANCE = 2
+STOP_TIMEOUT_S = 10
+STALLED_RCVBUF = 4096
+
+
+def start_stalled_download(url):
+    # a small receive window, so the server is soon blocked sending to it
+    base = urllib.parse.urlsplit(url)
+    client = socket.socket()
+    client.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, STALLED_RCVBUF)
+    client.connect((base.hostname, base.port))
+    client.sendall(b"GET /log.csv HTTP/1.1\r\nHost: bench\r\n\r\n")
+    client.recv(1)
+    return client
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("server", help="the sim_http_server program")
+    parser.add_argument("--update", action="store_true", help="write the results as the new baseline")
+    args = parser.parse_args()
+
+    server = subprocess.Popen([args.server, "0", str(DAYS)], stdout=subprocess.PIPE, text=True)
+    line = server.stdout.readline()
+    if not line.startswith("listening on "):
+        server.kill()
+        sys.exit(f"{args.server} didn't start: {line!r}")
+    url = line.split()[-1]
+
+    command = [sys.executable, HTTP_BENCH, url, "--no-memory", "--server-pid", str(server.pid),
+               "--clients", str(CLIENTS), "--duration", str(DURATION_S)]
+    if args.update:
+        command += ["--output", BASELINE]
+    else:
+        command += ["--baseline", BASELINE, "--tolerance", str(TOLERANCE)]
+    stalled = None
+    try:
+        bench = subprocess.run(command)
+        stalled = start_stalled_download(url)
+    finally:
+        server.send_signal(signal.SIGTERM)
+        try:
+            stopped = server.wait(STOP_TIMEOUT_S)
+        except subprocess.TimeoutExpired:
+            server.kill()
+            stopped = "timeout"
+        if stalled is not None:
+            stalled.close()
+    if stopped != 0:
+        sys.exit(f"the server didn't stop cleanly: {stopped}")
+    sys.exit(bench.returncode)
+
+
+if __name__ == "__main__":
+    main()
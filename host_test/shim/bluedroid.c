@@ -0,0 +1,441 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gatt_common_api.h"
+#include "esp_gatts_api.h"
+#include "freertos/FreeRTOS.h"
+
+#define MAX_ATTRS 32
+#define EVENT_QUEUE_LEN 16
+#define FIRST_HANDLE 40
+#define GATTS_IF 3
+#define CONN_ID 0
+#define DEFAULT_MTU 23
+#define SENDABLE_PACKETS 10
+
+enum event_kind {
+    EVENT_GATTS,
+    EVENT_GAP,
+    EVENT_SYNC
+};
+
+struct event {
+    enum event_kind kind;
+    int event;
+    union {
+        esp_ble_gatts_cb_param_t gatts;
+        esp_ble_gap_cb_param_t gap;
+        SemaphoreHandle_t done;
+    } param;
+    // what the value and handle pointers of the parameters point at
+    uint8_t value[ESP_GATT_MAX_ATTR_LEN];
+    uint16_t handles[MAX_ATTRS];
+};
+
+struct attr {
+    uint16_t uuid;
+    uint16_t perm;
+    uint8_t auto_rsp;
+    uint16_t max_length;
+    uint16_t length;
+    uint8_t value[ESP_GATT_MAX_ATTR_LEN];
+    uint32_t sent;
+    uint16_t last_sent_len;
+    uint8_t last_sent[ESP_GATT_MAX_ATTR_LEN];
+};
+
+static esp_gatts_cb_t gatts_callback = NULL;
+static esp_gap_ble_cb_t gap_callback = NULL;
+static QueueHandle_t events = NULL;
+
+// the attribute table and connection, shared by the BTC task, the tasks
+// sending notifications and the test
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct attr attrs[MAX_ATTRS];
+static uint16_t num_attrs = 0;
+static bool connected = false;
+static uint16_t mtu = DEFAULT_MTU;
+static uint16_t local_mtu = DEFAULT_MTU;
+
+// reads answered by the application
+static uint32_t next_trans_id = 1;
+static uint32_t read_trans_id = 0;
+static SemaphoreHandle_t read_done = NULL;
+static esp_gatt_status_t read_status;
+static esp_gatt_rsp_t read_rsp;
+
+static void btc_task(void *parameter) {
+    static struct event event;
+    while (1) {
+        xQueueReceive(events, &event, portMAX_DELAY);
+        switch (event.kind) {
+            case EVENT_GATTS: {
+                // the written value is handed over in a buffer of exactly its
+                // length, so the sanitizers catch reads past what the client sent
+                uint8_t *written = NULL;
+                if (event.event == ESP_GATTS_WRITE_EVT) {
+                    written = malloc(event.param.gatts.write.len);
+                    memcpy(written, event.value, event.param.gatts.write.len);
+                    event.param.gatts.write.value = written;
+                } else if (event.event == ESP_GATTS_CREAT_ATTR_TAB_EVT) {
+                    event.param.gatts.add_attr_tab.handles = event.handles;
+                }
+                if (gatts_callback != NULL) {
+                    gatts_callback(event.event, GATTS_IF, &event.param.gatts);
+                }
+                free(written);
+                break;
+            }
+            case EVENT_GAP:
+                if (gap_callback != NULL) {
+                    gap_callback(event.event, &event.param.gap);
+                }
+                break;
+            case EVENT_SYNC:
+                xSemaphoreGive(event.param.done);
+                break;
+        }
+    }
+}
+
+static void post(struct event *event) {
+    xQueueSend(events, event, portMAX_DELAY);
+}
+
+static void post_gatts(esp_gatts_cb_event_t type, const esp_ble_gatts_cb_param_t *param) {
+    struct event event = {
+        .kind = EVENT_GATTS,
+        .event = type,
+        .param.gatts = *param
+    };
+    if (type == ESP_GATTS_WRITE_EVT) {
+        memcpy(event.value, param->write.value, param->write.len);
+    } else if (type == ESP_GATTS_CREAT_ATTR_TAB_EVT) {
+        memcpy(event.handles, param->add_attr_tab.handles, param->add_attr_tab.num_handle * sizeof(uint16_t));
+    }
+    post(&event);
+}
+
+static void post_gap(esp_gap_ble_cb_event_t type) {
+    struct event event = {
+        .kind = EVENT_GAP,
+        .event = type
+    };
+    post(&event);
+}
+
+// must be called with the lock held
+static struct attr *find(uint16_t handle) {
+    if (handle < FIRST_HANDLE || handle >= FIRST_HANDLE + num_attrs) {
+        return NULL;
+    }
+    return &attrs[handle - FIRST_HANDLE];
+}
+
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *cfg) {
+    return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode) {
+    return mode == ESP_BT_MODE_BLE ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_bluedroid_init_with_cfg(esp_bluedroid_config_t *cfg) {
+    if (events != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    events = xQueueCreate(EVENT_QUEUE_LEN, sizeof(struct event));
+    read_done = xSemaphoreCreateBinary();
+    return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_enable() {
+    if (events == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xTaskCreate(btc_task, "BTC_TASK", 4096, NULL, 19, NULL);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback) {
+    gap_callback = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_set_device_name(const char *name) {
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_config_adv_data(esp_ble_adv_data_t *adv_data) {
+    post_gap(ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params) {
+    post_gap(ESP_GAP_BLE_ADV_START_COMPLETE_EVT);
+    return ESP_OK;
+}
+
+uint16_t esp_ble_get_cur_sendable_packets_num(uint16_t conn_id) {
+    return connected ? SENDABLE_PACKETS : 0;
+}
+
+esp_err_t esp_ble_gatt_set_local_mtu(uint16_t new_mtu) {
+    local_mtu = new_mtu;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_register_callback(esp_gatts_cb_t callback) {
+    gatts_callback = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_app_register(uint16_t app_id) {
+    esp_ble_gatts_cb_param_t param = {.reg = {.status = ESP_GATT_OK, .app_id = app_id}};
+    post_gatts(ESP_GATTS_REG_EVT, &param);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_create_attr_tab(const esp_gatts_attr_db_t *gatts_attr_db, esp_gatt_if_t gatts_if, uint16_t max_nb_attr, uint8_t srvc_inst_id) {
+    uint16_t handles[MAX_ATTRS];
+    if (max_nb_attr > MAX_ATTRS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&lock);
+    num_attrs = max_nb_attr;
+    for (uint16_t i = 0; i < max_nb_attr; i++) {
+        const esp_attr_desc_t *desc = &gatts_attr_db[i].att_desc;
+        struct attr *attr = &attrs[i];
+        memset(attr, 0, sizeof(*attr));
+        attr->uuid = desc->uuid_length == ESP_UUID_LEN_16 ? desc->uuid_p[0] | desc->uuid_p[1] << 8 : 0;
+        attr->perm = desc->perm;
+        attr->auto_rsp = gatts_attr_db[i].attr_control.auto_rsp;
+        attr->max_length = desc->max_length;
+        attr->length = desc->length;
+        memcpy(attr->value, desc->value, desc->length);
+        handles[i] = FIRST_HANDLE + i;
+    }
+    pthread_mutex_unlock(&lock);
+
+    esp_ble_gatts_cb_param_t param = {
+        .add_attr_tab = {
+            .status = ESP_GATT_OK,
+            .svc_uuid = attrs[0].length == 2 ? attrs[0].value[0] | attrs[0].value[1] << 8 : 0,
+            .svc_inst_id = srvc_inst_id,
+            .num_handle = max_nb_attr,
+            .handles = handles
+        }
+    };
+    post_gatts(ESP_GATTS_CREAT_ATTR_TAB_EVT, &param);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_start_service(uint16_t service_handle) {
+    esp_ble_gatts_cb_param_t param = {.start = {.status = ESP_GATT_OK, .service_handle = service_handle}};
+    post_gatts(ESP_GATTS_START_EVT, &param);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_set_attr_value(uint16_t attr_handle, uint16_t length, const uint8_t *value) {
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&lock);
+    struct attr *attr = find(attr_handle);
+    if (attr == NULL) {
+        err = ESP_ERR_INVALID_ARG;
+    } else if (length > attr->max_length) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        memcpy(attr->value, value, length);
+        attr->length = length;
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id, uint16_t attr_handle, uint16_t value_len, uint8_t *value, bool need_confirm) {
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&lock);
+    struct attr *attr = find(attr_handle);
+    if (gatts_if != GATTS_IF || conn_id != CONN_ID || !connected) {
+        err = ESP_FAIL;
+    } else if (attr == NULL) {
+        err = ESP_ERR_INVALID_ARG;
+    } else {
+        // the stack cuts what doesn't fit in one packet
+        if (value_len > mtu - 3) {
+            value_len = mtu - 3;
+        }
+        memcpy(attr->last_sent, value, value_len);
+        attr->last_sent_len = value_len;
+        attr->sent++;
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t esp_ble_gatts_send_response(esp_gatt_if_t gatts_if, uint16_t conn_id, uint32_t trans_id, esp_gatt_status_t status, esp_gatt_rsp_t *rsp) {
+    pthread_mutex_lock(&lock);
+    bool expected = trans_id == read_trans_id;
+    if (expected) {
+        read_status = status;
+        read_rsp = *rsp;
+        read_trans_id = 0;
+    }
+    pthread_mutex_unlock(&lock);
+    if (!expected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreGive(read_done);
+    return ESP_OK;
+}
+
+void host_ble_sync() {
+    SemaphoreHandle_t done = xSemaphoreCreateBinary();
+    struct event event = {
+        .kind = EVENT_SYNC,
+        .param.done = done
+    };
+    post(&event);
+    xSemaphoreTake(done, portMAX_DELAY);
+    vSemaphoreDelete(done);
+}
+
+void host_ble_connect(uint16_t client_mtu) {
+    pthread_mutex_lock(&lock);
+    connected = true;
+    mtu = DEFAULT_MTU;
+    pthread_mutex_unlock(&lock);
+    esp_ble_gatts_cb_param_t param = {.connect = {.conn_id = CONN_ID}};
+    post_gatts(ESP_GATTS_CONNECT_EVT, &param);
+
+    if (client_mtu > DEFAULT_MTU) {
+        pthread_mutex_lock(&lock);
+        mtu = client_mtu < local_mtu ? client_mtu : local_mtu;
+        param.mtu.conn_id = CONN_ID;
+        param.mtu.mtu = mtu;
+        pthread_mutex_unlock(&lock);
+        post_gatts(ESP_GATTS_MTU_EVT, &param);
+    }
+    host_ble_sync();
+}
+
+void host_ble_disconnect() {
+    pthread_mutex_lock(&lock);
+    connected = false;
+    pthread_mutex_unlock(&lock);
+    esp_ble_gatts_cb_param_t param = {.disconnect = {.conn_id = CONN_ID, .reason = 0x13}};
+    post_gatts(ESP_GATTS_DISCONNECT_EVT, &param);
+    host_ble_sync();
+}
+
+esp_gatt_status_t host_ble_write(uint16_t handle, const uint8_t *value, uint16_t len) {
+    esp_gatt_status_t status = ESP_GATT_OK;
+    pthread_mutex_lock(&lock);
+    struct attr *attr = find(handle);
+    if (attr == NULL) {
+        status = ESP_GATT_INVALID_HANDLE;
+    } else if (!(attr->perm & ESP_GATT_PERM_WRITE)) {
+        status = ESP_GATT_WRITE_NOT_PERMIT;
+    } else if (len > attr->max_length) {
+        status = ESP_GATT_INVALID_ATTR_LEN;
+    } else if (attr->auto_rsp) {
+        memcpy(attr->value, value, len);
+        attr->length = len;
+    }
+    pthread_mutex_unlock(&lock);
+    if (status != ESP_GATT_OK) {
+        return status;
+    }
+
+    esp_ble_gatts_cb_param_t param = {
+        .write = {
+            .conn_id = CONN_ID,
+            .trans_id = next_trans_id++,
+            .handle = handle,
+            .len = len,
+            .value = (uint8_t *)value
+        }
+    };
+    post_gatts(ESP_GATTS_WRITE_EVT, &param);
+    host_ble_sync();
+    return ESP_GATT_OK;
+}
+
+esp_gatt_status_t host_ble_read(uint16_t handle, uint16_t offset, uint8_t *value, uint16_t *len) {
+    pthread_mutex_lock(&lock);
+    struct attr *attr = find(handle);
+    esp_gatt_status_t status = ESP_GATT_OK;
+    bool by_app = false;
+    if (attr == NULL) {
+        status = ESP_GATT_INVALID_HANDLE;
+    } else if (!(attr->perm & ESP_GATT_PERM_READ)) {
+        status = ESP_GATT_READ_NOT_PERMIT;
+    } else if (attr->auto_rsp) {
+        if (offset > attr->length) {
+            status = ESP_GATT_INVALID_OFFSET;
+        } else {
+            *len = attr->length - offset;
+            if (*len > mtu - 1) {
+                *len = mtu - 1;
+            }
+            memcpy(value, attr->value + offset, *len);
+        }
+    } else {
+        by_app = true;
+        read_trans_id = next_trans_id++;
+    }
+    pthread_mutex_unlock(&lock);
+    if (!by_app) {
+        return status;
+    }
+
+    esp_ble_gatts_cb_param_t param = {
+        .read = {
+            .conn_id = CONN_ID,
+            .trans_id = read_trans_id,
+            .handle = handle,
+            .offset = offset,
+            .is_long = offset > 0,
+            .need_rsp = true
+        }
+    };
+    post_gatts(ESP_GATTS_READ_EVT, &param);
+    xSemaphoreTake(read_done, portMAX_DELAY);
+    if (read_status == ESP_GATT_OK) {
+        *len = read_rsp.attr_value.len;
+        memcpy(value, read_rsp.attr_value.value, *len);
+    }
+    return read_status;
+}
+
+uint16_t host_ble_find_handle(uint16_t uuid) {
+    uint16_t handle = 0;
+    pthread_mutex_lock(&lock);
+    for (uint16_t i = 0; i < num_attrs && handle == 0; i++) {
+        if (attrs[i].uuid == uuid) {
+            handle = FIRST_HANDLE + i;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return handle;
+}
+
+uint32_t host_ble_sent(uint16_t handle, uint8_t *value, uint16_t *len) {
+    uint32_t sent = 0;
+    pthread_mutex_lock(&lock);
+    struct attr *attr = find(handle);
+    if (attr != NULL) {
+        sent = attr->sent;
+        if (value != NULL) {
+            memcpy(value, attr->last_sent, attr->last_sent_len);
+            *len = attr->last_sent_len;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return sent;
+}
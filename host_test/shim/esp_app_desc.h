@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// The part of the application description the firmware reads.
+
+typedef struct {
+    char version[32];
+    char project_name[32];
+    uint8_t app_elf_sha256[32];
+} esp_app_desc_t;
+
+const esp_app_desc_t *esp_app_get_description();
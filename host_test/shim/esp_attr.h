@@ -0,0 +1,11 @@
+#pragma once
+
+// Placement attributes of esp_attr.h. The host has no RTC memory, so
+// retained variables are ordinary statics that survive a simulated reboot
+// because the process does. They are gathered in a section of their own
+// for host_power_cut to scramble.
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR __attribute__((section("rtc_noinit")))
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+#define ESP_BD_ADDR_LEN 6
+
+#define ESP_UUID_LEN_16 2
+#define ESP_UUID_LEN_32 4
+#define ESP_UUID_LEN_128 16
+
+typedef uint8_t esp_bd_addr_t[ESP_BD_ADDR_LEN];
+
+typedef enum {
+    BLE_ADDR_TYPE_PUBLIC = 0x00,
+    BLE_ADDR_TYPE_RANDOM = 0x01
+} esp_ble_addr_type_t;
@@ -0,0 +1,35 @@
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+struct err_name {
+    esp_err_t code;
+    const char *name;
+};
+
+static const struct err_name err_names[] = {
+    {ESP_OK, "ESP_OK"},
+    {ESP_FAIL, "ESP_FAIL"},
+    {ESP_ERR_NO_MEM, "ESP_ERR_NO_MEM"},
+    {ESP_ERR_INVALID_ARG, "ESP_ERR_INVALID_ARG"},
+    {ESP_ERR_INVALID_STATE, "ESP_ERR_INVALID_STATE"},
+    {ESP_ERR_INVALID_SIZE, "ESP_ERR_INVALID_SIZE"},
+    {ESP_ERR_NOT_FOUND, "ESP_ERR_NOT_FOUND"},
+    {ESP_ERR_NOT_SUPPORTED, "ESP_ERR_NOT_SUPPORTED"},
+    {ESP_ERR_TIMEOUT, "ESP_ERR_TIMEOUT"},
+    {ESP_ERR_INVALID_RESPONSE, "ESP_ERR_INVALID_RESPONSE"},
+    {ESP_ERR_INVALID_CRC, "ESP_ERR_INVALID_CRC"},
+    {ESP_ERR_HTTPD_RESULT_TRUNC, "ESP_ERR_HTTPD_RESULT_TRUNC"},
+    {ESP_ERR_HTTPD_RESP_HDR, "ESP_ERR_HTTPD_RESP_HDR"},
+    {ESP_ERR_HTTPD_RESP_SEND, "ESP_ERR_HTTPD_RESP_SEND"}
+};
+
+const char *esp_err_to_name(esp_err_t code) {
+    for (size_t i = 0; i < sizeof(err_names) / sizeof(err_names[0]); i++) {
+        if (err_names[i].code == code) {
+            return err_names[i].name;
+        }
+    }
+    return "UNKNOWN ERROR";
+}
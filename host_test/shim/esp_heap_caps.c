@@ -0,0 +1,13 @@
+#include <malloc.h>
+
+#include "esp_heap_caps.h"
+
+// free chunks inside the arena, memory the allocator hasn't asked the system for isn't counted
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return mallinfo2().fordblks;
+}
+
+// glibc doesn't tell, the free space at the top of the arena is a lower bound
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return mallinfo2().keepcost;
+}
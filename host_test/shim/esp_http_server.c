@@ -0,0 +1,398 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "esp_http_server.h"
+#include "host_httpd.h"
+
+static const char *const error_statuses[HTTPD_ERR_CODE_MAX] = {
+    [HTTPD_500_INTERNAL_SERVER_ERROR] = "500 Internal Server Error",
+    [HTTPD_501_METHOD_NOT_IMPLEMENTED] = "501 Method Not Implemented",
+    [HTTPD_505_VERSION_NOT_SUPPORTED] = "505 Version Not Supported",
+    [HTTPD_400_BAD_REQUEST] = "400 Bad Request",
+    [HTTPD_401_UNAUTHORIZED] = "401 Unauthorized",
+    [HTTPD_403_FORBIDDEN] = "403 Forbidden",
+    [HTTPD_404_NOT_FOUND] = "404 Not Found",
+    [HTTPD_405_METHOD_NOT_ALLOWED] = "405 Method Not Allowed",
+    [HTTPD_408_REQ_TIMEOUT] = "408 Request Timeout",
+    [HTTPD_411_LENGTH_REQUIRED] = "411 Length Required",
+    [HTTPD_414_URI_TOO_LONG] = "414 URI Too Long",
+    [HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE] = "431 Request Header Fields Too Large"
+};
+
+static void buffer_append(struct host_httpd_buffer *buf, const char *data, size_t len) {
+    if (buf->len + len + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 1024;
+        while (buf->len + len + 1 > cap) {
+            cap *= 2;
+        }
+        buf->data = realloc(buf->data, cap);
+        if (buf->data == NULL) abort();
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+static void buffer_clear(struct host_httpd_buffer *buf) {
+    buf->len = 0;
+    if (buf->data != NULL) {
+        buf->data[0] = '\0';
+    }
+}
+
+static esp_err_t conn_write(struct host_httpd_conn *conn, const char *data, size_t len) {
+    if (conn->fd < 0) {
+        buffer_append(&conn->sent, data, len);
+        return ESP_OK;
+    }
+    while (len > 0) {
+        ssize_t n = send(conn->fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            conn->failed = true;
+            return ESP_ERR_HTTPD_RESP_SEND;
+        }
+        data += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+// the body is only kept for captured requests, a socket's client reads it
+static void capture_body(struct host_httpd_conn *conn, const char *data, size_t len) {
+    if (conn->fd < 0) {
+        buffer_append(&conn->body, data, len);
+    }
+}
+
+const char *host_httpd_find_header(const char *lines, const char *field, size_t *len) {
+    size_t field_len = strlen(field);
+    const char *line = lines;
+    while (line != NULL && *line != '\0' && strncmp(line, "\r\n", 2) != 0) {
+        const char *end = strstr(line, "\r\n");
+        if (strncasecmp(line, field, field_len) == 0 && line[field_len] == ':') {
+            const char *value = line + field_len + 1;
+            while (*value == ' ' || *value == '\t') value++;
+            const char *value_end = end ? end : value + strlen(value);
+            while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+            *len = value_end - value;
+            return value;
+        }
+        line = end ? end + 2 : NULL;
+    }
+    return NULL;
+}
+
+static struct host_httpd_req_aux *aux_of(httpd_req_t *r) {
+    return r->aux;
+}
+
+static esp_err_t send_head(httpd_req_t *r, const char *length_header) {
+    struct host_httpd_req_aux *aux = aux_of(r);
+    struct host_httpd_buffer head = {0};
+    char line[128];
+
+    snprintf(line, sizeof(line), "HTTP/1.1 %s\r\nContent-Type: %s\r\n", aux->status, aux->type);
+    buffer_append(&head, line, strlen(line));
+    buffer_append(&head, length_header, strlen(length_header));
+    for (size_t i = 0; i < aux->num_resp_headers; i++) {
+        buffer_append(&head, aux->resp_headers[i].field, strlen(aux->resp_headers[i].field));
+        buffer_append(&head, ": ", 2);
+        buffer_append(&head, aux->resp_headers[i].value, strlen(aux->resp_headers[i].value));
+        buffer_append(&head, "\r\n", 2);
+    }
+    buffer_append(&head, "\r\n", 2);
+    aux->conn->status = atoi(aux->status);
+    esp_err_t err = conn_write(aux->conn, head.data, head.len);
+    free(head.data);
+    return err;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status) {
+    aux_of(r)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type) {
+    aux_of(r)->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value) {
+    struct host_httpd_req_aux *aux = aux_of(r);
+    if (aux->num_resp_headers == HTTPD_MAX_RESP_HEADERS) {
+        return ESP_ERR_HTTPD_RESP_HDR;
+    }
+    aux->resp_headers[aux->num_resp_headers].field = field;
+    aux->resp_headers[aux->num_resp_headers].value = value;
+    aux->num_resp_headers++;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+    struct host_httpd_req_aux *aux = aux_of(r);
+    if (buf_len == HTTPD_RESP_USE_STRLEN) {
+        buf_len = buf ? strlen(buf) : 0;
+    }
+    char length_header[48];
+    snprintf(length_header, sizeof(length_header), "Content-Length: %zd\r\n", buf_len);
+    esp_err_t err = send_head(r, length_header);
+    if (err == ESP_OK && buf_len > 0) {
+        err = conn_write(aux->conn, buf, buf_len);
+        capture_body(aux->conn, buf, buf_len);
+    }
+    return err;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+    struct host_httpd_req_aux *aux = aux_of(r);
+    if (buf_len == HTTPD_RESP_USE_STRLEN) {
+        buf_len = buf ? strlen(buf) : 0;
+    }
+    if (!aux->chunked) {
+        aux->chunked = true;
+        esp_err_t err = send_head(r, "Transfer-Encoding: chunked\r\n");
+        if (err != ESP_OK) return err;
+    }
+
+    char size_line[16];
+    snprintf(size_line, sizeof(size_line), "%zx\r\n", buf_len);
+    esp_err_t err = conn_write(aux->conn, size_line, strlen(size_line));
+    if (err == ESP_OK && buf_len > 0) {
+        err = conn_write(aux->conn, buf, buf_len);
+        capture_body(aux->conn, buf, buf_len);
+    }
+    if (err == ESP_OK) {
+        err = conn_write(aux->conn, "\r\n", 2);
+    }
+    if (buf_len == 0) {
+        aux->chunked = false;
+    }
+    return err;
+}
+
+esp_err_t httpd_resp_sendstr(httpd_req_t *r, const char *str) {
+    return httpd_resp_send(r, str, str ? strlen(str) : 0);
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg) {
+    const char *status = error < HTTPD_ERR_CODE_MAX ? error_statuses[error] : error_statuses[0];
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "text/html");
+    return httpd_resp_sendstr(req, msg ? msg : status + 4);
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field) {
+    size_t len = 0;
+    host_httpd_find_header(aux_of(r)->headers, field, &len);
+    return len;
+}
+
+static esp_err_t copy_truncated(const char *value, size_t len, char *buf, size_t size) {
+    if (size == 0) return ESP_ERR_INVALID_ARG;
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(buf, value, n);
+    buf[n] = '\0';
+    return n < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size) {
+    size_t len;
+    const char *value = host_httpd_find_header(aux_of(r)->headers, field, &len);
+    if (value == NULL) return ESP_ERR_NOT_FOUND;
+    return copy_truncated(value, len, val, val_size);
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t buf_len) {
+    const char *query = strchr(r->uri, '?');
+    if (query == NULL) return ESP_ERR_NOT_FOUND;
+    query++;
+    const char *end = strchr(query, '#');
+    return copy_truncated(query, end ? (size_t)(end - query) : strlen(query), buf, buf_len);
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size) {
+    size_t key_len = strlen(key);
+    const char *p = qry;
+    while (p != NULL && *p != '\0') {
+        const char *end = strchr(p, '&');
+        const char *eq = memchr(p, '=', end ? (size_t)(end - p) : strlen(p));
+        if (eq != NULL && (size_t)(eq - p) == key_len && strncmp(p, key, key_len) == 0) {
+            const char *value = eq + 1;
+            return copy_truncated(value, end ? (size_t)(end - value) : strlen(value), val, val_size);
+        }
+        p = end ? end + 1 : NULL;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r) {
+    return aux_of(r)->conn->fd;
+}
+
+// the session is closed for both sides, whoever reads it next sees the end
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd) {
+    if (sockfd < 0 || shutdown(sockfd, SHUT_RDWR) != 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+void host_httpd_conn_init(struct host_httpd_conn *conn) {
+    conn->wake_fd = -1;
+    pthread_mutex_init(&conn->lock, NULL);
+    pthread_cond_init(&conn->async_done, NULL);
+}
+
+void host_httpd_conn_destroy(struct host_httpd_conn *conn) {
+    pthread_cond_destroy(&conn->async_done);
+    pthread_mutex_destroy(&conn->lock);
+}
+
+void host_httpd_conn_async_done(struct host_httpd_conn *conn) {
+    pthread_mutex_lock(&conn->lock);
+    conn->async_pending--;
+    if (conn->async_pending == 0 && conn->wake_fd >= 0) {
+        char wake = 0;
+        (void)!write(conn->wake_fd, &wake, 1);
+    }
+    pthread_cond_broadcast(&conn->async_done);
+    pthread_mutex_unlock(&conn->lock);
+}
+
+void host_httpd_conn_wait_async(struct host_httpd_conn *conn) {
+    pthread_mutex_lock(&conn->lock);
+    while (conn->async_pending > 0) {
+        pthread_cond_wait(&conn->async_done, &conn->lock);
+    }
+    pthread_mutex_unlock(&conn->lock);
+}
+
+httpd_req_t *host_httpd_req_new(struct host_httpd_conn *conn, const char *uri, const char *headers) {
+    httpd_req_t *req = calloc(1, sizeof(*req));
+    struct host_httpd_req_aux *aux = calloc(1, sizeof(*aux));
+    if (req == NULL || aux == NULL) abort();
+    req->method = HTTP_GET;
+    snprintf((char *)req->uri, sizeof(req->uri), "%s", uri);
+    req->aux = aux;
+    aux->conn = conn;
+    aux->headers = strdup(headers ? headers : "");
+    aux->status = HTTPD_200;
+    aux->type = "text/html";
+    return req;
+}
+
+void host_httpd_req_free(httpd_req_t *req) {
+    struct host_httpd_req_aux *aux = aux_of(req);
+    free(aux->headers);
+    free(aux);
+    free(req);
+}
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out) {
+    struct host_httpd_req_aux *aux = aux_of(r);
+    httpd_req_t *copy = host_httpd_req_new(aux->conn, r->uri, aux->headers);
+    struct host_httpd_req_aux *copy_aux = copy->aux;
+    copy->handle = r->handle;
+    copy->method = r->method;
+    copy->user_ctx = r->user_ctx;
+    copy_aux->status = aux->status;
+    copy_aux->type = aux->type;
+    memcpy(copy_aux->resp_headers, aux->resp_headers, sizeof(aux->resp_headers));
+    copy_aux->num_resp_headers = aux->num_resp_headers;
+    pthread_mutex_lock(&aux->conn->lock);
+    aux->conn->async_pending++;
+    pthread_mutex_unlock(&aux->conn->lock);
+    *out = copy;
+    return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r) {
+    struct host_httpd_conn *conn = aux_of(r)->conn;
+    host_httpd_req_free(r);
+    host_httpd_conn_async_done(conn);
+    return ESP_OK;
+}
+
+httpd_req_t *host_httpd_socket_begin(const char *uri, const char *headers, int *client_fd) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        return NULL;
+    }
+    struct host_httpd_conn *conn = calloc(1, sizeof(*conn));
+    if (conn == NULL) abort();
+    conn->fd = fds[0];
+    host_httpd_conn_init(conn);
+    *client_fd = fds[1];
+    return host_httpd_req_new(conn, uri, headers);
+}
+
+void host_httpd_socket_end(httpd_req_t *req) {
+    struct host_httpd_conn *conn = aux_of(req)->conn;
+    host_httpd_req_free(req);
+    host_httpd_conn_wait_async(conn);
+    close(conn->fd);
+    host_httpd_conn_destroy(conn);
+    free(conn->body.data);
+    free(conn);
+}
+
+httpd_req_t *host_httpd_capture_begin(const char *uri, const char *headers) {
+    struct host_httpd_conn *conn = calloc(1, sizeof(*conn));
+    if (conn == NULL) abort();
+    conn->fd = -1;
+    host_httpd_conn_init(conn);
+    return host_httpd_req_new(conn, uri, headers);
+}
+
+void host_httpd_capture_end(httpd_req_t *req) {
+    struct host_httpd_conn *conn = aux_of(req)->conn;
+    host_httpd_req_free(req);
+    host_httpd_conn_destroy(conn);
+    free(conn->sent.data);
+    free(conn->body.data);
+    free(conn);
+}
+
+void host_httpd_capture_reset(httpd_req_t *req) {
+    struct host_httpd_req_aux *aux = aux_of(req);
+    buffer_clear(&aux->conn->sent);
+    buffer_clear(&aux->conn->body);
+    aux->conn->status = 0;
+    aux->status = HTTPD_200;
+    aux->type = "text/html";
+    aux->num_resp_headers = 0;
+    aux->chunked = false;
+}
+
+const char *host_httpd_capture_response(httpd_req_t *req, size_t *len) {
+    struct host_httpd_conn *conn = aux_of(req)->conn;
+    *len = conn->sent.len;
+    return conn->sent.data ? conn->sent.data : "";
+}
+
+int host_httpd_capture_status(httpd_req_t *req) {
+    return aux_of(req)->conn->status;
+}
+
+const char *host_httpd_capture_header(httpd_req_t *req, const char *field, char *val, size_t val_size) {
+    struct host_httpd_conn *conn = aux_of(req)->conn;
+    if (conn->sent.data == NULL) return NULL;
+    // skip the status line
+    const char *lines = strstr(conn->sent.data, "\r\n");
+    size_t len;
+    const char *value = lines ? host_httpd_find_header(lines + 2, field, &len) : NULL;
+    if (value == NULL) return NULL;
+    copy_truncated(value, len, val, val_size);
+    return val;
+}
+
+const char *host_httpd_capture_body(httpd_req_t *req, size_t *len) {
+    struct host_httpd_conn *conn = aux_of(req)->conn;
+    *len = conn->body.len;
+    return conn->body.data ? conn->body.data : "";
+}
@@ -0,0 +1,7 @@
+#include "esp_log.h"
+
+esp_log_level_t host_log_level = ESP_LOG_INFO;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+    host_log_level = level;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_partition.h"
+
+#define MAX_PARTITIONS 8
+
+struct host_partition {
+    esp_partition_t partition;
+    uint8_t *data;
+    uint32_t *erase_counts;
+    FILE *image;
+    void (*write_hook)(size_t offset, size_t size);
+};
+
+static struct host_partition partitions[MAX_PARTITIONS];
+static int num_partitions = 0;
+
+static struct host_partition *find(const char *label) {
+    for (int i = 0; i < num_partitions; i++) {
+        if (strcmp(partitions[i].partition.label, label) == 0) {
+            return &partitions[i];
+        }
+    }
+    return NULL;
+}
+
+static struct host_partition *from_partition(const esp_partition_t *partition) {
+    return (struct host_partition *)partition;
+}
+
+static void sync_image(struct host_partition *p, size_t offset, size_t size) {
+    if (p->image == NULL) return;
+    fseek(p->image, offset, SEEK_SET);
+    fwrite(p->data + offset, 1, size, p->image);
+    fflush(p->image);
+}
+
+const esp_partition_t *host_partition_create(const char *label, uint32_t size, const char *image_path) {
+    struct host_partition *p = find(label);
+    if (p == NULL) {
+        if (num_partitions == MAX_PARTITIONS) return NULL;
+        p = &partitions[num_partitions++];
+        strncpy(p->partition.label, label, sizeof(p->partition.label) - 1);
+        p->erase_counts = calloc(size / HOST_PARTITION_SECTOR_SIZE, sizeof(uint32_t));
+    } else if (p->image != NULL) {
+        fclose(p->image);
+        p->image = NULL;
+    }
+    p->partition.type = ESP_PARTITION_TYPE_DATA;
+    p->partition.subtype = ESP_PARTITION_SUBTYPE_ANY;
+    p->partition.size = size;
+    p->partition.erase_size = HOST_PARTITION_SECTOR_SIZE;
+    p->data = realloc(p->data, size);
+    memset(p->data, 0xFF, size);
+
+    if (image_path != NULL) {
+        p->image = fopen(image_path, "r+b");
+        if (p->image != NULL) {
+            fread(p->data, 1, size, p->image);
+        } else {
+            p->image = fopen(image_path, "w+b");
+            sync_image(p, 0, size);
+        }
+    }
+    return &p->partition;
+}
+
+uint32_t host_partition_erase_count(const esp_partition_t *partition, uint32_t sector) {
+    return from_partition(partition)->erase_counts[sector];
+}
+
+void host_partition_set_write_hook(const esp_partition_t *partition, void (*hook)(size_t offset, size_t size)) {
+    from_partition(partition)->write_hook = hook;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label) {
+    struct host_partition *p = find(label);
+    return p != NULL ? &p->partition : NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size) {
+    if (offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, from_partition(partition)->data + offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size) {
+    if (offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    struct host_partition *p = from_partition(partition);
+    const uint8_t *bytes = src;
+    for (size_t i = 0; i < size; i++) {
+        p->data[offset + i] &= bytes[i];
+    }
+    sync_image(p, offset, size);
+    if (p->write_hook != NULL) {
+        p->write_hook(offset, size);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    if (offset % partition->erase_size != 0 || size % partition->erase_size != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    struct host_partition *p = from_partition(partition);
+    memset(p->data + offset, 0xFF, size);
+    for (size_t sector = offset / partition->erase_size; sector < (offset + size) / partition->erase_size; sector++) {
+        p->erase_counts[sector]++;
+    }
+    sync_image(p, offset, size);
+    return ESP_OK;
+}
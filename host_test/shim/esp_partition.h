@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Data partitions in RAM, optionally backed by an image file that every
+// write and erase goes through to, so a test can reopen it like a reboot.
+// Writes behave like NOR flash and can only clear bits, erases set whole
+// sectors back to 0xFF.
+
+#define HOST_PARTITION_SECTOR_SIZE 4096
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_ANY = 0xff
+} esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    uint32_t erase_size;
+    char label[17];
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
+
+// creates the partition, or reloads it from its image when the label exists,
+// an existing image file is used as it is and a missing one starts erased
+const esp_partition_t *host_partition_create(const char *label, uint32_t size, const char *image_path);
+uint32_t host_partition_erase_count(const esp_partition_t *partition, uint32_t sector);
+// called once each write has landed, a test can longjmp out of it to reset
+// the device right after that write
+void host_partition_set_write_hook(const esp_partition_t *partition, void (*hook)(size_t offset, size_t size));
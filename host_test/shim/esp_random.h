@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// random(), not a hardware RNG, the firmware only draws ids from it
+uint32_t esp_random();
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+// CRCs of the ROM, reflected, with the value inverted on the way in and
+// out so they can be chained. CRC-32 uses the IEEE polynomial, CRC-8 0x07.
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+uint8_t esp_rom_crc8_le(uint8_t crc, const uint8_t *buf, uint32_t len);
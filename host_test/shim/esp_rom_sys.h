@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "host_clock.h"
+
+static inline void esp_rom_delay_us(uint32_t us) {
+    host_clock_delay_us(us);
+}
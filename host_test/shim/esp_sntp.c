@@ -0,0 +1,14 @@
+#include "esp_sntp.h"
+
+bool esp_sntp_enabled() {
+    return true;
+}
+
+void esp_sntp_setoperatingmode(int operating_mode) {
+}
+
+void esp_sntp_setservername(int idx, const char *server) {
+}
+
+void esp_sntp_init() {
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdbool.h>
+
+// The host clock is already set, SNTP reports itself running so the
+// firmware never starts it.
+
+#define SNTP_OPMODE_POLL 0
+
+bool esp_sntp_enabled();
+void esp_sntp_setoperatingmode(int operating_mode);
+void esp_sntp_setservername(int idx, const char *server);
+void esp_sntp_init();
@@ -0,0 +1,57 @@
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "esp_spiffs.h"
+
+static const char *spiffs_dir = NULL;
+static size_t spiffs_total = 0;
+static char base_path[32];
+
+void host_spiffs_set_dir(const char *dir, size_t total_bytes) {
+    spiffs_dir = dir;
+    spiffs_total = total_bytes;
+}
+
+esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t *conf) {
+    if (spiffs_dir == NULL) return ESP_ERR_NOT_FOUND;
+    if (base_path[0] != '\0') return ESP_ERR_INVALID_STATE;
+    snprintf(base_path, sizeof(base_path), "%s", conf->base_path);
+    return ESP_OK;
+}
+
+// SPIFFS has no directories, the files of the image are the ones at the top
+esp_err_t esp_spiffs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes) {
+    if (base_path[0] == '\0') return ESP_ERR_INVALID_STATE;
+    DIR *dir = opendir(spiffs_dir);
+    if (dir == NULL) return ESP_FAIL;
+    size_t used = 0;
+    struct dirent *entry;
+    char path[PATH_MAX];
+    struct stat st;
+    while ((entry = readdir(dir)) != NULL) {
+        snprintf(path, sizeof(path), "%s/%s", spiffs_dir, entry->d_name);
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            used += st.st_size;
+        }
+    }
+    closedir(dir);
+    *total_bytes = spiffs_total;
+    *used_bytes = used;
+    return ESP_OK;
+}
+
+// only defined with -Wl,--wrap=fopen, the only way __wrap_fopen is reached
+FILE *__real_fopen(const char *path, const char *mode) __attribute__((weak));
+
+FILE *__wrap_fopen(const char *path, const char *mode) {
+    size_t base_len = strlen(base_path);
+    if (base_len == 0 || strncmp(path, base_path, base_len) != 0 || path[base_len] != '/') {
+        return __real_fopen(path, mode);
+    }
+    char host_path[PATH_MAX];
+    snprintf(host_path, sizeof(host_path), "%s%s", spiffs_dir, path + base_len);
+    return __real_fopen(host_path, mode);
+}
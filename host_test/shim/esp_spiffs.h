@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+// SPIFFS on the host is a directory set with host_spiffs_set_dir. Paths
+// under the registered base path are opened in that directory by
+// __wrap_fopen, for targets linked with -Wl,--wrap=fopen. Without a
+// directory nothing is mounted.
+
+typedef struct {
+    const char *base_path;
+    const char *partition_label;
+    size_t max_files;
+    bool format_if_mount_failed;
+} esp_vfs_spiffs_conf_t;
+
+esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t *conf);
+esp_err_t esp_spiffs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes);
+
+// directory standing in for the partition and the partition size reported
+// by esp_spiffs_info, before esp_vfs_spiffs_register
+void host_spiffs_set_dir(const char *dir, size_t total_bytes);
@@ -0,0 +1,70 @@
+
+#include <stdlib.h>
+
+#include "esp_app_desc.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+
+static esp_reset_reason_t reset_reason = ESP_RST_POWERON;
+
+// placed by the linker around the RTC_NOINIT_ATTR variables, weak for
+// programs that have none
+extern uint8_t __start_rtc_noinit[] __attribute__((weak));
+extern uint8_t __stop_rtc_noinit[] __attribute__((weak));
+
+static const esp_app_desc_t app_desc = {
+    .version = "host",
+    .project_name = "weather_station",
+    .app_elf_sha256 = {0x68, 0x6f, 0x73, 0x74}
+};
+
+uint32_t esp_random() {
+    return (uint32_t)random() << 16 ^ (uint32_t)random();
+}
+
+esp_reset_reason_t esp_reset_reason() {
+    return reset_reason;
+}
+
+void host_set_reset_reason(esp_reset_reason_t reason) {
+    reset_reason = reason;
+}
+
+// uninstrumented, the section also holds the padding the address
+// sanitizer puts between the variables
+__attribute__((no_sanitize("address")))
+void host_power_cut() {
+    uint32_t state = 0x12345678;
+    for (uint8_t *p = __start_rtc_noinit; p < __stop_rtc_noinit; p++) {
+        state = state * 1103515245 + 12345;
+        *p = state >> 16;
+    }
+    reset_reason = ESP_RST_POWERON;
+}
+
+const esp_app_desc_t *esp_app_get_description() {
+    return &app_desc;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+uint8_t esp_rom_crc8_le(uint8_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xE0 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+    ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT,
+    ESP_RST_SDIO
+} esp_reset_reason_t;
+
+// power on until a test simulates another kind of reset
+esp_reset_reason_t esp_reset_reason();
+void host_set_reset_reason(esp_reset_reason_t reason);
+// fills RTC_NOINIT_ATTR memory with garbage, as a power cycle leaves it,
+// and reports the next boot as a power on
+void host_power_cut();
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// microseconds since the program started, see host_clock.h
+int64_t esp_timer_get_time();
@@ -0,0 +1,233 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "host_clock.h"
+
+#define MAX_TASKS 32
+#define TICK_US (1000000 / configTICK_RATE_HZ)
+
+struct host_task {
+    pthread_t thread;
+    const char *name;
+    TaskFunction_t function;
+    void *parameter;
+};
+
+struct host_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *items;
+};
+
+static pthread_mutex_t tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct host_task *tasks[MAX_TASKS];
+static int num_tasks = 0;
+static __thread struct host_task *current_task = NULL;
+
+static void *run_task(void *arg) {
+    current_task = arg;
+    current_task->function(current_task->parameter);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameter, UBaseType_t priority, TaskHandle_t *task, BaseType_t core) {
+    struct host_task *t = calloc(1, sizeof(*t));
+    t->name = name;
+    t->function = function;
+    t->parameter = parameter;
+
+    pthread_mutex_lock(&tasks_lock);
+    if (num_tasks < MAX_TASKS) {
+        tasks[num_tasks++] = t;
+    }
+    pthread_mutex_unlock(&tasks_lock);
+
+    if (pthread_create(&t->thread, NULL, run_task, t) != 0) {
+        return pdFAIL;
+    }
+    pthread_detach(t->thread);
+    if (task != NULL) {
+        *task = t;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    // only a task deleting itself is supported
+    if (task == NULL || task == current_task) {
+        pthread_exit(NULL);
+    }
+}
+
+void vTaskDelay(TickType_t ticks) {
+    host_clock_delay_us((int64_t)ticks * TICK_US);
+}
+
+TickType_t xTaskGetTickCount() {
+    return esp_timer_get_time() / TICK_US;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return current_task;
+}
+
+TaskHandle_t xTaskGetHandle(const char *name) {
+    TaskHandle_t found = NULL;
+    pthread_mutex_lock(&tasks_lock);
+    for (int i = 0; i < num_tasks && found == NULL; i++) {
+        if (strcmp(tasks[i]->name, name) == 0) {
+            found = tasks[i];
+        }
+    }
+    pthread_mutex_unlock(&tasks_lock);
+    return found;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    return 0;
+}
+
+uint64_t ulTaskGetRunTimeCounter(TaskHandle_t task) {
+    return 0;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->items = calloc(length, item_size ? item_size : 1);
+    return queue;
+}
+
+QueueHandle_t host_queue_create_counting(UBaseType_t max_count, UBaseType_t initial_count) {
+    QueueHandle_t queue = xQueueCreate(max_count, 0);
+    queue->count = initial_count;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    pthread_mutex_destroy(&queue->mutex);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->items);
+    free(queue);
+}
+
+// waits on cond until ready() holds or the ticks run out, with the queue locked
+static bool wait_for(struct host_queue *queue, pthread_cond_t *cond, bool (*ready)(struct host_queue *), TickType_t timeout) {
+    if (timeout == portMAX_DELAY) {
+        while (!ready(queue)) {
+            pthread_cond_wait(cond, &queue->mutex);
+        }
+        return true;
+    }
+    // blocking times are always real, even when delays are skipped
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    int64_t ns = deadline.tv_nsec + (int64_t)timeout * TICK_US * 1000;
+    deadline.tv_sec += ns / 1000000000;
+    deadline.tv_nsec = ns % 1000000000;
+    while (!ready(queue)) {
+        if (pthread_cond_timedwait(cond, &queue->mutex, &deadline) == ETIMEDOUT) {
+            return ready(queue);
+        }
+    }
+    return true;
+}
+
+static bool has_item(struct host_queue *queue) {
+    return queue->count > 0;
+}
+
+static bool has_space(struct host_queue *queue) {
+    return queue->count < queue->length;
+}
+
+static void push(struct host_queue *queue, const void *item) {
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    if (queue->item_size > 0) {
+        memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+    pthread_cond_broadcast(&queue->not_empty);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t timeout) {
+    pthread_mutex_lock(&queue->mutex);
+    bool sent = wait_for(queue, &queue->not_full, has_space, timeout);
+    if (sent) {
+        push(queue, item);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return sent ? pdTRUE : pdFALSE;
+}
+
+// for queues of length one, replaces the item waiting
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+    pthread_mutex_lock(&queue->mutex);
+    queue->count = 0;
+    push(queue, item);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdTRUE;
+}
+
+static BaseType_t take(QueueHandle_t queue, void *item, TickType_t timeout, bool remove) {
+    pthread_mutex_lock(&queue->mutex);
+    bool received = wait_for(queue, &queue->not_empty, has_item, timeout);
+    if (received) {
+        if (item != NULL && queue->item_size > 0) {
+            memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+        }
+        if (remove) {
+            queue->head = (queue->head + 1) % queue->length;
+            queue->count--;
+            pthread_cond_broadcast(&queue->not_full);
+        }
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return received ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout) {
+    return take(queue, item, timeout, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t timeout) {
+    return take(queue, item, timeout, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->mutex);
+    queue->count = 0;
+    queue->head = 0;
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->mutex);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->mutex);
+    UBaseType_t spaces = queue->length - queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+    return spaces;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+// FreeRTOS on POSIX threads: tasks are threads, queues and semaphores are a
+// mutex and condition variables, ticks are 10 ms of the host clock. Like
+// ESP-IDF's FreeRTOS.h this also declares the task, queue and semaphore
+// APIs.
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFF)
+#define configTICK_RATE_HZ 100
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+// the spinlock of a critical section, a plain mutex here
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_MUTEX_INITIALIZER }
+#define taskENTER_CRITICAL(mux) pthread_mutex_lock(&(mux)->mutex)
+#define taskEXIT_CRITICAL(mux) pthread_mutex_unlock(&(mux)->mutex)
+
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
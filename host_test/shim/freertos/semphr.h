@@ -0,0 +1,18 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// queues of empty items, the way FreeRTOS builds them
+// spelled out, queue.h may not be done yet when FreeRTOS.h pulls this in
+typedef struct host_queue *SemaphoreHandle_t;
+
+struct host_queue *host_queue_create_counting(UBaseType_t max_count, UBaseType_t initial_count);
+
+#define xSemaphoreCreateMutex() host_queue_create_counting(1, 1)
+#define xSemaphoreCreateBinary() host_queue_create_counting(1, 0)
+#define xSemaphoreCreateCounting(max_count, initial_count) host_queue_create_counting(max_count, initial_count)
+#define xSemaphoreTake(semaphore, timeout) xQueueReceive(semaphore, NULL, timeout)
+#define xSemaphoreGive(semaphore) xQueueSend(semaphore, NULL, 0)
+#define xSemaphoreGiveFromISR(semaphore, woken) xQueueSend(semaphore, NULL, 0)
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
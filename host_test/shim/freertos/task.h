@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameter, UBaseType_t priority, TaskHandle_t *task, BaseType_t core);
+#define xTaskCreate(function, name, stack_depth, parameter, priority, task) \
+    xTaskCreatePinnedToCore(function, name, stack_depth, parameter, priority, task, tskNO_AFFINITY)
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+TaskHandle_t xTaskGetHandle(const char *name);
+// threads have no watermark to read, these report zero
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+uint64_t ulTaskGetRunTimeCounter(TaskHandle_t task);
@@ -0,0 +1,53 @@
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "driver/gpio.h"
+
+static _Atomic uint8_t levels[GPIO_NUM_MAX];
+static _Atomic gpio_mode_t modes[GPIO_NUM_MAX];
+static host_gpio_listener_t listener = NULL;
+static void *listener_ctx = NULL;
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+    if (config->pin_bit_mask >> GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < GPIO_NUM_MAX; i++) {
+        if (config->pin_bit_mask & (1ULL << i)) {
+            modes[i] = config->mode;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode) {
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    modes[gpio_num] = mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // like the hardware, a pin that isn't an output keeps the level for later
+    levels[gpio_num] = level != 0;
+    if ((modes[gpio_num] & GPIO_MODE_OUTPUT) && listener != NULL) {
+        listener(gpio_num, level != 0, listener_ctx);
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return 0;
+    }
+    return levels[gpio_num];
+}
+
+void host_gpio_set_listener(host_gpio_listener_t new_listener, void *ctx) {
+    listener_ctx = ctx;
+    listener = new_listener;
+}
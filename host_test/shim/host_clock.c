@@ -0,0 +1,83 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "esp_timer.h"
+#include "host_clock.h"
+
+static _Atomic enum host_clock_mode mode = HOST_CLOCK_REAL;
+// skipped or simulated time on top of the monotonic clock
+static _Atomic int64_t offset_us = 0;
+// wall clock minus esp_timer_get_time, set on first use
+static _Atomic int64_t wall_offset_us = 0;
+static atomic_bool wall_set = false;
+
+// counted from the first call, like esp_timer from boot
+static int64_t monotonic_us() {
+    static _Atomic int64_t start_us = -1;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t now_us = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    int64_t unset = -1;
+    atomic_compare_exchange_strong(&start_us, &unset, now_us);
+    return now_us - start_us;
+}
+
+void host_clock_set_mode(enum host_clock_mode new_mode) {
+    int64_t now_us = esp_timer_get_time();
+    mode = new_mode;
+    // keep the clock continuous across the switch
+    offset_us += now_us - esp_timer_get_time();
+}
+
+int64_t esp_timer_get_time() {
+    if (mode == HOST_CLOCK_SIMULATED) {
+        return offset_us;
+    }
+    return monotonic_us() + offset_us;
+}
+
+void host_clock_advance(int64_t time_us) {
+    offset_us += time_us;
+}
+
+void host_clock_delay_us(int64_t time_us) {
+    if (time_us <= 0) return;
+    if (mode != HOST_CLOCK_REAL) {
+        offset_us += time_us;
+        return;
+    }
+    struct timespec ts = { .tv_sec = time_us / 1000000, .tv_nsec = time_us % 1000000 * 1000 };
+    while (nanosleep(&ts, &ts) != 0);
+}
+
+int64_t host_clock_wall_us() {
+    if (!atomic_exchange(&wall_set, true)) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        wall_offset_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - esp_timer_get_time();
+    }
+    return esp_timer_get_time() + wall_offset_us;
+}
+
+void host_clock_set_wall_us(int64_t time_us) {
+    wall_set = true;
+    wall_offset_us = time_us - esp_timer_get_time();
+}
+
+int __wrap_gettimeofday(struct timeval *tv, void *tz) {
+    int64_t now_us = host_clock_wall_us();
+    tv->tv_sec = now_us / 1000000;
+    tv->tv_usec = now_us % 1000000;
+    return 0;
+}
+
+time_t __wrap_time(time_t *t) {
+    time_t now = host_clock_wall_us() / 1000000;
+    if (t != NULL) {
+        *t = now;
+    }
+    return now;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+// Time source behind esp_timer_get_time, vTaskDelay, esp_rom_delay_us and,
+// for targets linked with -Wl,--wrap=gettimeofday,--wrap=time, the wall
+// clock.
+
+enum host_clock_mode {
+    // delays sleep for real
+    HOST_CLOCK_REAL,
+    // delays return at once and move the clock forward instead, so a run
+    // reports device-like stage times without waiting for them
+    HOST_CLOCK_SKIP_DELAYS,
+    // the clock only moves with delays and host_clock_advance, for
+    // deterministic runs over simulated days
+    HOST_CLOCK_SIMULATED
+};
+
+void host_clock_set_mode(enum host_clock_mode mode);
+void host_clock_advance(int64_t time_us);
+void host_clock_delay_us(int64_t time_us);
+// wall clock in microseconds since the epoch
+int64_t host_clock_wall_us();
+void host_clock_set_wall_us(int64_t time_us);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_http_server.h"
+
+// Connection and request state behind httpd_req_t, shared by the response
+// functions and the server.
+
+struct host_httpd_buffer {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+struct host_httpd_conn {
+    // -1 for a captured request
+    int fd;
+    bool failed;
+    // status code of the last response
+    int status;
+    // captured requests only, everything sent and the body alone
+    struct host_httpd_buffer sent;
+    struct host_httpd_buffer body;
+    // requests handed to another task that haven't completed
+    int async_pending;
+    // written to when the last of them completes, -1 for none
+    int wake_fd;
+    pthread_mutex_t lock;
+    pthread_cond_t async_done;
+};
+
+struct host_httpd_req_aux {
+    struct host_httpd_conn *conn;
+    // request header lines, "Name: value\r\n" each
+    char *headers;
+    const char *status;
+    const char *type;
+    struct {
+        const char *field;
+        const char *value;
+    } resp_headers[HTTPD_MAX_RESP_HEADERS];
+    size_t num_resp_headers;
+    // between the first chunk and the terminating one
+    bool chunked;
+};
+
+void host_httpd_conn_init(struct host_httpd_conn *conn);
+void host_httpd_conn_destroy(struct host_httpd_conn *conn);
+void host_httpd_conn_async_done(struct host_httpd_conn *conn);
+// blocks until every async request of the connection completed
+void host_httpd_conn_wait_async(struct host_httpd_conn *conn);
+
+httpd_req_t *host_httpd_req_new(struct host_httpd_conn *conn, const char *uri, const char *headers);
+void host_httpd_req_free(httpd_req_t *req);
+
+// value of a header in "Name: value\r\n" lines, not terminated, NULL when missing
+const char *host_httpd_find_header(const char *lines, const char *field, size_t *len);
@@ -0,0 +1,359 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "host_httpd.h"
+
+// The server side of esp_http_server. One task named httpd, as on the
+// device, accepts connections on 127.0.0.1, reads request heads and calls
+// the handler registered for the URI. Sessions stay open between requests,
+// and one with an async request outstanding isn't read again until the
+// request completes. Request bodies aren't read, the firmware only serves
+// GET. Responses are written by the request functions in
+// esp_http_server.c.
+
+static const char *TAG = "httpd";
+
+// CONFIG_HTTPD_MAX_REQ_HDR_LEN
+#define REQ_HDR_LEN 1024
+// CONFIG_LWIP_TCP_SND_BUF_DEFAULT, a handler blocks on a slow client as soon
+// as on the device instead of after megabytes of loopback buffer
+#define SND_BUF 5760
+
+struct session {
+    struct host_httpd_conn conn;
+    // request head read so far
+    char head[REQ_HDR_LEN];
+    size_t len;
+    uint64_t last_used;
+};
+
+struct server {
+    httpd_config_t config;
+    int listen_fd;
+    uint16_t port;
+    // woken by httpd_stop and by async requests completing
+    int wake[2];
+    httpd_uri_t *handlers;
+    size_t num_handlers;
+    // conn.fd is -1 for a free slot
+    struct session *sessions;
+    struct pollfd *fds;
+    uint64_t requests;
+    volatile bool stopping;
+    SemaphoreHandle_t stopped;
+};
+
+static uint16_t listen_port = 0;
+static bool listen_port_set = false;
+static uint16_t last_port = 0;
+
+void host_httpd_listen_on(uint16_t port) {
+    listen_port = port;
+    listen_port_set = true;
+}
+
+uint16_t host_httpd_listening_port() {
+    return last_port;
+}
+
+bool httpd_uri_match_wildcard(const char *uri_template, const char *uri_to_match, size_t match_upto) {
+    size_t len = strlen(uri_template);
+    if (len > 0 && uri_template[len - 1] == '*') {
+        return match_upto >= len - 1 && strncmp(uri_template, uri_to_match, len - 1) == 0;
+    }
+    if (len > 0 && uri_template[len - 1] == '?') {
+        return (match_upto == len || match_upto == len - 1) && strncmp(uri_template, uri_to_match, len - 1) == 0;
+    }
+    return match_upto == len && strncmp(uri_template, uri_to_match, len) == 0;
+}
+
+static bool session_busy(struct session *s) {
+    pthread_mutex_lock(&s->conn.lock);
+    bool busy = s->conn.async_pending > 0;
+    pthread_mutex_unlock(&s->conn.lock);
+    return busy;
+}
+
+// an async request still holding the session is failed and waited for first
+static void close_session(struct session *s) {
+    shutdown(s->conn.fd, SHUT_RDWR);
+    host_httpd_conn_wait_async(&s->conn);
+    close(s->conn.fd);
+    host_httpd_conn_destroy(&s->conn);
+    s->conn.fd = -1;
+}
+
+static void accept_session(struct server *server) {
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0) return;
+
+    struct session *free_slot = NULL, *oldest = NULL;
+    for (size_t i = 0; i < server->config.max_open_sockets; i++) {
+        struct session *s = &server->sessions[i];
+        if (s->conn.fd < 0) {
+            free_slot = free_slot ? free_slot : s;
+        } else if (!session_busy(s) && (oldest == NULL || s->last_used < oldest->last_used)) {
+            oldest = s;
+        }
+    }
+    if (free_slot == NULL && server->config.lru_purge_enable && oldest != NULL) {
+        close_session(oldest);
+        free_slot = oldest;
+    }
+    if (free_slot == NULL) {
+        ESP_LOGW(TAG, "No free session, closing the new connection");
+        close(fd);
+        return;
+    }
+
+    // responses go out as a head and a body, Nagle's algorithm would hold the
+    // body back for the client's delayed ACK of the head
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int snd_buf = SND_BUF;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &snd_buf, sizeof(snd_buf));
+    memset(free_slot, 0, sizeof(*free_slot));
+    host_httpd_conn_init(&free_slot->conn);
+    free_slot->conn.fd = fd;
+    free_slot->conn.wake_fd = server->wake[1];
+    free_slot->last_used = server->requests;
+}
+
+static const httpd_uri_t *find_handler(struct server *server, const char *uri, httpd_method_t method, bool *uri_known) {
+    size_t match_upto = strcspn(uri, "?");
+    *uri_known = false;
+    for (size_t i = 0; i < server->num_handlers; i++) {
+        const httpd_uri_t *handler = &server->handlers[i];
+        bool match = server->config.uri_match_fn != NULL
+            ? server->config.uri_match_fn(handler->uri, uri, match_upto)
+            : strlen(handler->uri) == match_upto && strncmp(handler->uri, uri, match_upto) == 0;
+        if (match) {
+            *uri_known = true;
+            if (handler->method == method) return handler;
+        }
+    }
+    return NULL;
+}
+
+static int parse_method(const char *method, size_t len) {
+    static const char *const names[] = {
+        [HTTP_DELETE] = "DELETE",
+        [HTTP_GET] = "GET",
+        [HTTP_HEAD] = "HEAD",
+        [HTTP_POST] = "POST",
+        [HTTP_PUT] = "PUT"
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strlen(names[i]) == len && strncmp(names[i], method, len) == 0) return i;
+    }
+    return -1;
+}
+
+// one request head, NUL terminated after its blank line, returns false when the session has to close
+static bool handle_request(struct server *server, struct session *s, char *head) {
+    char *line_end = strstr(head, "\r\n");
+    char *method_end = strchr(head, ' ');
+    char *uri = method_end ? method_end + 1 : NULL;
+    char *uri_end = uri ? strchr(uri, ' ') : NULL;
+    if (uri_end == NULL || uri_end > line_end) {
+        httpd_req_t *req = host_httpd_req_new(&s->conn, "", NULL);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+        host_httpd_req_free(req);
+        return false;
+    }
+    *uri_end = '\0';
+
+    httpd_req_t *req = host_httpd_req_new(&s->conn, uri, line_end + 2);
+    req->handle = server;
+    req->method = parse_method(head, method_end - head);
+    bool keep = true;
+    bool uri_known;
+    const httpd_uri_t *handler = find_handler(server, uri, req->method, &uri_known);
+    size_t content_len = 0;
+    char value[16];
+    if (httpd_req_get_hdr_value_str(req, "Content-Length", value, sizeof(value)) == ESP_OK) {
+        content_len = strtoul(value, NULL, 10);
+    }
+
+    if (uri_end - uri > HTTPD_MAX_URI_LEN) {
+        httpd_resp_send_err(req, HTTPD_414_URI_TOO_LONG, NULL);
+        keep = false;
+    } else if (handler == NULL) {
+        httpd_resp_send_err(req, uri_known ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND, NULL);
+    } else {
+        req->user_ctx = handler->user_ctx;
+        // the server closes the session when a handler fails
+        keep = handler->handler(req) == ESP_OK;
+    }
+    // the body would be taken for the next request
+    keep = keep && content_len == 0 && !s->conn.failed;
+    host_httpd_req_free(req);
+    server->requests++;
+    s->last_used = server->requests;
+    return keep;
+}
+
+static void read_session(struct server *server, struct session *s) {
+    ssize_t n = recv(s->conn.fd, s->head + s->len, sizeof(s->head) - 1 - s->len, 0);
+    if (n <= 0) {
+        close_session(s);
+        return;
+    }
+    s->len += n;
+    s->head[s->len] = '\0';
+
+    char *end;
+    while ((end = strstr(s->head, "\r\n\r\n")) != NULL) {
+        end += 4;
+        char next = *end;
+        *end = '\0';
+        bool keep = handle_request(server, s, s->head);
+        *end = next;
+        if (!keep) {
+            close_session(s);
+            return;
+        }
+        s->len -= end - s->head;
+        memmove(s->head, end, s->len + 1);
+        // pipelined requests wait until an async one has completed
+        if (session_busy(s)) return;
+    }
+    if (s->len == sizeof(s->head) - 1) {
+        httpd_req_t *req = host_httpd_req_new(&s->conn, "", NULL);
+        httpd_resp_send_err(req, HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE, NULL);
+        host_httpd_req_free(req);
+        close_session(s);
+    }
+}
+
+static void server_task(void *parameter) {
+    struct server *server = parameter;
+    size_t max_sessions = server->config.max_open_sockets;
+    struct session **polled = calloc(max_sessions, sizeof(*polled));
+    if (polled == NULL) abort();
+
+    while (!server->stopping) {
+        server->fds[0] = (struct pollfd){ .fd = server->listen_fd, .events = POLLIN };
+        server->fds[1] = (struct pollfd){ .fd = server->wake[0], .events = POLLIN };
+        size_t num_fds = 2;
+        for (size_t i = 0; i < max_sessions; i++) {
+            struct session *s = &server->sessions[i];
+            if (s->conn.fd >= 0 && !session_busy(s)) {
+                polled[num_fds - 2] = s;
+                server->fds[num_fds++] = (struct pollfd){ .fd = s->conn.fd, .events = POLLIN };
+            }
+        }
+        if (poll(server->fds, num_fds, -1) < 0) continue;
+
+        if (server->fds[1].revents & POLLIN) {
+            char buf[64];
+            (void)!read(server->wake[0], buf, sizeof(buf));
+        }
+        for (size_t i = 2; i < num_fds && !server->stopping; i++) {
+            if (server->fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                read_session(server, polled[i - 2]);
+            }
+        }
+        if (server->fds[0].revents & POLLIN) {
+            accept_session(server);
+        }
+    }
+
+    for (size_t i = 0; i < max_sessions; i++) {
+        if (server->sessions[i].conn.fd >= 0) {
+            close_session(&server->sessions[i]);
+        }
+    }
+    free(polled);
+    xSemaphoreGive(server->stopped);
+    vTaskDelete(NULL);
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config) {
+    struct server *server = calloc(1, sizeof(*server));
+    if (server == NULL) return ESP_ERR_HTTPD_ALLOC_MEM;
+    server->config = *config;
+    server->handlers = calloc(config->max_uri_handlers, sizeof(*server->handlers));
+    server->sessions = calloc(config->max_open_sockets, sizeof(*server->sessions));
+    server->fds = calloc(config->max_open_sockets + 2, sizeof(*server->fds));
+    if (server->handlers == NULL || server->sessions == NULL || server->fds == NULL) abort();
+    for (size_t i = 0; i < config->max_open_sockets; i++) {
+        server->sessions[i].conn.fd = -1;
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(listen_port_set ? listen_port : config->server_port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+    };
+    socklen_t addr_len = sizeof(addr);
+    int one = 1;
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (server->listen_fd < 0
+        || bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+        || listen(server->listen_fd, config->max_open_sockets) != 0
+        || getsockname(server->listen_fd, (struct sockaddr *)&addr, &addr_len) != 0
+        || pipe(server->wake) != 0) {
+        ESP_LOGE(TAG, "Failed to listen on port %u", ntohs(addr.sin_port));
+        if (server->listen_fd >= 0) close(server->listen_fd);
+        free(server->handlers);
+        free(server->sessions);
+        free(server->fds);
+        free(server);
+        return ESP_ERR_HTTPD_TASK;
+    }
+    server->port = ntohs(addr.sin_port);
+    last_port = server->port;
+    server->stopped = xSemaphoreCreateBinary();
+
+    xTaskCreatePinnedToCore(server_task, "httpd", config->stack_size, server, config->task_priority, NULL, tskNO_AFFINITY);
+    *handle = server;
+    return ESP_OK;
+}
+
+// the handlers are registered right after httpd_start, before any request can be read
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler) {
+    struct server *server = handle;
+    for (size_t i = 0; i < server->num_handlers; i++) {
+        if (server->handlers[i].method == uri_handler->method && strcmp(server->handlers[i].uri, uri_handler->uri) == 0) {
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+        }
+    }
+    if (server->num_handlers == server->config.max_uri_handlers) {
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+    server->handlers[server->num_handlers++] = *uri_handler;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+    struct server *server = handle;
+    if (server == NULL) return ESP_ERR_INVALID_ARG;
+    server->stopping = true;
+    char wake = 0;
+    (void)!write(server->wake[1], &wake, 1);
+    xSemaphoreTake(server->stopped, portMAX_DELAY);
+
+    close(server->listen_fd);
+    close(server->wake[0]);
+    close(server->wake[1]);
+    vQueueDelete(server->stopped);
+    free(server->handlers);
+    free(server->sessions);
+    free(server->fds);
+    free(server);
+    return ESP_OK;
+}
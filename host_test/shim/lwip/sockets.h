@@ -0,0 +1,6 @@
+#pragma once
+
+// lwIP's BSD socket API is the host's own
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+
+#include "driver/rmt_rx.h"
+
+struct rmt_channel_t {
+    rmt_rx_channel_config_t config;
+    rmt_rx_event_callbacks_t callbacks;
+    void *user_data;
+    bool enabled;
+};
+
+static host_rmt_source_t source = NULL;
+static void *source_ctx = NULL;
+
+esp_err_t rmt_new_rx_channel(const rmt_rx_channel_config_t *config, rmt_channel_handle_t *ret_chan) {
+    if (config->gpio_num < 0 || config->gpio_num >= GPIO_NUM_MAX || config->resolution_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct rmt_channel_t *channel = calloc(1, sizeof(*channel));
+    if (channel == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    channel->config = *config;
+    *ret_chan = channel;
+    return ESP_OK;
+}
+
+esp_err_t rmt_del_channel(rmt_channel_handle_t channel) {
+    if (channel->enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    free(channel);
+    return ESP_OK;
+}
+
+esp_err_t rmt_rx_register_event_callbacks(rmt_channel_handle_t rx_channel, const rmt_rx_event_callbacks_t *cbs, void *user_data) {
+    if (rx_channel->enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    rx_channel->callbacks = *cbs;
+    rx_channel->user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t rmt_enable(rmt_channel_handle_t channel) {
+    if (channel->enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    channel->enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t rmt_disable(rmt_channel_handle_t channel) {
+    if (!channel->enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    channel->enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t rmt_receive(rmt_channel_handle_t rx_channel, void *buffer, size_t buffer_size, const rmt_receive_config_t *config) {
+    if (!rx_channel->enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (source == NULL) {
+        return ESP_OK;
+    }
+    rmt_symbol_word_t *symbols = buffer;
+    size_t num_symbols = source(rx_channel->config.gpio_num, symbols, buffer_size / sizeof(rmt_symbol_word_t), source_ctx);
+    if (num_symbols > 0 && rx_channel->callbacks.on_recv_done != NULL) {
+        rmt_rx_done_event_data_t edata = {
+            .received_symbols = symbols,
+            .num_symbols = num_symbols
+        };
+        rx_channel->callbacks.on_recv_done(rx_channel, &edata, rx_channel->user_data);
+    }
+    return ESP_OK;
+}
+
+void host_rmt_set_source(host_rmt_source_t new_source, void *ctx) {
+    source_ctx = ctx;
+    source = new_source;
+}
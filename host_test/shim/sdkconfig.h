@@ -0,0 +1,67 @@
+#pragma once
+
+// Defaults of main/Kconfig.projbuild, options that default to n are left
+// undefined. A test can override any of them with a compile definition.
+
+#if !defined(CONFIG_WEATHER_STATION_SENSOR_DHT22) && !defined(CONFIG_WEATHER_STATION_SENSOR_NO_DHT)
+#ifndef CONFIG_WEATHER_STATION_SENSOR_DHT11
+#define CONFIG_WEATHER_STATION_SENSOR_DHT11 1
+#endif
+#endif
+#ifndef CONFIG_WEATHER_STATION_DHT_GPIO
+#define CONFIG_WEATHER_STATION_DHT_GPIO 26
+#endif
+#ifndef CONFIG_WEATHER_STATION_BME280_SDA_GPIO
+#define CONFIG_WEATHER_STATION_BME280_SDA_GPIO 32
+#endif
+#ifndef CONFIG_WEATHER_STATION_BME280_SCL_GPIO
+#define CONFIG_WEATHER_STATION_BME280_SCL_GPIO 33
+#endif
+#ifndef CONFIG_WEATHER_STATION_BME280_ADDRESS
+#define CONFIG_WEATHER_STATION_BME280_ADDRESS 0x76
+#endif
+#ifndef CONFIG_WEATHER_STATION_SAMPLE_PERIOD_MS
+#define CONFIG_WEATHER_STATION_SAMPLE_PERIOD_MS 60000
+#endif
+#ifndef CONFIG_WEATHER_STATION_SAMPLE_RETRY_MS
+#define CONFIG_WEATHER_STATION_SAMPLE_RETRY_MS 2000
+#endif
+#ifndef CONFIG_WEATHER_STATION_SAMPLE_MAX_RETRIES
+#define CONFIG_WEATHER_STATION_SAMPLE_MAX_RETRIES 3
+#endif
+#ifndef CONFIG_WEATHER_STATION_FILTER_WINDOW
+#define CONFIG_WEATHER_STATION_FILTER_WINDOW 3
+#endif
+#ifndef CONFIG_WEATHER_STATION_FILTER_EMA_PERCENT
+#define CONFIG_WEATHER_STATION_FILTER_EMA_PERCENT 100
+#endif
+#ifndef CONFIG_WEATHER_STATION_FILTER_TEMPERATURE_JUMP
+#define CONFIG_WEATHER_STATION_FILTER_TEMPERATURE_JUMP 50
+#endif
+#ifndef CONFIG_WEATHER_STATION_FILTER_HUMIDITY_JUMP
+#define CONFIG_WEATHER_STATION_FILTER_HUMIDITY_JUMP 20
+#endif
+#ifndef CONFIG_WEATHER_STATION_FILTER_PRESSURE_JUMP
+#define CONFIG_WEATHER_STATION_FILTER_PRESSURE_JUMP 5
+#endif
+#ifndef CONFIG_WEATHER_STATION_ADAPTIVE_MIN_PERIOD_MS
+#define CONFIG_WEATHER_STATION_ADAPTIVE_MIN_PERIOD_MS 15000
+#endif
+#ifndef CONFIG_WEATHER_STATION_ADAPTIVE_TEMPERATURE_DELTA
+#define CONFIG_WEATHER_STATION_ADAPTIVE_TEMPERATURE_DELTA 5
+#endif
+#ifndef CONFIG_WEATHER_STATION_ADAPTIVE_HUMIDITY_DELTA
+#define CONFIG_WEATHER_STATION_ADAPTIVE_HUMIDITY_DELTA 2
+#endif
+#ifndef CONFIG_WEATHER_STATION_HISTORY_FLUSH_S
+#define CONFIG_WEATHER_STATION_HISTORY_FLUSH_S 3600
+#endif
+#ifndef CONFIG_WEATHER_STATION_HTTP_WORKERS
+#define CONFIG_WEATHER_STATION_HTTP_WORKERS 2
+#endif
+#ifndef CONFIG_WEATHER_STATION_HTTP_WORKER_QUEUE_LEN
+#define CONFIG_WEATHER_STATION_HTTP_WORKER_QUEUE_LEN 2
+#endif
+#ifndef CONFIG_WEATHER_STATION_TRACE_EVENTS
+#define CONFIG_WEATHER_STATION_TRACE_EVENTS 512
+#endif
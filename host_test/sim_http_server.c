@@ -0,0 +1,97 @@
+// The firmware's web server on the host, for load testing with
+// tools/http_bench.py (see run_http_bench.py). The handlers of
+// http_server.c are served on 127.0.0.1 with the pages built for the SPIFFS
+// image in a directory, the history and rollups hold days of one-minute
+// readings up to now in partition images in memory.
+//
+//   sim_http_server [port] [days]
+//
+// Port 0, the default, lets the system pick one. The URL is printed once
+// the server is up, it stops cleanly on SIGINT or SIGTERM.
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "check.h"
+#include "dht_waveform.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_spiffs.h"
+
+#include "history.h"
+#include "http_server.h"
+#include "retained.h"
+#include "rollup.h"
+#include "sampler.h"
+#include "sensor_state.h"
+
+#define DEFAULT_DAYS 30
+#define SAMPLE_PERIOD 60
+// sizes in partitions.csv
+#define SPIFFS_PARTITION_SIZE (1024 * 1024)
+#define HISTORY_PARTITION_SIZE (768 * 1024)
+#define HOUR_PARTITION_SIZE (64 * 1024)
+#define DAY_PARTITION_SIZE (16 * 1024)
+
+static uint32_t seed = 37;
+
+// a DHT22 and a BME280 indoors: a daily swing with a little noise
+static struct sensor_data reading(uint32_t t) {
+    uint32_t phase = t % 86400;
+    int32_t triangle = phase < 43200 ? phase : 86400 - phase;
+    uint32_t r = dht_waveform_random(&seed);
+    return (struct sensor_data){
+        .temperature = 1800 + triangle / 90 + r % 20,
+        .humidity = 5500 - triangle / 40 + (r >> 8) % 50,
+        .pressure = 101300 + (r >> 16) % 40,
+        .channels = SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY | SENSOR_CHANNEL_PRESSURE
+    };
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? atoi(argv[1]) : 0;
+    int days = argc > 2 ? atoi(argv[2]) : DEFAULT_DAYS;
+    CHECK(port >= 0 && port <= 65535 && days > 0);
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    // every task inherits the mask, only sigwait below sees the signals
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    CHECK(pthread_sigmask(SIG_BLOCK, &signals, NULL) == 0);
+
+    CHECK(host_partition_create("history", HISTORY_PARTITION_SIZE, NULL) != NULL);
+    CHECK(host_partition_create("rollup_hour", HOUR_PARTITION_SIZE, NULL) != NULL);
+    CHECK(host_partition_create("rollup_day", DAY_PARTITION_SIZE, NULL) != NULL);
+    host_spiffs_set_dir(SPIFFS_DIR, SPIFFS_PARTITION_SIZE);
+    retained_init();
+    sampler_init();
+    history_init();
+    rollup_init();
+
+    uint32_t now = time(NULL);
+    uint32_t t = (now - days * 86400) / SAMPLE_PERIOD * SAMPLE_PERIOD;
+    struct sensor_data sd = {0};
+    for (; t <= now; t += SAMPLE_PERIOD) {
+        sd = reading(t);
+        history_append(t, sd);
+        rollup_add(t, sd);
+    }
+    sensor_state_publish(sd);
+
+    host_httpd_listen_on(port);
+    http_server_init();
+    http_server_start();
+    printf("listening on http://127.0.0.1:%u\n", host_httpd_listening_port());
+    fflush(stdout);
+
+    int signal;
+    sigwait(&signals, &signal);
+    http_server_stop();
+    return 0;
+}
@@ -0,0 +1,354 @@
+// The firmware's sampling pipeline end to end on the host: generated DHT11
+// waveforms arrive through the RMT stand-in and dht_decode, and every
+// accepted reading goes over the sample bus to the real sink tasks, which
+// draw it on a recorded LCD bus, notify a BLE client, stream it to a live
+// feed subscriber and log it to the history and rollups in flash images.
+// Some reads get no answer or a bad checksum, as they do in the field.
+//
+//   sim_pipeline [samples]
+//
+// Delays are skipped and move the clock instead, so the per-stage times
+// pipeline_stats reports include the bus and sensor waits of the device.
+// Stages that overlap with another task's delay are charged for it too.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "dht_waveform.h"
+#include "driver/rmt_rx.h"
+#include "esp_gatts_api.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "host_clock.h"
+#include "lcd_recorder.h"
+
+#include "ble_gatt_server.h"
+#include "fixed_format.h"
+#include "history.h"
+#include "live_feed.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "pipeline_stats.h"
+#include "retained.h"
+#include "rollup.h"
+#include "sample_bus.h"
+#include "sensor.h"
+#include "sensor_state.h"
+
+#define DEFAULT_SAMPLES 240
+#define START_TIME 1709251200 // 2024-03-01
+// sizes in partitions.csv
+#define HISTORY_PARTITION_SIZE (768 * 1024)
+#define HOUR_PARTITION_SIZE (64 * 1024)
+#define DAY_PARTITION_SIZE (16 * 1024)
+// every so many reads the sensor is silent, answers only the start pulse or garbles the checksum
+#define SILENT_EVERY 31
+#define NO_RESPONSE_EVERY 17
+#define BAD_CHECKSUM_EVERY 23
+#define JITTER_US 6
+#define BLE_MTU 247
+#define SD_UUID 0xFF01
+#define WAIT_US (60 * 1000000)
+
+static int num_samples;
+static uint32_t num_reads = 0;
+static uint32_t seed = 11;
+static uint32_t injected_silent = 0;
+static uint32_t injected_no_response = 0;
+static uint32_t injected_bad_checksum = 0;
+
+static const enum pipeline_stage sink_stages[] = {
+    PIPELINE_STAGE_LCD,
+    PIPELINE_STAGE_BLE,
+    PIPELINE_STAGE_ROLLUP,
+    PIPELINE_STAGE_LIVE
+};
+
+static uint32_t stage_count(enum pipeline_stage stage) {
+    struct pipeline_stage_stats stats;
+    pipeline_stats_get(stage, &stats);
+    return stats.count;
+}
+
+static bool sinks_caught_up() {
+    uint32_t published = stage_count(PIPELINE_STAGE_PUBLISH);
+    for (size_t i = 0; i < sizeof(sink_stages) / sizeof(sink_stages[0]); i++) {
+        if (stage_count(sink_stages[i]) < published) return false;
+    }
+    return true;
+}
+
+static void wait_until(bool (*done)()) {
+    for (int waited_us = 0; !done(); waited_us += 100) {
+        CHECK(waited_us < WAIT_US);
+        usleep(100);
+    }
+}
+
+// the sinks get through each reading before the next is taken, as they do
+// with a minute between readings, so none is dropped for being overwritten
+static size_t next_frame(gpio_num_t gpio_num, rmt_symbol_word_t *symbols, size_t max_symbols, void *ctx) {
+    wait_until(sinks_caught_up);
+    if (stage_count(PIPELINE_STAGE_PUBLISH) >= (uint32_t)num_samples) {
+        // the run is over, the sensor task stays here
+        while (1) pause();
+    }
+
+    uint32_t read = num_reads++;
+    struct dht_waveform_options options = {
+        .jitter_us = JITTER_US,
+        .truncate_bits = -1,
+        .seed = seed
+    };
+    if (read % SILENT_EVERY == SILENT_EVERY - 1) {
+        injected_silent++;
+        return 0;
+    }
+    if (read % NO_RESPONSE_EVERY == NO_RESPONSE_EVERY - 1) {
+        options.no_response = true;
+        injected_no_response++;
+    } else if (read % BAD_CHECKSUM_EVERY == BAD_CHECKSUM_EVERY - 1) {
+        options.bad_checksum = true;
+        injected_bad_checksum++;
+    }
+
+    // a slow rise and fall, well inside what the filter lets through
+    uint8_t frame[DHT_FRAME_LEN];
+    uint32_t humidity_step = read / 20 % 28;
+    uint32_t temperature_step = read / 30 % 10;
+    dht_waveform_frame(frame, 40 + (humidity_step < 14 ? humidity_step : 28 - humidity_step), 0,
+                       18 + (temperature_step < 5 ? temperature_step : 10 - temperature_step), read % 10);
+    struct dht_pulse pulses[DHT_WAVEFORM_MAX_PULSES];
+    size_t num_pulses = dht_waveform(frame, &options, pulses);
+    seed = options.seed;
+
+    size_t num_symbols = 0;
+    for (size_t i = 0; i < num_pulses && num_symbols < max_symbols; i += 2) {
+        rmt_symbol_word_t symbol = {
+            .level0 = pulses[i].level,
+            .duration0 = pulses[i].duration_us
+        };
+        if (i + 1 < num_pulses) {
+            symbol.level1 = pulses[i + 1].level;
+            symbol.duration1 = pulses[i + 1].duration_us;
+        }
+        symbols[num_symbols++] = symbol;
+    }
+    return num_symbols;
+}
+
+struct live_client {
+    int fd;
+    pthread_t thread;
+    char *received;
+    size_t len;
+};
+
+static void *read_live(void *arg) {
+    struct live_client *client = arg;
+    size_t cap = 0;
+    while (1) {
+        if (client->len + 4096 + 1 > cap) {
+            cap = cap ? cap * 2 : 65536;
+            client->received = realloc(client->received, cap);
+            CHECK(client->received != NULL);
+        }
+        ssize_t n = read(client->fd, client->received + client->len, cap - client->len - 1);
+        if (n <= 0) break;
+        client->len += n;
+    }
+    client->received[client->len] = '\0';
+    return NULL;
+}
+
+static uint32_t count_occurrences(const char *text, const char *needle) {
+    uint32_t count = 0;
+    for (const char *p = text; (p = strstr(p, needle)) != NULL; p += strlen(needle)) {
+        count++;
+    }
+    return count;
+}
+
+// value on the line starting with name, the # TYPE lines mention it too
+static uint64_t metric(const char *text, const char *name) {
+    char line_start[128];
+    snprintf(line_start, sizeof(line_start), "\n%s ", name);
+    const char *line = strstr(text, line_start);
+    CHECK(line != NULL);
+    return strtoull(line + strlen(line_start), NULL, 10);
+}
+
+static void check_lcd(struct sensor_data sd) {
+    char expected[LCD_COLS + 1];
+    char shown[LCD_COLS + 1];
+    char value[FIXED_FORMAT_LEN];
+    char row[LCD_COLS + 1];
+
+    CHECK(lcd_recorder_display_on());
+    fixed_format_fahrenheit(value, sizeof(value), sd, 0, 2);
+    snprintf(row, sizeof(row), " Temp: %s F", value);
+    snprintf(expected, sizeof(expected), "%-16s", row);
+    lcd_recorder_line(0, shown);
+    CHECK(strcmp(shown, expected) == 0);
+
+    fixed_format_humidity(value, sizeof(value), sd, 0, 0);
+    snprintf(row, sizeof(row), " Humidity: %s%%", value);
+    snprintf(expected, sizeof(expected), "%-16s", row);
+    lcd_recorder_line(1, shown);
+    CHECK(strcmp(shown, expected) == 0);
+}
+
+static void check_ble(uint16_t sd_handle, struct sensor_data sd) {
+    uint8_t value[ESP_GATT_MAX_ATTR_LEN];
+    uint16_t len;
+    CHECK(host_ble_sent(sd_handle, value, &len) == stage_count(PIPELINE_STAGE_BLE));
+    CHECK(len == 8);
+    CHECK((int16_t)(value[0] | value[1] << 8) == sd.temperature);
+    CHECK((uint16_t)(value[2] | value[3] << 8) == sd.humidity);
+}
+
+static void check_history(struct sensor_snapshot last) {
+    struct history_cursor cursor;
+    struct history_record records[32];
+    size_t count;
+    uint32_t total = 0;
+    uint32_t previous = 0;
+    history_cursor_init(&cursor);
+    while ((count = history_read(&cursor, records, 32)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            CHECK(records[i].timestamp > previous);
+            previous = records[i].timestamp;
+        }
+        total += count;
+    }
+    CHECK(total == (uint32_t)num_samples);
+    CHECK(previous == (uint32_t)last.timestamp);
+
+    struct rollup_cursor rollup;
+    struct rollup_bucket bucket;
+    uint32_t rolled_up = 0;
+    rollup_cursor_init(&rollup, ROLLUP_HOURLY, START_TIME, last.timestamp);
+    while (rollup_next(&rollup, &bucket)) {
+        rolled_up += bucket.count;
+    }
+    CHECK(rolled_up == (uint32_t)num_samples);
+}
+
+static void check_metrics() {
+    httpd_req_t *req = host_httpd_capture_begin("/metrics", NULL);
+    CHECK(metrics_send(req) == ESP_OK);
+    size_t len;
+    const char *text = host_httpd_capture_body(req, &len);
+    CHECK(metric(text, "weather_samples_total{result=\"ok\"}") == (uint64_t)num_samples);
+    // a start pulse nobody answers leaves only its own tail, which decodes as a timeout
+    CHECK(metric(text, "weather_samples_total{result=\"timeout\"}") == injected_silent + injected_no_response);
+    CHECK(metric(text, "weather_samples_total{result=\"checksum\"}") == injected_bad_checksum);
+    CHECK(metric(text, "weather_samples_total{result=\"rejected\"}") == 0);
+    CHECK(metric(text, "weather_ble_notifications_total") == (uint64_t)num_samples);
+    host_httpd_capture_end(req);
+
+    // more than 71 minutes of handler time, past 32 bits of microseconds
+    for (int i = 0; i < 5000; i++) {
+        metrics_observe_request(METRICS_ROUTE_BOOT, 1000000);
+    }
+    req = host_httpd_capture_begin("/metrics", NULL);
+    CHECK(metrics_send(req) == ESP_OK);
+    text = host_httpd_capture_body(req, &len);
+    CHECK(metric(text, "weather_http_request_duration_seconds_sum{uri=\"/api/boot\"}") == 5000);
+    CHECK(metric(text, "weather_http_request_duration_seconds_count{uri=\"/api/boot\"}") == 5000);
+    host_httpd_capture_end(req);
+}
+
+static bool published_all() {
+    return stage_count(PIPELINE_STAGE_PUBLISH) >= (uint32_t)num_samples && sinks_caught_up();
+}
+
+int main(int argc, char **argv) {
+    num_samples = argc > 1 ? atoi(argv[1]) : DEFAULT_SAMPLES;
+    CHECK(num_samples > 0);
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    host_clock_set_mode(HOST_CLOCK_SKIP_DELAYS);
+    host_clock_set_wall_us((int64_t)START_TIME * 1000000);
+    CHECK(host_partition_create("history", HISTORY_PARTITION_SIZE, NULL) != NULL);
+    CHECK(host_partition_create("rollup_hour", HOUR_PARTITION_SIZE, NULL) != NULL);
+    CHECK(host_partition_create("rollup_day", DAY_PARTITION_SIZE, NULL) != NULL);
+
+    // the order of app_main, with every sink ready before the first reading
+    retained_init();
+    sample_bus_init();
+    host_rmt_set_source(next_frame, NULL);
+    sensor_init();
+    lcd_recorder_init();
+    history_init();
+    rollup_init();
+    live_feed_init();
+    ble_gatt_server_init();
+    // registration, then the attribute table it creates
+    host_ble_sync();
+    host_ble_sync();
+
+    uint16_t sd_handle = host_ble_find_handle(SD_UUID);
+    CHECK(sd_handle != 0);
+    host_ble_connect(BLE_MTU);
+    const uint8_t notify[2] = {0x01, 0x00};
+    CHECK(host_ble_write(sd_handle + 1, notify, sizeof(notify)) == ESP_GATT_OK);
+
+    struct live_client client = {0};
+    httpd_req_t *live_req = host_httpd_socket_begin("/api/live", NULL, &client.fd);
+    CHECK(live_req != NULL);
+    CHECK(live_feed_subscribe(live_req) == ESP_OK);
+    CHECK(pthread_create(&client.thread, NULL, read_live, &client) == 0);
+
+    pipeline_start_sampling();
+    pipeline_start_logger();
+    pipeline_start_live();
+    pipeline_start_ble();
+    wait_until(published_all);
+
+    struct sensor_snapshot last;
+    CHECK(sensor_state_get(&last));
+    CHECK(last.seq == (uint32_t)num_samples);
+    check_lcd(last.sd);
+    check_ble(sd_handle, last.sd);
+    check_history(last);
+    check_metrics();
+
+    struct lcd_recorder_stats lcd;
+    lcd_recorder_get_stats(&lcd);
+    CHECK(lcd.busy_violations == 0);
+    CHECK(lcd.reads == 0);
+    CHECK(lcd.clears == 1);
+
+    live_feed_close_all();
+    pthread_join(client.thread, NULL);
+    host_httpd_socket_end(live_req);
+    CHECK(count_occurrences(client.received, "\ndata: ") == (uint32_t)num_samples);
+    char last_id[32];
+    snprintf(last_id, sizeof(last_id), "id: %lu\n", (unsigned long)last.seq);
+    CHECK(strstr(client.received, last_id) != NULL);
+
+    for (int i = 0; i < NUM_SAMPLE_SINKS; i++) {
+        struct sample_bus_stats stats;
+        sample_bus_get_stats(i, &stats);
+        CHECK(stats.delivered == (uint32_t)num_samples);
+        CHECK(stats.dropped == 0);
+    }
+
+    printf("%d samples from %lu reads (%lu silent, %lu unanswered, %lu bad checksums)\n", num_samples,
+           (unsigned long)num_reads, (unsigned long)injected_silent, (unsigned long)injected_no_response,
+           (unsigned long)injected_bad_checksum);
+    printf("lcd: %lu instructions, %lu characters written over %lu frames, %lu bytes to the live client\n",
+           (unsigned long)lcd.instructions, (unsigned long)lcd.data_writes,
+           (unsigned long)stage_count(PIPELINE_STAGE_LCD), (unsigned long)client.len);
+    fflush(stdout);
+    esp_log_level_set("*", ESP_LOG_INFO);
+    pipeline_stats_log();
+    sample_bus_log();
+    free(client.received);
+    return 0;
+}
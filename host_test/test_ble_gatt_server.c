@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ble_gatt_server.h"
+#include "check.h"
+#include "esp_gatts_api.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "history.h"
+#include "retained.h"
+
+// size in partitions.csv
+#define HISTORY_PARTITION_SIZE (768 * 1024)
+
+#define SD_UUID 0xFF01
+#define HISTORY_UUID 0xFF04
+#define HISTORY_CTRL_UUID 0xFF05
+
+static const uint8_t enable[2] = {0x01, 0x00};
+static const uint8_t disable[2] = {0x00, 0x00};
+
+static const struct sensor_data reading = {
+    .temperature = 2150,
+    .humidity = 4025,
+    .pressure = 101325,
+    .channels = SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY | SENSOR_CHANNEL_PRESSURE
+};
+
+// the history transfer runs on a task of its own, a tick is 10 ms
+static uint32_t wait_for_sent(uint16_t handle, uint32_t count) {
+    uint32_t sent = 0;
+    for (int i = 0; i < 100 && (sent = host_ble_sent(handle, NULL, NULL)) < count; i++) {
+        vTaskDelay(1);
+    }
+    return sent;
+}
+
+// long enough for the transfer task to finish a request of one record
+static void settle() {
+    vTaskDelay(pdMS_TO_TICKS(50));
+}
+
+// a descriptor only changes on a write of both of its bytes
+static void test_ccc_lengths(uint16_t sd_handle) {
+    uint16_t ccc = sd_handle + 1;
+    const uint8_t none[1] = {0};
+
+    CHECK(host_ble_write(ccc, enable, 1) == ESP_GATT_OK);
+    CHECK(host_ble_write(ccc, none, 0) == ESP_GATT_OK);
+    ble_gatt_server_notify(reading);
+    CHECK(host_ble_sent(sd_handle, NULL, NULL) == 0);
+
+    CHECK(host_ble_write(ccc, enable, sizeof(enable)) == ESP_GATT_OK);
+    ble_gatt_server_notify(reading);
+    CHECK(host_ble_sent(sd_handle, NULL, NULL) == 1);
+
+    // a short write leaves notifications on
+    CHECK(host_ble_write(ccc, disable, 1) == ESP_GATT_OK);
+    ble_gatt_server_notify(reading);
+    CHECK(host_ble_sent(sd_handle, NULL, NULL) == 2);
+
+    CHECK(host_ble_write(ccc, disable, sizeof(disable)) == ESP_GATT_OK);
+    ble_gatt_server_notify(reading);
+    CHECK(host_ble_sent(sd_handle, NULL, NULL) == 2);
+
+    // the stack refuses anything longer than the descriptor
+    const uint8_t longer[3] = {0x01, 0x00, 0x00};
+    CHECK(host_ble_write(ccc, longer, sizeof(longer)) == ESP_GATT_INVALID_ATTR_LEN);
+}
+
+// empty and truncated requests on the control point are ignored, a whole one is answered
+static void test_control_point_lengths(uint16_t ctrl_handle, uint16_t history_handle) {
+    const uint8_t empty[1] = {0};
+    const uint8_t start[9] = {0x01, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF};
+    const uint8_t abort_op[1] = {0x02};
+
+    CHECK(host_ble_write(ctrl_handle + 1, enable, 1) == ESP_GATT_OK);
+    CHECK(host_ble_write(history_handle + 1, enable, 1) == ESP_GATT_OK);
+    CHECK(host_ble_write(ctrl_handle, start, sizeof(start)) == ESP_GATT_OK);
+    // the request is carried out, only its answer is not notified
+    CHECK(wait_for_sent(history_handle, 1) == 1);
+    settle();
+    CHECK(host_ble_sent(ctrl_handle, NULL, NULL) == 0);
+
+    CHECK(host_ble_write(ctrl_handle + 1, enable, sizeof(enable)) == ESP_GATT_OK);
+    CHECK(host_ble_write(history_handle + 1, enable, sizeof(enable)) == ESP_GATT_OK);
+    CHECK(host_ble_write(ctrl_handle, empty, 0) == ESP_GATT_OK);
+    CHECK(host_ble_write(ctrl_handle, start, 5) == ESP_GATT_OK);
+    CHECK(host_ble_write(ctrl_handle, abort_op, sizeof(abort_op)) == ESP_GATT_OK);
+    settle();
+    CHECK(host_ble_sent(ctrl_handle, NULL, NULL) == 0);
+    CHECK(host_ble_sent(history_handle, NULL, NULL) == 1);
+
+    CHECK(host_ble_write(ctrl_handle, start, sizeof(start)) == ESP_GATT_OK);
+    CHECK(wait_for_sent(ctrl_handle, 1) == 1);
+    uint8_t response[8];
+    uint16_t len = 0;
+    host_ble_sent(ctrl_handle, response, &len);
+    CHECK(len == 6);
+    CHECK(response[0] == 0x80 && response[1] == 0x00);
+    // the one reading appended before the request, still in the open block
+    CHECK(response[2] == 1 && response[3] == 0 && response[4] == 0 && response[5] == 0);
+    CHECK(host_ble_sent(history_handle, NULL, NULL) == 2);
+}
+
+int main() {
+    esp_log_level_set("*", ESP_LOG_WARN);
+    retained_init();
+    CHECK(host_partition_create("history", HISTORY_PARTITION_SIZE, NULL) != NULL);
+    history_init();
+    history_append(1709251200, reading); // 2024-03-01
+
+    ble_gatt_server_init();
+    // registration, then the attribute table it creates
+    host_ble_sync();
+    host_ble_sync();
+    uint16_t sd_handle = host_ble_find_handle(SD_UUID);
+    uint16_t history_handle = host_ble_find_handle(HISTORY_UUID);
+    uint16_t ctrl_handle = host_ble_find_handle(HISTORY_CTRL_UUID);
+    CHECK(sd_handle != 0 && history_handle != 0 && ctrl_handle != 0);
+    host_ble_connect(247);
+
+    test_ccc_lengths(sd_handle);
+    test_control_point_lengths(ctrl_handle, history_handle);
+
+    host_ble_disconnect();
+    printf("ble_gatt_server: ok\n");
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include <math.h>
+#include <string.h>
+
+#include "bme280.h"
+#include "check.h"
+#include "dht_waveform.h"
+
+#define NUM_READINGS 100000
+
+// the worked example of section 8.2 of the Bosch BMP280 datasheet, the
+// temperature and pressure coefficients of the BME280 are the same
+#define EXAMPLE_ADC_T 519888
+#define EXAMPLE_ADC_P 415148
+#define EXAMPLE_TEMPERATURE 2508
+// 25767236 / 256 Pa from the 64-bit path, 100653.27 Pa
+#define EXAMPLE_PRESSURE 100653
+
+static const struct bme280_calib example = {
+    .t1 = 27504, .t2 = 26435, .t3 = -1000,
+    .p1 = 36477, .p2 = -10685, .p3 = 3024, .p4 = 2855, .p5 = 140, .p6 = -7,
+    .p7 = 15500, .p8 = -14600, .p9 = 6000,
+    .h1 = 75, .h2 = 362, .h3 = 0, .h4 = 321, .h5 = -6, .h6 = 30
+};
+
+// 0xE4-0xE6: H4 is 0xE4 and the low nibble of 0xE5, H5 is 0xE6 and the high
+// nibble of 0xE5, both signed
+static const uint8_t example_h4_h5[3] = { 0x14, 0xA1, 0xFF };
+
+static void put_u16_le(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void example_registers(uint8_t calib[BME280_CALIB_LEN], uint8_t calib_h[BME280_CALIB_H_LEN]) {
+    const struct bme280_calib *c = &example;
+    const uint16_t words[12] = {
+        c->t1, c->t2, c->t3, c->p1, c->p2, c->p3, c->p4, c->p5, c->p6, c->p7, c->p8, c->p9
+    };
+    for (int i = 0; i < 12; i++) {
+        put_u16_le(calib + 2 * i, words[i]);
+    }
+    calib[24] = 0x00;
+    calib[25] = c->h1;
+    put_u16_le(calib_h, c->h2);
+    calib_h[2] = c->h3;
+    memcpy(calib_h + 3, example_h4_h5, sizeof(example_h4_h5));
+    calib_h[6] = (uint8_t)c->h6;
+}
+
+static void data_registers(uint8_t data[BME280_DATA_LEN], int32_t adc_p, int32_t adc_t, int32_t adc_h) {
+    data[0] = adc_p >> 12;
+    data[1] = adc_p >> 4;
+    data[2] = (adc_p & 0x0F) << 4;
+    data[3] = adc_t >> 12;
+    data[4] = adc_t >> 4;
+    data[5] = (adc_t & 0x0F) << 4;
+    data[6] = adc_h >> 8;
+    data[7] = adc_h;
+}
+
+// the floating point formulas of section 8.1 of the BME280 datasheet
+static double reference_t_fine(const struct bme280_calib *c, int32_t adc_t) {
+    double var1 = (adc_t / 16384.0 - c->t1 / 1024.0) * c->t2;
+    double var2 = (adc_t / 131072.0 - c->t1 / 8192.0) * (adc_t / 131072.0 - c->t1 / 8192.0) * c->t3;
+    return var1 + var2;
+}
+
+static double reference_pressure(const struct bme280_calib *c, int32_t adc_p, double t_fine) {
+    double var1 = t_fine / 2.0 - 64000.0;
+    double var2 = var1 * var1 * c->p6 / 32768.0;
+    var2 = var2 + var1 * c->p5 * 2.0;
+    var2 = var2 / 4.0 + c->p4 * 65536.0;
+    var1 = (c->p3 * var1 * var1 / 524288.0 + c->p2 * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * c->p1;
+    double p = 1048576.0 - adc_p;
+    p = (p - var2 / 4096.0) * 6250.0 / var1;
+    var1 = c->p9 * p * p / 2147483648.0;
+    var2 = p * c->p8 / 32768.0;
+    return p + (var1 + var2 + c->p7) / 16.0;
+}
+
+static double reference_humidity(const struct bme280_calib *c, int32_t adc_h, double t_fine) {
+    double h = t_fine - 76800.0;
+    h = (adc_h - (c->h4 * 64.0 + c->h5 / 16384.0 * h))
+        * (c->h2 / 65536.0 * (1.0 + c->h6 / 67108864.0 * h * (1.0 + c->h3 / 67108864.0 * h)));
+    h = h * (1.0 - c->h1 * h / 524288.0);
+    return h < 0 ? 0 : h > 100 ? 100 : h;
+}
+
+static void test_parse_calib() {
+    uint8_t calib[BME280_CALIB_LEN];
+    uint8_t calib_h[BME280_CALIB_H_LEN];
+    example_registers(calib, calib_h);
+    struct bme280_calib c;
+    memset(&c, 0x55, sizeof(c));
+    bme280_parse_calib(calib, calib_h, &c);
+    CHECK(c.t1 == example.t1 && c.t2 == example.t2 && c.t3 == example.t3);
+    CHECK(c.p1 == example.p1 && c.p2 == example.p2 && c.p3 == example.p3);
+    CHECK(c.p4 == example.p4 && c.p5 == example.p5 && c.p6 == example.p6);
+    CHECK(c.p7 == example.p7 && c.p8 == example.p8 && c.p9 == example.p9);
+    CHECK(c.h1 == example.h1 && c.h2 == example.h2 && c.h3 == example.h3 && c.h6 == example.h6);
+    CHECK(c.h4 == 321);
+    CHECK(c.h5 == -6);
+
+    // a negative H4 and a positive H5 take the other sign of each half
+    const uint8_t h4_h5[3] = { 0xF0, 0x3C, 0x02 };
+    memcpy(calib_h + 3, h4_h5, sizeof(h4_h5));
+    bme280_parse_calib(calib, calib_h, &c);
+    CHECK(c.h4 == -244);
+    CHECK(c.h5 == 35);
+}
+
+static void test_datasheet_example() {
+    uint8_t data[BME280_DATA_LEN];
+    data_registers(data, EXAMPLE_ADC_P, EXAMPLE_ADC_T, 0x8000);
+    struct sensor_data sd = {0};
+    bme280_compensate(&example, data, &sd);
+    CHECK(sd.temperature == EXAMPLE_TEMPERATURE);
+    CHECK(sd.pressure == EXAMPLE_PRESSURE);
+    CHECK(sd.channels == (SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY | SENSOR_CHANNEL_PRESSURE));
+}
+
+// raw readings from -40 to 85 degrees, 300 to 1100 hPa and the whole
+// humidity range against the floating point formulas
+static void test_against_reference() {
+    uint32_t seed = 3;
+    for (int i = 0; i < NUM_READINGS; i++) {
+        int32_t adc_t = 360000 + dht_waveform_random(&seed) % 300000;
+        int32_t adc_p = 200000 + dht_waveform_random(&seed) % 400000;
+        int32_t adc_h = dht_waveform_random(&seed) % 65536;
+        uint8_t data[BME280_DATA_LEN];
+        data_registers(data, adc_p, adc_t, adc_h);
+        struct sensor_data sd = {0};
+        bme280_compensate(&example, data, &sd);
+
+        double t_fine = reference_t_fine(&example, adc_t);
+        double pressure = reference_pressure(&example, adc_p, t_fine);
+        if (t_fine < -204800 || t_fine > 435200 || pressure < 30000 || pressure > 110000) {
+            continue;
+        }
+        CHECK(fabs(sd.temperature - t_fine / 51.2) <= 1);
+        CHECK(fabs(sd.pressure - pressure) <= 1);
+        CHECK(fabs(sd.humidity - reference_humidity(&example, adc_h, t_fine) * 100) <= 2);
+    }
+}
+
+int main() {
+    test_parse_calib();
+    test_datasheet_example();
+    test_against_reference();
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <string.h>
+
+#include "check.h"
+#include "dht.h"
+#include "dht_waveform.h"
+
+#define NUM_FRAMES 20000
+// well inside the 50 us threshold between a 27 us zero and a 70 us one
+#define MAX_JITTER_US 15
+
+static void random_frame(uint8_t frame[DHT_FRAME_LEN], uint32_t *seed) {
+    uint32_t r = dht_waveform_random(seed);
+    dht_waveform_frame(frame, r, r >> 8, r >> 16, r >> 24);
+}
+
+static esp_err_t decode(const uint8_t frame[DHT_FRAME_LEN], struct dht_waveform_options *options, uint8_t decoded[DHT_FRAME_LEN]) {
+    struct dht_pulse pulses[DHT_WAVEFORM_MAX_PULSES];
+    size_t num_pulses = dht_waveform(frame, options, pulses);
+    return dht_decode(pulses, num_pulses, decoded);
+}
+
+static void test_clean_and_noisy_frames() {
+    uint32_t seed = 1;
+    for (int jitter_us = 0; jitter_us <= MAX_JITTER_US; jitter_us += 5) {
+        struct dht_waveform_options options = { .jitter_us = jitter_us, .truncate_bits = -1, .seed = 7 };
+        for (int i = 0; i < NUM_FRAMES; i++) {
+            uint8_t frame[DHT_FRAME_LEN];
+            uint8_t decoded[DHT_FRAME_LEN];
+            random_frame(frame, &seed);
+            CHECK(decode(frame, &options, decoded) == ESP_OK);
+            CHECK(memcmp(frame, decoded, DHT_FRAME_LEN) == 0);
+        }
+    }
+}
+
+static void test_timeouts() {
+    uint8_t frame[DHT_FRAME_LEN];
+    uint8_t decoded[DHT_FRAME_LEN];
+    dht_waveform_frame(frame, 45, 0, 23, 5);
+
+    struct dht_waveform_options options = { .no_response = true, .truncate_bits = -1 };
+    CHECK(decode(frame, &options, decoded) == ESP_ERR_TIMEOUT);
+
+    // the sensor dropping off at any point of the frame
+    for (int bits = 0; bits < DHT_FRAME_LEN * 8; bits++) {
+        options = (struct dht_waveform_options){ .truncate_bits = bits, .jitter_us = 5, .seed = bits + 1 };
+        CHECK(decode(frame, &options, decoded) == ESP_ERR_TIMEOUT);
+    }
+
+    // a high bit stretched past anything the sensor sends
+    struct dht_pulse pulses[DHT_WAVEFORM_MAX_PULSES];
+    options = (struct dht_waveform_options){ .truncate_bits = -1 };
+    size_t num_pulses = dht_waveform(frame, &options, pulses);
+    pulses[21].duration_us = 150;
+    CHECK(dht_decode(pulses, num_pulses, decoded) == ESP_ERR_TIMEOUT);
+}
+
+static void test_bad_checksums() {
+    uint32_t seed = 3;
+    for (int i = 0; i < NUM_FRAMES; i++) {
+        uint8_t frame[DHT_FRAME_LEN];
+        uint8_t decoded[DHT_FRAME_LEN];
+        random_frame(frame, &seed);
+        struct dht_waveform_options options = { .bad_checksum = true, .truncate_bits = -1, .jitter_us = 10, .seed = i + 1 };
+        CHECK(decode(frame, &options, decoded) == ESP_ERR_INVALID_CRC);
+    }
+}
+
+static void test_convert() {
+    uint8_t frame[DHT_FRAME_LEN];
+    struct sensor_data sd = {0};
+
+    dht_waveform_frame(frame, 45, 0, 23, 5);
+    dht11_convert(frame, &sd);
+    CHECK(sd.temperature == 2350 && sd.humidity == 4500);
+    CHECK(sd.channels == (SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY));
+
+    // newer DHT11s flag sub zero readings in bit 7 of the tenths byte
+    dht_waveform_frame(frame, 80, 0, 3, 0x82);
+    dht11_convert(frame, &sd);
+    CHECK(sd.temperature == -320);
+
+    // 65.2 %RH and -10.1 C
+    dht_waveform_frame(frame, 0x02, 0x8C, 0x80, 0x65);
+    dht22_convert(frame, &sd);
+    CHECK(sd.humidity == 6520 && sd.temperature == -1010);
+}
+
+int main() {
+    test_clean_and_noisy_frames();
+    test_timeouts();
+    test_bad_checksums();
+    test_convert();
+    printf("dht: all checks passed\n");
+    return 0;
+}
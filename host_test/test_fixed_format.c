@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "fixed_format.h"
+
+// the float expressions the sinks printed before fixed_format, as
+// sensor_data.h had them
+static float old_celsius(struct sensor_data sd) {
+    return sd.temperature / 100.0f;
+}
+
+static float old_fahrenheit(struct sensor_data sd) {
+    return old_celsius(sd) * 1.8 + 32;
+}
+
+static float old_humidity(struct sensor_data sd) {
+    return sd.humidity / 100.0f;
+}
+
+static float old_hectopascals(struct sensor_data sd) {
+    return sd.pressure / 100.0f;
+}
+
+typedef int (*format_fn)(char *, size_t, struct sensor_data, int, int);
+
+static void check_same(format_fn format, double old, struct sensor_data sd, int width, int decimals) {
+    char expected[32];
+    char actual[FIXED_FORMAT_LEN];
+    int expected_len = snprintf(expected, sizeof(expected), "%0*.*f", width, decimals, old);
+    int actual_len = format(actual, sizeof(actual), sd, width, decimals);
+    if (actual_len != expected_len || strcmp(actual, expected) != 0) {
+        fprintf(stderr, "%d.%d of %d, %u, %lu: expected %s, got %s\n", width, decimals,
+            sd.temperature, sd.humidity, (unsigned long)sd.pressure, expected, actual);
+    }
+    CHECK(actual_len == expected_len);
+    CHECK(strcmp(actual, expected) == 0);
+}
+
+// every temperature and humidity the record can hold, at every precision
+// the sinks use and a few more
+static void test_exhaustive() {
+    for (int32_t value = INT16_MIN; value <= UINT16_MAX; value++) {
+        struct sensor_data sd = {
+            .temperature = value >= INT16_MIN && value <= INT16_MAX ? value : 0,
+            .humidity = value >= 0 ? value : 0,
+        };
+        for (int width = 0; width <= 2; width += 2) {
+            for (int decimals = 0; decimals <= 4; decimals++) {
+                if (value <= INT16_MAX) {
+                    check_same(fixed_format_celsius, old_celsius(sd), sd, width, decimals);
+                }
+                if (value >= 0) {
+                    check_same(fixed_format_humidity, old_humidity(sd), sd, width, decimals);
+                }
+            }
+            for (int decimals = 0; decimals <= 3 && value <= INT16_MAX; decimals++) {
+                check_same(fixed_format_fahrenheit, old_fahrenheit(sd), sd, width, decimals);
+            }
+        }
+    }
+}
+
+// from the lowest a BME280 reports to well above sea level
+static void test_pressure() {
+    for (uint32_t pressure = 30000; pressure <= 110000; pressure++) {
+        struct sensor_data sd = {.pressure = pressure};
+        for (int decimals = 0; decimals <= 3; decimals++) {
+            check_same(fixed_format_hectopascals, old_hectopascals(sd), sd, 0, decimals);
+        }
+    }
+}
+
+// precisions the integer path can't match the float one at give an empty string
+static void test_unsupported() {
+    struct sensor_data sd = {.temperature = 2150};
+    char buf[FIXED_FORMAT_LEN] = "unchanged";
+    CHECK(fixed_format_fahrenheit(buf, sizeof(buf), sd, 0, 4) < 0);
+    CHECK(buf[0] == '\0');
+    strcpy(buf, "unchanged");
+    CHECK(fixed_format_hectopascals(buf, sizeof(buf), sd, 0, 4) < 0);
+    CHECK(buf[0] == '\0');
+    strcpy(buf, "unchanged");
+    CHECK(fixed_format_celsius(buf, sizeof(buf), sd, 0, 5) < 0);
+    CHECK(buf[0] == '\0');
+    strcpy(buf, "unchanged");
+    CHECK(fixed_format_celsius(buf, sizeof(buf), sd, 0, -1) < 0);
+    CHECK(buf[0] == '\0');
+}
+
+int main() {
+    test_exhaustive();
+    test_pressure();
+    test_unsupported();
+    printf("fixed_format: ok\n");
+    return 0;
+}
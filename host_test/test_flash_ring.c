@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "esp_log.h"
+#include "flash_ring.h"
+
+#define LABEL "ring"
+#define IMAGE "test_flash_ring.img"
+#define NUM_SECTORS 4
+#define FORMAT 1
+
+struct record {
+    uint32_t id;
+    uint32_t payload[3];
+};
+
+#define RECORDS_PER_SECTOR ((HOST_PARTITION_SECTOR_SIZE - 16) / sizeof(struct record))
+
+static struct flash_ring ring;
+static const esp_partition_t *partition;
+
+// a reboot: the partition is reloaded from its image and the ring rescanned
+static void boot(uint32_t format) {
+    partition = host_partition_create(LABEL, NUM_SECTORS * HOST_PARTITION_SECTOR_SIZE, IMAGE);
+    CHECK(flash_ring_init(&ring, LABEL, sizeof(struct record), format) == ESP_OK);
+}
+
+static void append(uint32_t id) {
+    struct record record = { .id = id, .payload = {id * 3, id * 5, id * 7} };
+    CHECK(flash_ring_append(&ring, &record) == ESP_OK);
+}
+
+// every record from the cursor onwards is checked to follow on from the one before
+static uint32_t read_all(struct flash_ring_cursor *cursor, uint32_t *first, uint32_t *last) {
+    struct record records[7];
+    uint32_t count = 0;
+    size_t n;
+    while ((n = flash_ring_read(&ring, cursor, records, 7)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            CHECK(records[i].payload[2] == records[i].id * 7);
+            if (count == 0) {
+                *first = records[i].id;
+            } else {
+                CHECK(records[i].id == *last + 1);
+            }
+            *last = records[i].id;
+            count++;
+        }
+    }
+    return count;
+}
+
+static uint32_t read_from_tail(uint32_t *first, uint32_t *last) {
+    struct flash_ring_cursor cursor;
+    flash_ring_cursor_init(&ring, &cursor);
+    return read_all(&cursor, first, last);
+}
+
+static int compare_id(const void *record, const void *key) {
+    uint32_t id = ((const struct record *)record)->id;
+    uint32_t wanted = *(const uint32_t *)key;
+    return (id > wanted) - (id < wanted);
+}
+
+static void test_append_and_read() {
+    uint32_t first = 0;
+    uint32_t last = 0;
+    CHECK(read_from_tail(&first, &last) == 0);
+
+    for (uint32_t id = 1; id <= 600; id++) {
+        append(id);
+    }
+    CHECK(read_from_tail(&first, &last) == 600);
+    CHECK(first == 1 && last == 600);
+}
+
+static void test_reboot_recovers_head_and_tail() {
+    boot(FORMAT);
+    uint32_t first;
+    uint32_t last;
+    CHECK(read_from_tail(&first, &last) == 600);
+    CHECK(first == 1 && last == 600);
+
+    // appending resumes in the slot after the last record
+    append(601);
+    CHECK(read_from_tail(&first, &last) == 601 && last == 601);
+}
+
+static void test_wrap_recycles_oldest_sector() {
+    uint32_t id = 602;
+    // ten times around the ring
+    for (; id <= 10 * NUM_SECTORS * RECORDS_PER_SECTOR; id++) {
+        append(id);
+    }
+    uint32_t first;
+    uint32_t last;
+    uint32_t count = read_from_tail(&first, &last);
+    CHECK(last == id - 1);
+    // all but the sector being filled are full
+    CHECK(count > (NUM_SECTORS - 1) * RECORDS_PER_SECTOR && count <= NUM_SECTORS * RECORDS_PER_SECTOR);
+
+    // sectors are recycled in ring order, so wear stays even
+    uint32_t min_erases = UINT32_MAX;
+    uint32_t max_erases = 0;
+    for (uint32_t sector = 0; sector < NUM_SECTORS; sector++) {
+        uint32_t erases = host_partition_erase_count(partition, sector);
+        if (erases < min_erases) min_erases = erases;
+        if (erases > max_erases) max_erases = erases;
+    }
+    CHECK(max_erases - min_erases <= 1);
+
+    boot(FORMAT);
+    uint32_t first_after;
+    uint32_t last_after;
+    CHECK(read_from_tail(&first_after, &last_after) == count);
+    CHECK(first_after == first && last_after == last);
+}
+
+static void test_seek() {
+    uint32_t first;
+    uint32_t last;
+    read_from_tail(&first, &last);
+
+    for (uint32_t key = first; key <= last; key += 97) {
+        struct flash_ring_cursor cursor;
+        flash_ring_cursor_seek(&ring, &cursor, compare_id, &key);
+        uint32_t seek_first;
+        uint32_t seek_last;
+        read_all(&cursor, &seek_first, &seek_last);
+        // lands in the sector holding the key, never after it
+        CHECK(seek_first <= key && key - seek_first < RECORDS_PER_SECTOR);
+        CHECK(seek_last == last);
+    }
+}
+
+static void test_overtaken_reader() {
+    struct flash_ring_cursor cursor;
+    flash_ring_cursor_init(&ring, &cursor);
+    struct record record;
+    CHECK(flash_ring_read(&ring, &cursor, &record, 1) == 1);
+
+    // the writer recycles the sector under the reader
+    uint32_t first;
+    uint32_t last;
+    read_from_tail(&first, &last);
+    for (uint32_t id = last + 1; id <= last + NUM_SECTORS * RECORDS_PER_SECTOR; id++) {
+        append(id);
+    }
+    uint32_t overtaken_first;
+    uint32_t overtaken_last;
+    read_all(&cursor, &overtaken_first, &overtaken_last);
+    read_from_tail(&first, &last);
+    CHECK(overtaken_first == first && overtaken_last == last);
+}
+
+static void test_other_format_is_recycled() {
+    boot(FORMAT + 1);
+    uint32_t first;
+    uint32_t last;
+    CHECK(read_from_tail(&first, &last) == 0);
+    append(1);
+    CHECK(read_from_tail(&first, &last) == 1 && first == 1);
+}
+
+int main() {
+    remove(IMAGE);
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    boot(FORMAT);
+
+    test_append_and_read();
+    test_reboot_recovers_head_and_tail();
+    test_wrap_recycles_oldest_sector();
+    test_seek();
+    test_overtaken_reader();
+    test_other_format_is_recycled();
+
+    remove(IMAGE);
+    printf("flash_ring: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "dht_waveform.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "history.h"
+#include "retained.h"
+#include "sdkconfig.h"
+
+#define LABEL "history"
+#define IMAGE "test_history.img"
+// size in partitions.csv
+#define PARTITION_SIZE (768 * 1024)
+#define START_TIME 1709251200 // 2024-03-01
+#define FLUSH_S CONFIG_WEATHER_STATION_HISTORY_FLUSH_S
+#define MAX_RECORDS 4000
+
+static struct history_record appended[MAX_RECORDS];
+static struct history_record read_back[MAX_RECORDS];
+static uint32_t seed = 23;
+static jmp_buf reset_point;
+
+// a reboot with the partition as it was written, after a reset RTC memory
+// still holds the open block, after a power cut it doesn't
+static void boot(const char *image) {
+    CHECK(host_partition_create(LABEL, PARTITION_SIZE, image) != NULL);
+    retained_init();
+    history_init();
+}
+
+static struct history_record record(uint32_t timestamp, int noisy) {
+    struct history_record r = {
+        .timestamp = timestamp,
+        .sd = {
+            .temperature = 2000,
+            .humidity = 5000,
+            .channels = SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY
+        }
+    };
+    if (noisy) {
+        r.sd.temperature += dht_waveform_random(&seed) % 200;
+        r.sd.humidity += dht_waveform_random(&seed) % 300;
+    }
+    return r;
+}
+
+static void append(int *count, struct history_record r) {
+    CHECK(*count < MAX_RECORDS);
+    appended[(*count)++] = r;
+    history_append(r.timestamp, r.sd);
+}
+
+static int read_all(struct history_record *records) {
+    struct history_cursor cursor;
+    history_cursor_init(&cursor);
+    int read = 0;
+    size_t n;
+    while ((n = history_read(&cursor, records + read, 16)) > 0) {
+        read += n;
+    }
+    return read;
+}
+
+static int same_record(const struct history_record *a, const struct history_record *b) {
+    return a->timestamp == b->timestamp
+        && a->sd.temperature == b->sd.temperature
+        && a->sd.humidity == b->sd.humidity;
+}
+
+// a reader that keeps coming back while the writer appends sees every
+// record once, whether it read a record from the open block or after the
+// block was flushed
+static void test_reader_follows_writer() {
+    boot(NULL);
+    struct history_cursor cursor;
+    history_cursor_init(&cursor);
+    int count = 0;
+    int read = 0;
+    uint32_t t = START_TIME;
+    while (count < MAX_RECORDS - 3) {
+        int n = 1 + dht_waveform_random(&seed) % 3;
+        for (int i = 0; i < n; i++, t += 60) {
+            append(&count, record(t, dht_waveform_random(&seed) % 4 == 0));
+        }
+        if (dht_waveform_random(&seed) % 3 == 0) {
+            size_t max = 1 + dht_waveform_random(&seed) % 8;
+            read += history_read(&cursor, read_back + read, max);
+        }
+    }
+    size_t n;
+    while ((n = history_read(&cursor, read_back + read, 16)) > 0) {
+        read += n;
+    }
+    CHECK(read == count);
+    for (int i = 0; i < count; i++) {
+        CHECK(same_record(&read_back[i], &appended[i]));
+    }
+    // nothing new, nothing repeated
+    CHECK(history_read(&cursor, read_back, 16) == 0);
+}
+
+// a power cut loses the open block, which is never older than FLUSH_S
+static void test_power_cut_loss() {
+    remove(IMAGE);
+    host_power_cut();
+    boot(IMAGE);
+    int count = 0;
+    // one unchanged reading every ten minutes, a block would hold most of a day of them
+    for (uint32_t t = START_TIME; t < START_TIME + 86400; t += 600) {
+        append(&count, record(t, 0));
+
+        if (dht_waveform_random(&seed) % 5 == 0) {
+            host_power_cut();
+            boot(IMAGE);
+            int read = read_all(read_back);
+            for (int i = 0; i < read; i++) {
+                CHECK(same_record(&read_back[i], &appended[i]));
+            }
+            CHECK(read == count || appended[read].timestamp + FLUSH_S > t);
+            // what the cut lost is gone, the log carries on from what is left
+            count = read;
+        }
+    }
+}
+
+static void check_read_back(int count) {
+    CHECK(read_all(read_back) == count);
+    for (int i = 0; i < count; i++) {
+        CHECK(same_record(&read_back[i], &appended[i]));
+    }
+}
+
+// the block kept over a reset goes to flash at boot, a power cut after that loses nothing
+static void test_reset_then_power_cut() {
+    remove(IMAGE);
+    host_power_cut();
+    boot(IMAGE);
+    int count = 0;
+    for (uint32_t t = START_TIME; count < 10; t += 60) {
+        append(&count, record(t, 1));
+    }
+    boot(IMAGE);
+    host_power_cut();
+    boot(IMAGE);
+    check_read_back(count);
+}
+
+static void reset_after_block_write(size_t offset, size_t size) {
+    if (size == sizeof(struct history_block)) {
+        longjmp(reset_point, 1);
+    }
+}
+
+// a reset right after a block reached flash, before anything else ran,
+// must not store that block again from its copy in RTC memory
+static void test_reset_during_flush() {
+    remove(IMAGE);
+    host_power_cut();
+    boot(IMAGE);
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, LABEL);
+    volatile int count = 0;
+    volatile uint32_t t = START_TIME;
+    int resets = 0;
+    while (count < 1000) {
+        if (setjmp(reset_point) != 0) {
+            host_partition_set_write_hook(partition, NULL);
+            boot(IMAGE);
+            resets++;
+            continue;
+        }
+        // every few blocks the device resets as one lands
+        host_partition_set_write_hook(partition, dht_waveform_random(&seed) % 4 == 0 ? reset_after_block_write : NULL);
+        int n = count;
+        append(&n, record(t, 1));
+        count = n;
+        t += 60;
+    }
+    host_partition_set_write_hook(partition, NULL);
+    CHECK(resets > 5);
+    check_read_back(count);
+}
+
+int main() {
+    esp_log_level_set("*", ESP_LOG_WARN);
+    test_reader_follows_writer();
+    test_power_cut_loss();
+    test_reset_then_power_cut();
+    test_reset_during_flush();
+    remove(IMAGE);
+    printf("history: ok\n");
+    return 0;
+}
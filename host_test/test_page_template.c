@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "esp_http_server.h"
+#include "page_template.h"
+
+#define TEMPLATE_PATH "test_page_template.html"
+
+static const char *const slot_names[] = {"a", "b"};
+
+static void write_template(const char *text) {
+    FILE *f = fopen(TEMPLATE_PATH, "w");
+    CHECK(f != NULL);
+    fputs(text, f);
+    fclose(f);
+}
+
+static const char *render(const struct page_template *tmpl, char (*values)[PAGE_TEMPLATE_VALUE_LEN], httpd_req_t *req) {
+    size_t len;
+    host_httpd_capture_reset(req);
+    CHECK(page_template_render(tmpl, req, values) == ESP_OK);
+    CHECK(host_httpd_capture_status(req) == 200);
+    return host_httpd_capture_body(req, &len);
+}
+
+static void test_render() {
+    struct page_template tmpl;
+    char values[2][PAGE_TEMPLATE_VALUE_LEN] = {"12", "-3.5"};
+    httpd_req_t *req = host_httpd_capture_begin("/", NULL);
+
+    write_template("<p>{{a}} and {{b}}, {{a}}</p>");
+    CHECK(page_template_load(&tmpl, TEMPLATE_PATH, slot_names, 2) == ESP_OK);
+    CHECK(strcmp(render(&tmpl, values, req), "<p>12 and -3.5, 12</p>") == 0);
+    free(tmpl.text);
+
+    // unknown placeholders, unclosed braces and an empty file stay as they are
+    write_template("{{c}} {{a}} {{b");
+    CHECK(page_template_load(&tmpl, TEMPLATE_PATH, slot_names, 2) == ESP_OK);
+    CHECK(strcmp(render(&tmpl, values, req), "{{c}} 12 {{b") == 0);
+    free(tmpl.text);
+
+    write_template("");
+    CHECK(page_template_load(&tmpl, TEMPLATE_PATH, slot_names, 2) == ESP_OK);
+    CHECK(strcmp(render(&tmpl, values, req), "") == 0);
+    free(tmpl.text);
+
+    // more placeholders than segments
+    char text[2048];
+    size_t len = 0;
+    for (int i = 0; i <= PAGE_TEMPLATE_MAX_SEGMENTS; i++) {
+        len += sprintf(text + len, "x{{a}}");
+    }
+    write_template(text);
+    CHECK(page_template_load(&tmpl, TEMPLATE_PATH, slot_names, 2) == ESP_ERR_INVALID_SIZE);
+    // a failed load leaves nothing behind, so the page renders empty
+    CHECK(tmpl.text == NULL);
+    CHECK(tmpl.num_segments == 0);
+    CHECK(strcmp(render(&tmpl, values, req), "") == 0);
+
+    // longer than one render chunk
+    char expected[2048];
+    memset(text, 'z', 1500);
+    strcpy(text + 1500, "{{b}}");
+    memset(expected, 'z', 1500);
+    strcpy(expected + 1500, "-3.5");
+    write_template(text);
+    CHECK(page_template_load(&tmpl, TEMPLATE_PATH, slot_names, 2) == ESP_OK);
+    CHECK(strcmp(render(&tmpl, values, req), expected) == 0);
+    free(tmpl.text);
+
+    host_httpd_capture_end(req);
+}
+
+static void test_missing_file() {
+    struct page_template tmpl;
+    memset(&tmpl, 0xa5, sizeof(tmpl));
+    CHECK(page_template_load(&tmpl, "no_such_template.html", slot_names, 2) == ESP_ERR_NOT_FOUND);
+    CHECK(tmpl.text == NULL);
+    CHECK(tmpl.num_segments == 0);
+}
+
+int main() {
+    test_render();
+    test_missing_file();
+    remove(TEMPLATE_PATH);
+    printf("page template: ok\n");
+    return 0;
+}
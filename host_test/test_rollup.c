@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "dht_waveform.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "retained.h"
+#include "rollup.h"
+
+// sizes in partitions.csv
+#define HOUR_PARTITION_SIZE (64 * 1024)
+#define DAY_PARTITION_SIZE (16 * 1024)
+
+#define NUM_DAYS 92
+#define START_TIME 1704067200 // 2024-01-01
+#define SAMPLE_PERIOD 60
+// the hourly partition holds a bit over six weeks
+#define MIN_HOURS_KEPT (42 * 24)
+
+struct reference {
+    int64_t temperature_sum;
+    int64_t humidity_sum;
+    int64_t pressure_sum;
+    int32_t temperature_min, temperature_max;
+    int32_t humidity_min, humidity_max;
+    int64_t pressure_min, pressure_max;
+    uint32_t count;
+};
+
+static struct reference hours[NUM_DAYS * 24];
+static struct reference days[NUM_DAYS];
+
+static void reference_add(struct reference *r, struct sensor_data sd) {
+    if (r->count == 0) {
+        r->temperature_min = r->temperature_max = sd.temperature;
+        r->humidity_min = r->humidity_max = sd.humidity;
+        r->pressure_min = r->pressure_max = sd.pressure;
+    }
+    if (sd.temperature < r->temperature_min) r->temperature_min = sd.temperature;
+    if (sd.temperature > r->temperature_max) r->temperature_max = sd.temperature;
+    if (sd.humidity < r->humidity_min) r->humidity_min = sd.humidity;
+    if (sd.humidity > r->humidity_max) r->humidity_max = sd.humidity;
+    if (sd.pressure < r->pressure_min) r->pressure_min = sd.pressure;
+    if (sd.pressure > r->pressure_max) r->pressure_max = sd.pressure;
+    r->temperature_sum += sd.temperature;
+    r->humidity_sum += sd.humidity;
+    r->pressure_sum += sd.pressure;
+    r->count++;
+}
+
+static void check_bucket(const struct rollup_bucket *bucket, const struct reference *r, uint32_t start) {
+    CHECK(bucket->start == start);
+    CHECK(bucket->count == r->count);
+    CHECK(bucket->temperature_sum == r->temperature_sum);
+    CHECK(bucket->humidity_sum == r->humidity_sum);
+    CHECK((int64_t)bucket->pressure_sum == r->pressure_sum);
+    CHECK(bucket->temperature_min == r->temperature_min);
+    CHECK(bucket->temperature_max == r->temperature_max);
+    CHECK(bucket->humidity_min == r->humidity_min);
+    CHECK(bucket->humidity_max == r->humidity_max);
+    CHECK(bucket->pressure_min == r->pressure_min);
+    CHECK(bucket->pressure_max == r->pressure_max);
+    CHECK(bucket->channels == (SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY | SENSOR_CHANNEL_PRESSURE));
+}
+
+// a daily swing with noise, inside what the sensors can report
+static struct sensor_data synthetic(uint32_t t, uint32_t *seed) {
+    int32_t phase = t % 86400;
+    int32_t triangle = phase < 43200 ? phase : 86400 - phase;
+    uint32_t r = dht_waveform_random(seed);
+    struct sensor_data sd = {
+        .temperature = -500 + triangle / 20 + (int32_t)(r % 101) - 50,
+        .humidity = 9000 - triangle / 8 + (r >> 8) % 41,
+        .pressure = 98000 + (t / 3600) % 4000 + (r >> 16) % 11,
+        .channels = SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY | SENSOR_CHANNEL_PRESSURE
+    };
+    return sd;
+}
+
+static bool in_outage(uint32_t t) {
+    uint32_t day = (t - START_TIME) / 86400;
+    uint32_t hour = (t - START_TIME) % 86400 / 3600;
+    // a power cut over an evening and one over a whole weekend
+    return (day == 20 && hour >= 15 && hour < 22) || day == 50 || day == 51;
+}
+
+// merging the pieces of any split gives the bucket of the whole run
+static void test_merge() {
+    uint32_t seed = 3;
+    for (int run = 0; run < 2000; run++) {
+        struct rollup_bucket whole = {0};
+        struct rollup_bucket merged = {0};
+        struct rollup_bucket piece = {0};
+        int len = 1 + dht_waveform_random(&seed) % 200;
+        for (int i = 0; i < len; i++) {
+            struct sensor_data sd = synthetic(dht_waveform_random(&seed), &seed);
+            rollup_bucket_add(&whole, sd);
+            rollup_bucket_add(&piece, sd);
+            if (dht_waveform_random(&seed) % 8 == 0) {
+                rollup_bucket_merge(&merged, &piece);
+                memset(&piece, 0, sizeof(piece));
+            }
+        }
+        rollup_bucket_merge(&merged, &piece);
+        CHECK(memcmp(&whole, &merged, sizeof(whole)) == 0);
+    }
+}
+
+// a warm reset in the middle of an hour keeps the samples taken so far
+static void test_reset_mid_period() {
+    uint32_t t = 1672531200; // 2023-01-01
+    uint32_t seed = 5;
+    struct reference r = {0};
+    for (int i = 0; i < 40; i++, t += 60) {
+        if (i == 25) {
+            rollup_init();
+        }
+        struct sensor_data sd = synthetic(t, &seed);
+        rollup_add(t, sd);
+        reference_add(&r, sd);
+    }
+
+    struct rollup_cursor cursor;
+    struct rollup_bucket bucket;
+    rollup_cursor_init(&cursor, ROLLUP_HOURLY, 1672531200, 1672531200 + 3599);
+    CHECK(rollup_next(&cursor, &bucket));
+    check_bucket(&bucket, &r, 1672531200);
+    CHECK(!rollup_next(&cursor, &bucket));
+}
+
+static void test_months() {
+    uint32_t seed = 7;
+    uint32_t end = START_TIME + NUM_DAYS * 86400;
+    int samples = 0;
+    int resets = 0;
+    for (uint32_t t = START_TIME + 17; t < end; t += SAMPLE_PERIOD - 5 + dht_waveform_random(&seed) % 11) {
+        if (in_outage(t)) continue;
+        // warm resets every few days, anywhere in an hour
+        if (dht_waveform_random(&seed) % 4000 == 0) {
+            rollup_init();
+            resets++;
+        }
+        struct sensor_data sd = synthetic(t, &seed);
+        rollup_add(t, sd);
+        reference_add(&hours[(t - START_TIME) / 3600], sd);
+        reference_add(&days[(t - START_TIME) / 86400], sd);
+        samples++;
+    }
+    printf("%d samples over %d days with %d resets\n", samples, NUM_DAYS, resets);
+    CHECK(resets > 10);
+
+    // every day, the last one still open
+    struct rollup_cursor cursor;
+    struct rollup_bucket bucket;
+    rollup_cursor_init(&cursor, ROLLUP_DAILY, START_TIME, end);
+    for (int day = 0; day < NUM_DAYS; day++) {
+        if (days[day].count == 0) continue;
+        CHECK(rollup_next(&cursor, &bucket));
+        check_bucket(&bucket, &days[day], START_TIME + day * 86400);
+    }
+    CHECK(!rollup_next(&cursor, &bucket));
+
+    // the ring has dropped the oldest hours, the rest must be complete
+    rollup_cursor_init(&cursor, ROLLUP_HOURLY, START_TIME, end);
+    CHECK(rollup_next(&cursor, &bucket));
+    int first = (bucket.start - START_TIME) / 3600;
+    CHECK(NUM_DAYS * 24 - first >= MIN_HOURS_KEPT);
+    int kept = 0;
+    for (int hour = first; hour < NUM_DAYS * 24; hour++) {
+        if (hours[hour].count == 0) continue;
+        if (kept > 0) {
+            CHECK(rollup_next(&cursor, &bucket));
+        }
+        check_bucket(&bucket, &hours[hour], START_TIME + hour * 3600);
+        kept++;
+    }
+    CHECK(!rollup_next(&cursor, &bucket));
+    printf("%d hours kept\n", kept);
+
+    // a window in the middle, starting mid-day
+    uint32_t from = START_TIME + 10 * 86400 + 5000;
+    uint32_t to = START_TIME + 25 * 86400;
+    rollup_cursor_init(&cursor, ROLLUP_DAILY, from, to);
+    for (int day = 10; day <= 25; day++) {
+        if (days[day].count == 0) continue;
+        CHECK(rollup_next(&cursor, &bucket));
+        check_bucket(&bucket, &days[day], START_TIME + day * 86400);
+    }
+    CHECK(!rollup_next(&cursor, &bucket));
+}
+
+int main() {
+    esp_log_level_set("*", ESP_LOG_WARN);
+    retained_init();
+    CHECK(host_partition_create("rollup_hour", HOUR_PARTITION_SIZE, NULL) != NULL);
+    CHECK(host_partition_create("rollup_day", DAY_PARTITION_SIZE, NULL) != NULL);
+    rollup_init();
+
+    test_merge();
+    test_reset_mid_period();
+    test_months();
+
+    printf("rollup: ok\n");
+    return 0;
+}
@@ -0,0 +1,257 @@
+// Noisy readings through the sample filter: sensor noise around a level,
+// lone spikes and bursts of disagreeing spikes, impossible values, a real
+// step to a new level and a slow drift. Without smoothing the output must
+// be exactly the median of the accepted readings since the last restart.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "dht_waveform.h"
+#include "sample_filter.h"
+
+#define NUM_READINGS 20000
+// the firmware defaults, in the channel units
+#define TEMPERATURE_JUMP 500
+#define HUMIDITY_JUMP 2000
+#define PRESSURE_JUMP 500
+// well inside the jump limits
+#define TEMPERATURE_NOISE 40
+#define HUMIDITY_NOISE 150
+#define PRESSURE_NOISE 30
+
+static uint32_t seed = 31;
+
+// the accepted readings the filter should be taking the median of
+struct window {
+    int32_t readings[3][SAMPLE_FILTER_MAX_WINDOW];
+    int count;
+    int next;
+};
+
+static struct sample_filter_config config(uint8_t window, uint8_t ema_percent) {
+    return (struct sample_filter_config){
+        .window = window,
+        .ema_percent = ema_percent,
+        .max_temperature_jump = TEMPERATURE_JUMP,
+        .max_humidity_jump = HUMIDITY_JUMP,
+        .max_pressure_jump = PRESSURE_JUMP
+    };
+}
+
+static int32_t noise(int32_t amplitude) {
+    return (int32_t)(dht_waveform_random(&seed) % (2 * amplitude + 1)) - amplitude;
+}
+
+static struct sensor_data reading(int32_t temperature, int32_t humidity, int32_t pressure) {
+    return (struct sensor_data){
+        .temperature = temperature + noise(TEMPERATURE_NOISE),
+        .humidity = humidity + noise(HUMIDITY_NOISE),
+        .pressure = pressure + noise(PRESSURE_NOISE),
+        .channels = SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY | SENSOR_CHANNEL_PRESSURE
+    };
+}
+
+static int compare(const void *a, const void *b) {
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void window_add(struct window *w, int size, struct sensor_data sd) {
+    w->readings[0][w->next] = sd.temperature;
+    w->readings[1][w->next] = sd.humidity;
+    w->readings[2][w->next] = sd.pressure;
+    w->next = (w->next + 1) % size;
+    if (w->count < size) w->count++;
+}
+
+static int32_t window_median(const struct window *w, int channel) {
+    int32_t sorted[SAMPLE_FILTER_MAX_WINDOW];
+    for (int i = 0; i < w->count; i++) {
+        sorted[i] = w->readings[channel][i];
+    }
+    qsort(sorted, w->count, sizeof(sorted[0]), compare);
+    int n = w->count;
+    return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+// a raw reading the filter must take, the output is the median of the window
+static void add_accepted(struct sample_filter *filter, struct window *w, int size, struct sensor_data raw) {
+    struct sensor_data sd = raw;
+    CHECK(sample_filter_add(filter, &sd) == SAMPLE_FILTER_ACCEPTED);
+    CHECK(sd.quality == SENSOR_QUALITY_GOOD);
+    window_add(w, size, raw);
+    CHECK(sd.temperature == window_median(w, 0));
+    CHECK(sd.humidity == window_median(w, 1));
+    CHECK((int32_t)sd.pressure == window_median(w, 2));
+}
+
+// noise is passed through the median, lone spikes and spikes that disagree
+// with each other are all rejected, impossible values never reach the window
+static void test_noise_and_spikes(int size) {
+    struct sample_filter filter;
+    struct sample_filter_config c = config(size, 100);
+    sample_filter_init(&filter, &c);
+    struct window w = {0};
+    int spikes = 0;
+    bool spiked = true;
+
+    for (int i = 0; i < NUM_READINGS; i++) {
+        uint32_t r = dht_waveform_random(&seed) % 100;
+        struct sensor_data sd = reading(2150, 4500, 101300);
+        // lone, a few alike in a row would be a real step
+        if (!spiked && r < 4) {
+            // one channel further from any median of the noise than its limit, either way
+            int32_t sign = r % 2 ? 1 : -1;
+            int32_t extra = dht_waveform_random(&seed) % 1000;
+            if (r < 2) {
+                sd.temperature += sign * (TEMPERATURE_JUMP + 2 * TEMPERATURE_NOISE + 1 + extra);
+            } else {
+                sd.pressure += sign * (PRESSURE_JUMP + 2 * PRESSURE_NOISE + 1 + extra);
+            }
+            struct sensor_data before = sd;
+            CHECK(sample_filter_add(&filter, &sd) == SAMPLE_FILTER_JUMP);
+            CHECK(sd.temperature == before.temperature && sd.pressure == before.pressure);
+            spikes++;
+            spiked = true;
+            continue;
+        }
+        spiked = false;
+        if (r < 6) {
+            // a burst of spikes that swing both ways never confirms a new level
+            for (int j = 0; j < 2 * SAMPLE_FILTER_JUMP_CONFIRM; j++) {
+                struct sensor_data spike = reading(2150 + (j % 2 ? 1000 : -1000), 4500, 101300);
+                CHECK(sample_filter_add(&filter, &spike) == SAMPLE_FILTER_JUMP);
+                spikes++;
+            }
+            add_accepted(&filter, &w, size, sd);
+        } else if (r < 8) {
+            struct sensor_data impossible[] = {
+                reading(9000, 4500, 101300),
+                reading(-4500, 4500, 101300),
+                reading(2150, 10500, 101300),
+                reading(2150, 4500, 20000),
+                reading(2150, 4500, 120000)
+            };
+            struct sensor_data bad = impossible[r % 5];
+            CHECK(sample_filter_add(&filter, &bad) == SAMPLE_FILTER_IMPLAUSIBLE);
+            add_accepted(&filter, &w, size, sd);
+        } else {
+            add_accepted(&filter, &w, size, sd);
+        }
+    }
+    CHECK(spikes > NUM_READINGS / 50);
+}
+
+// a real change arrives as readings that agree with each other, the third
+// restarts the filter at the new level, noise and all
+static void test_step() {
+    struct sample_filter filter;
+    struct sample_filter_config c = config(3, 100);
+    sample_filter_init(&filter, &c);
+    struct window w = {0};
+
+    int32_t level = 2000;
+    for (int step = 0; step < 200; step++) {
+        for (int i = 0; i < 10; i++) {
+            add_accepted(&filter, &w, 3, reading(level, 5000, 100000));
+        }
+        // up or down by 8 to 15 degrees, staying in range
+        int32_t change = 800 + dht_waveform_random(&seed) % 700;
+        level += level > 3000 ? -change : change;
+
+        for (int i = 1; i < SAMPLE_FILTER_JUMP_CONFIRM; i++) {
+            struct sensor_data sd = reading(level, 5000, 100000);
+            CHECK(sample_filter_add(&filter, &sd) == SAMPLE_FILTER_JUMP);
+        }
+        struct sensor_data raw = reading(level, 5000, 100000);
+        struct sensor_data sd = raw;
+        CHECK(sample_filter_add(&filter, &sd) == SAMPLE_FILTER_ACCEPTED);
+        CHECK(sd.quality == SENSOR_QUALITY_RESTARTED);
+        // the window starts over with the reading that confirmed the step
+        w = (struct window){0};
+        window_add(&w, 3, raw);
+        CHECK(sd.temperature == raw.temperature && sd.humidity == raw.humidity && sd.pressure == raw.pressure);
+    }
+}
+
+// a spike in the middle of a confirming run starts the run over
+static void test_interrupted_step() {
+    struct sample_filter filter;
+    struct sample_filter_config c = config(3, 100);
+    sample_filter_init(&filter, &c);
+    struct window w = {0};
+    for (int i = 0; i < 5; i++) {
+        add_accepted(&filter, &w, 3, reading(2000, 5000, 100000));
+    }
+
+    struct sensor_data sd = reading(3000, 5000, 100000);
+    CHECK(sample_filter_add(&filter, &sd) == SAMPLE_FILTER_JUMP);
+    sd = reading(1000, 5000, 100000);
+    CHECK(sample_filter_add(&filter, &sd) == SAMPLE_FILTER_JUMP);
+    sd = reading(3000, 5000, 100000);
+    CHECK(sample_filter_add(&filter, &sd) == SAMPLE_FILTER_JUMP);
+    sd = reading(3000, 5000, 100000);
+    CHECK(sample_filter_add(&filter, &sd) == SAMPLE_FILTER_JUMP);
+    sd = reading(3000, 5000, 100000);
+    CHECK(sample_filter_add(&filter, &sd) == SAMPLE_FILTER_ACCEPTED);
+    CHECK(sd.quality == SENSOR_QUALITY_RESTARTED);
+}
+
+// channels the sensor doesn't have are neither checked nor filtered
+static void test_missing_channels() {
+    struct sample_filter filter;
+    struct sample_filter_config c = config(3, 100);
+    sample_filter_init(&filter, &c);
+    for (int i = 0; i < 100; i++) {
+        struct sensor_data sd = reading(2150, 4500, 0);
+        sd.pressure = i % 2 ? 0 : 500000;
+        sd.channels = SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY;
+        uint32_t pressure = sd.pressure;
+        CHECK(sample_filter_add(&filter, &sd) == SAMPLE_FILTER_ACCEPTED);
+        CHECK(sd.pressure == pressure);
+    }
+}
+
+// with the moving average the output stays between the lowest and highest
+// accepted reading, follows a slow drift and is much steadier than the input
+static void test_smoothing() {
+    struct sample_filter filter;
+    struct sample_filter_config c = config(5, 20);
+    sample_filter_init(&filter, &c);
+
+    int64_t in_error = 0, out_error = 0;
+    int32_t lowest = INT32_MAX, highest = INT32_MIN;
+    for (int i = 0; i < NUM_READINGS; i++) {
+        // a degree of drift every thousand readings
+        int32_t level = 2000 + i / 10;
+        struct sensor_data raw = reading(level, 4500, 101300);
+        struct sensor_data sd = raw;
+        CHECK(sample_filter_add(&filter, &sd) == SAMPLE_FILTER_ACCEPTED);
+        lowest = raw.temperature < lowest ? raw.temperature : lowest;
+        highest = raw.temperature > highest ? raw.temperature : highest;
+        CHECK(sd.temperature >= lowest && sd.temperature <= highest);
+        // the median and the average lag the drift by a few readings, under a hundredth
+        if (i >= 100) {
+            in_error += abs(raw.temperature - level);
+            out_error += abs(sd.temperature - level);
+            CHECK(abs(sd.temperature - level) <= TEMPERATURE_NOISE + 1);
+        }
+    }
+    printf("mean temperature error %.1f in, %.1f out (hundredths of a degree)\n",
+        (double)in_error / (NUM_READINGS - 100), (double)out_error / (NUM_READINGS - 100));
+    CHECK(out_error * 2 < in_error);
+}
+
+int main() {
+    for (int size = 1; size <= SAMPLE_FILTER_MAX_WINDOW; size++) {
+        test_noise_and_spikes(size);
+    }
+    test_step();
+    test_interrupted_step();
+    test_missing_channels();
+    test_smoothing();
+    printf("sample_filter: ok\n");
+    return 0;
+}
@@ -0,0 +1,211 @@
+// A day of sampling on a simulated clock. The sensor fails now and then and
+// is dead for ten minutes, SNTP corrects the wall clock every hour and steps
+// it once backwards and once forwards by a lot. Readings must stay on the
+// period boundaries for the whole day, retries must come before the next
+// boundary, and no period may be lost to a deadline left far in the future.
+// Before that, the first SNTP update moves the clock from 1970 to now.
+
+#include <stdio.h>
+
+#include "check.h"
+#include "dht_waveform.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "host_clock.h"
+#include "retained.h"
+#include "sampler.h"
+#include "sdkconfig.h"
+
+#define PERIOD_US ((int64_t)CONFIG_WEATHER_STATION_SAMPLE_PERIOD_MS * 1000)
+#define RETRY_US ((int64_t)CONFIG_WEATHER_STATION_SAMPLE_RETRY_MS * 1000)
+#define MAX_RETRIES CONFIG_WEATHER_STATION_SAMPLE_MAX_RETRIES
+
+#define HOUR_US (3600LL * 1000000)
+#define RUN_US (24 * HOUR_US)
+#define START_TIME_US (1709251200LL * 1000000 + 7300000) // 2024-03-01, off any boundary
+// a read takes 25 to 45 ms, the wakeup may be a tick late
+#define READ_MIN_US 25000
+#define READ_MAX_US 45000
+#define MAX_LATE_US 20000
+#define FAILURE_PERCENT 8
+#define DEAD_FROM_US (3 * HOUR_US + 600LL * 1000000)
+#define DEAD_TO_US (DEAD_FROM_US + 600LL * 1000000)
+// the crystal runs 40 ppm slow, SNTP steps the wall clock forward every hour
+#define HOURLY_STEP_US 144000
+#define BACK_STEP_US (-30LL * 1000000)
+#define FORWARD_STEP_US (90LL * 1000000)
+
+struct counts {
+    uint32_t boundaries;
+    uint32_t retries;
+    uint32_t successes;
+    uint32_t give_ups;
+    uint32_t interrupted;
+};
+
+static uint32_t seed = 17;
+static int64_t total_step_us = 0;
+
+static void step_wall_clock(int64_t step_us) {
+    host_clock_set_wall_us(host_clock_wall_us() + step_us);
+    total_step_us += step_us;
+}
+
+// steady most of the day, swinging by a degree a reading in hour nine so
+// adaptive sampling speeds up
+static struct sensor_data reading(int64_t mono_us) {
+    static int toggle = 0;
+    struct sensor_data sd = {
+        .temperature = 2000,
+        .humidity = 5000,
+        .channels = SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY
+    };
+    if (mono_us / HOUR_US == 9) {
+        toggle = !toggle;
+        sd.temperature += toggle * 100;
+    }
+    return sd;
+}
+
+// the clock starts at 1970 until SNTP sets it, the deadline set before then
+// is not decades of lateness, and the schedule moves to the boundaries of now
+static void test_first_sntp_step() {
+    host_clock_set_wall_us(5LL * 1000000);
+    retained_init();
+    sampler_init();
+    int64_t late_us = sampler_wait();
+    CHECK(late_us >= 0 && late_us < MAX_LATE_US);
+    sampler_success(reading(0));
+
+    host_clock_set_wall_us(START_TIME_US);
+    CHECK(sampler_wait() == 0);
+    sampler_success(reading(0));
+    late_us = sampler_wait();
+    CHECK(late_us >= 0 && late_us < MAX_LATE_US);
+    CHECK(host_clock_wall_us() % ((int64_t)sampler_period_ms() * 1000) < MAX_LATE_US);
+    // the day below starts from a cold boot
+    host_power_cut();
+}
+
+int main() {
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    host_clock_set_mode(HOST_CLOCK_SIMULATED);
+    test_first_sntp_step();
+    host_clock_set_wall_us(START_TIME_US);
+    retained_init();
+    sampler_init();
+
+    struct counts counts = {0};
+    int64_t start_us = esp_timer_get_time();
+    int64_t previous_attempt_us = start_us;
+    int64_t previous_wall_us = START_TIME_US;
+    int64_t previous_gap_limit_us = 0;
+    int64_t last_hour = 0;
+    int stepped_since_attempt = 0;
+    int forward_since_attempt = 0;
+    int back_on_failure = 0, back_on_success = 0, forward = 0;
+    uint32_t attempts_in_period = 0;
+    int period_open = 0;
+    int64_t mono_us = 0;
+
+    while ((mono_us = esp_timer_get_time() - start_us) < RUN_US || period_open) {
+        int64_t late_us = sampler_wait();
+        int64_t now_us = esp_timer_get_time();
+        int64_t wall_us = host_clock_wall_us();
+        CHECK(late_us >= 0 && (late_us < MAX_LATE_US || forward_since_attempt));
+
+        // nothing ever sleeps past one period, whatever the wall clock did
+        if (counts.boundaries > 0) {
+            CHECK(now_us - previous_attempt_us <= previous_gap_limit_us);
+        }
+
+        if (sampler_retries() == 0) {
+            // only the first reading and the one right after the big step forward are off the boundary
+            if (counts.boundaries > 0 && !forward_since_attempt) {
+                CHECK(wall_us % ((int64_t)sampler_period_ms() * 1000) < MAX_LATE_US);
+            }
+            if (period_open) {
+                counts.interrupted++;
+            }
+            counts.boundaries++;
+            attempts_in_period = 1;
+            period_open = 1;
+        } else {
+            CHECK(period_open);
+            if (!stepped_since_attempt) {
+                CHECK(wall_us - previous_wall_us >= RETRY_US);
+                CHECK(wall_us - previous_wall_us < RETRY_US + READ_MAX_US + MAX_LATE_US);
+                CHECK(wall_us / PERIOD_US == previous_wall_us / PERIOD_US);
+            }
+            counts.retries++;
+            attempts_in_period++;
+        }
+        previous_attempt_us = now_us;
+        previous_wall_us = wall_us;
+        stepped_since_attempt = 0;
+        forward_since_attempt = 0;
+
+        host_clock_advance(READ_MIN_US + dht_waveform_random(&seed) % (READ_MAX_US - READ_MIN_US));
+        mono_us = esp_timer_get_time() - start_us;
+        int failed = (mono_us >= DEAD_FROM_US && mono_us < DEAD_TO_US)
+            || (int)(dht_waveform_random(&seed) % 100) < FAILURE_PERCENT;
+        if (failed) {
+            sampler_failure();
+            if (sampler_retries() == 0) {
+                // every retry was taken unless the next one would have met the boundary
+                if ((MAX_RETRIES + 1) * (RETRY_US + READ_MAX_US + MAX_LATE_US) < PERIOD_US) {
+                    CHECK(attempts_in_period == MAX_RETRIES + 1);
+                } else {
+                    CHECK(attempts_in_period <= MAX_RETRIES + 1);
+                }
+                counts.give_ups++;
+                period_open = 0;
+            }
+        } else {
+            sampler_success(reading(mono_us));
+            counts.successes++;
+            period_open = 0;
+        }
+        // SNTP, stepping the clock between a read and the next wait
+        if (mono_us / HOUR_US != last_hour) {
+            last_hour = mono_us / HOUR_US;
+            step_wall_clock(HOURLY_STEP_US);
+            stepped_since_attempt = 1;
+        }
+        if (mono_us >= 6 * HOUR_US && failed && !back_on_failure) {
+            step_wall_clock(BACK_STEP_US);
+            back_on_failure = stepped_since_attempt = 1;
+        }
+        if (mono_us >= 9 * HOUR_US + HOUR_US / 2 && !failed && !back_on_success) {
+            step_wall_clock(BACK_STEP_US);
+            back_on_success = stepped_since_attempt = 1;
+        }
+        if (mono_us >= 12 * HOUR_US && !failed && !forward) {
+            step_wall_clock(FORWARD_STEP_US);
+            forward = stepped_since_attempt = forward_since_attempt = 1;
+        }
+        // a step back may put the next boundary up to a period away, even during retries
+        previous_gap_limit_us = READ_MAX_US + MAX_LATE_US + (sampler_retries() > 0 && !stepped_since_attempt
+            ? RETRY_US
+            : (int64_t)sampler_period_ms() * 1000);
+    }
+
+    printf("%lu boundaries, %lu retries, %lu readings, %lu given up, %lu cut short, wall clock stepped %lld ms\n",
+        (unsigned long)counts.boundaries, (unsigned long)counts.retries, (unsigned long)counts.successes,
+        (unsigned long)counts.give_ups, (unsigned long)counts.interrupted, (long long)(total_step_us / 1000));
+    CHECK(back_on_failure && back_on_success && forward);
+    // a period ends in a reading or giving up, only the step back during retries cuts one short
+    CHECK(counts.interrupted <= 1);
+    CHECK(counts.successes + counts.give_ups + counts.interrupted == counts.boundaries);
+    CHECK(counts.give_ups >= DEAD_TO_US / PERIOD_US - DEAD_FROM_US / PERIOD_US - 1);
+#if !CONFIG_WEATHER_STATION_ADAPTIVE_SAMPLING
+    // steps only shift the phase, so there is a reading per period of the
+    // day, one more for the first reading, one for the period still open at
+    // the end and at most one for each big step
+    int64_t expected = RUN_US / PERIOD_US;
+    CHECK(counts.boundaries >= expected && counts.boundaries <= expected + 5);
+#endif
+    printf("sampler: ok\n");
+    return 0;
+}
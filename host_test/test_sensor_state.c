@@ -0,0 +1,116 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "check.h"
+#include "retained.h"
+#include "sensor_state.h"
+
+#define NUM_READERS 3
+// long enough for the scheduler to preempt readers mid-copy on a single core
+#define RUN_TIME_NS 1000000000LL
+
+static atomic_bool writer_done;
+
+// every field follows from the publish count, so a snapshot mixing two
+// publishes doesn't add up
+static struct sensor_data reading(uint32_t n) {
+    struct sensor_data sd = {
+        .temperature = n % 20000 - 5000,
+        .humidity = n * 7 % 10000,
+        .pressure = n,
+        .channels = SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY | SENSOR_CHANNEL_PRESSURE,
+        .quality = n % NUM_SENSOR_QUALITIES
+    };
+    return sd;
+}
+
+static void check_snapshot(const struct sensor_snapshot *snapshot) {
+    struct sensor_data expected = reading(snapshot->seq);
+    CHECK(snapshot->sd.pressure == expected.pressure);
+    CHECK(snapshot->sd.temperature == expected.temperature);
+    CHECK(snapshot->sd.humidity == expected.humidity);
+    CHECK(snapshot->sd.channels == expected.channels);
+    CHECK(snapshot->sd.quality == expected.quality);
+}
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *writer(void *arg) {
+    uint32_t *num_publishes = arg;
+    int64_t end = now_ns() + RUN_TIME_NS;
+    uint32_t n = 0;
+    while (now_ns() < end) {
+        n++;
+        struct sensor_snapshot published = sensor_state_publish(reading(n));
+        CHECK(published.seq == n);
+        // every thread yields, so on a single core host they take turns
+        sched_yield();
+    }
+    *num_publishes = n;
+    atomic_store(&writer_done, true);
+    return NULL;
+}
+
+static void *reader(void *arg) {
+    uint32_t last_seq = 0;
+    unsigned long *changes = arg;
+    while (!atomic_load(&writer_done)) {
+        struct sensor_snapshot snapshot;
+        if (!sensor_state_get(&snapshot)) {
+            CHECK(last_seq == 0);
+            continue;
+        }
+        check_snapshot(&snapshot);
+        // a reader never sees the state go back
+        CHECK(snapshot.seq >= last_seq);
+        if (snapshot.seq != last_seq) {
+            (*changes)++;
+        }
+        last_seq = snapshot.seq;
+        sched_yield();
+    }
+    return NULL;
+}
+
+int main() {
+    retained_init();
+
+    struct sensor_snapshot snapshot;
+    CHECK(!sensor_state_get(&snapshot));
+    CHECK(!sensor_state_restore());
+
+    pthread_t writer_thread;
+    pthread_t reader_threads[NUM_READERS];
+    unsigned long changes[NUM_READERS] = {0};
+    for (int i = 0; i < NUM_READERS; i++) {
+        CHECK(pthread_create(&reader_threads[i], NULL, reader, &changes[i]) == 0);
+    }
+    uint32_t num_publishes;
+    CHECK(pthread_create(&writer_thread, NULL, writer, &num_publishes) == 0);
+    pthread_join(writer_thread, NULL);
+    for (int i = 0; i < NUM_READERS; i++) {
+        pthread_join(reader_threads[i], NULL);
+        printf("reader %d saw %lu of %lu publishes\n", i, changes[i], (unsigned long)num_publishes);
+    }
+
+    CHECK(sensor_state_get(&snapshot));
+    CHECK(snapshot.seq == num_publishes);
+    check_snapshot(&snapshot);
+
+    // after a warm reset the last reading is served again and the sequence carries on
+    CHECK(sensor_state_restore());
+    CHECK(sensor_state_get(&snapshot));
+    CHECK(snapshot.seq == num_publishes);
+    check_snapshot(&snapshot);
+    CHECK(sensor_state_publish(reading(num_publishes + 1)).seq == num_publishes + 1);
+
+    printf("sensor state: ok\n");
+    return 0;
+}
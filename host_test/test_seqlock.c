@@ -0,0 +1,141 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "check.h"
+#include "seqlock.h"
+
+#define NUM_READERS 3
+#define PAYLOAD_WORDS 64
+#define HALF (PAYLOAD_WORDS / 2)
+#define RUN_TIME_NS 1000000000LL
+// turns the writer lets go by between updates, so readers also finish copies
+#define WRITER_IDLE_TURNS 8
+
+// The writer yields halfway through each update and readers halfway through
+// each copy, so even on a single core host readers copy a half written
+// payload, and writes land in the middle of their copies. Without the
+// retry both would be taken as a reading.
+
+struct payload {
+    uint32_t words[PAYLOAD_WORDS];
+};
+
+static seqlock_t seq;
+static struct payload shared;
+static atomic_bool writer_done;
+
+struct reader_stats {
+    unsigned long reads;
+    unsigned long changes;
+    // copies taken the same way but without the retry that mixed two writes
+    unsigned long torn;
+};
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool consistent(const struct payload *p) {
+    for (int i = 1; i < PAYLOAD_WORDS; i++) {
+        if (p->words[i] != p->words[0]) return false;
+    }
+    return true;
+}
+
+static void copy_in_halves(struct payload *copy) {
+    memcpy(copy->words, shared.words, HALF * sizeof(uint32_t));
+    sched_yield();
+    memcpy(copy->words + HALF, shared.words + HALF, HALF * sizeof(uint32_t));
+}
+
+static void *writer(void *arg) {
+    uint32_t *num_writes = arg;
+    int64_t end = now_ns() + RUN_TIME_NS;
+    uint32_t n = 0;
+    while (now_ns() < end) {
+        n++;
+        uint32_t s = seqlock_write_begin(&seq);
+        CHECK(s == (n - 1) * 2);
+        for (int i = 0; i < PAYLOAD_WORDS; i++) {
+            shared.words[i] = n;
+            // long enough for whole copies to start and end mid-update
+            for (int turn = 0; i == HALF && turn < WRITER_IDLE_TURNS; turn++) {
+                sched_yield();
+            }
+        }
+        seqlock_write_end(&seq, s);
+        for (int i = 0; i < WRITER_IDLE_TURNS; i++) {
+            sched_yield();
+        }
+    }
+    *num_writes = n;
+    atomic_store(&writer_done, true);
+    return NULL;
+}
+
+static void *reader(void *arg) {
+    struct reader_stats *stats = arg;
+    uint32_t last = 0;
+    while (!atomic_load(&writer_done)) {
+        struct payload copy;
+        uint32_t s;
+        do {
+            s = seqlock_read_begin(&seq);
+            copy_in_halves(&copy);
+        } while (seqlock_read_retry(&seq, s));
+
+        CHECK(consistent(&copy));
+        CHECK(copy.words[0] == s / 2);
+        CHECK(copy.words[0] >= last);
+        stats->reads++;
+        if (copy.words[0] != last) {
+            stats->changes++;
+        }
+        last = copy.words[0];
+
+        copy_in_halves(&copy);
+        if (!consistent(&copy)) {
+            stats->torn++;
+        }
+    }
+    return NULL;
+}
+
+int main() {
+    seqlock_init(&seq, 0);
+
+    pthread_t writer_thread;
+    pthread_t reader_threads[NUM_READERS];
+    struct reader_stats stats[NUM_READERS] = {0};
+    uint32_t num_writes;
+    for (int i = 0; i < NUM_READERS; i++) {
+        CHECK(pthread_create(&reader_threads[i], NULL, reader, &stats[i]) == 0);
+    }
+    CHECK(pthread_create(&writer_thread, NULL, writer, &num_writes) == 0);
+    pthread_join(writer_thread, NULL);
+
+    unsigned long torn = 0;
+    for (int i = 0; i < NUM_READERS; i++) {
+        pthread_join(reader_threads[i], NULL);
+        printf("reader %d: %lu reads, %lu of %lu writes seen, %lu torn without the retry\n",
+               i, stats[i].reads, stats[i].changes, (unsigned long)num_writes, stats[i].torn);
+        CHECK(stats[i].changes > 0);
+        torn += stats[i].torn;
+    }
+    // otherwise the run proved nothing
+    CHECK(torn > 0);
+
+    uint32_t s = seqlock_read_begin(&seq);
+    CHECK(s == num_writes * 2);
+    CHECK(!seqlock_read_retry(&seq, s));
+    CHECK(shared.words[0] == num_writes);
+
+    printf("seqlock: ok\n");
+    return 0;
+}
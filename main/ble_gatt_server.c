@@ -5,13 +5,44 @@
 #include "esp_gatt_common_api.h"
 #include "esp_gatts_api.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 #include <string.h>
 #include "ble_gatt_server.h"
+#include "boot_profile.h"
+#include "history.h"
+#include "metrics.h"
+#include "sensor_state.h"
+#include "trace.h"
 
 #define TAG "BLE_GATT_SERVER"
 #define DEVICE_NAME "Weather Station"
 
+#define LOCAL_MTU 500
+#define DEFAULT_MTU 23
+#define NOTIFY_HEADER_LEN 3
+// client configuration descriptors are two bytes, writes of any other length are ignored
+#define CCC_LEN 2
+
+// readings go out as packed little endian temperature (2, 0.01 C), humidity (2, 0.01 %) and pressure (4, Pa)
+#define SD_PACKED_LEN 8
+// history records are a little endian timestamp (4) followed by a packed reading
+#define HISTORY_PACKED_RECORD_LEN (4 + SD_PACKED_LEN)
+#define HISTORY_READ_BATCH 32
+#define HISTORY_TASK_STACK 3072
+
+// control point: client writes {opcode, from, to}, server notifies {response, status, count}
+#define HISTORY_OP_START 0x01
+#define HISTORY_OP_ABORT 0x02
+#define HISTORY_OP_RESPONSE 0x80
+#define HISTORY_STATUS_DONE 0x00
+#define HISTORY_STATUS_ABORTED 0x01
+#define HISTORY_STATUS_BUSY 0x02
+#define HISTORY_CTRL_LEN 9
+
 static ble_gatt_server_callback_t callback = NULL;
 
 static uint8_t adv_service_uuid128[32] = {
@@ -48,6 +79,12 @@ struct gatts_profile {
     esp_gatt_if_t gatts_if;
     uint16_t conn_id;
     uint8_t connected;
+    uint16_t mtu;
+};
+
+struct history_request {
+    uint32_t from;
+    uint32_t to;
 };
 
 static struct gatts_profile profile = {};
@@ -56,18 +93,34 @@ static const uint16_t gatts_service_uuid = 0x00FF;
 static const uint16_t gatts_sd_uuid = 0xFF01;
 static const uint16_t gatts_ssid_uuid = 0xFF02;
 static const uint16_t gatts_password_uuid = 0xFF03;
+static const uint16_t gatts_history_uuid = 0xFF04;
+static const uint16_t gatts_history_ctrl_uuid = 0xFF05;
+static const uint16_t gatts_boot_uuid = 0xFF06;
 
 static const uint16_t primary_service_uuid              = ESP_GATT_UUID_PRI_SERVICE;
 static const uint16_t characteristic_declaration_uuid   = ESP_GATT_UUID_CHAR_DECLARE;
 static const uint16_t characteristic_client_config_uuid = ESP_GATT_UUID_CHAR_CLIENT_CONFIG;
 static const uint8_t char_prop_read_notify              = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY;
 static const uint8_t char_prop_write                    = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE;
+static const uint8_t char_prop_notify                   = ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+static const uint8_t char_prop_write_notify             = ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+static const uint8_t char_prop_read                     = ESP_GATT_CHAR_PROP_BIT_READ;
 static uint8_t sd_ccc[2]                                = {0};
-static struct sensor_data sd_value                      = {0};
+static uint8_t history_ccc[2]                           = {0};
+static uint8_t history_ctrl_ccc[2]                      = {0};
+static uint8_t history_value[1]                         = {0};
+static uint8_t history_ctrl_value[HISTORY_CTRL_LEN]     = {0};
+static uint8_t boot_value[BOOT_PROFILE_PACKED_LEN]      = {0};
+static const uint8_t sd_value[SD_PACKED_LEN]            = {0};
 uint8_t ssid_value[SSID_MAX_LEN+1]                      = {0};
 uint8_t password_value[PASSWORD_MAX_LEN+1]              = {0};
 uint8_t ssid_set = 0;
 
+static QueueHandle_t history_requests;
+static SemaphoreHandle_t history_uncongested;
+static volatile uint8_t history_busy = 0;
+static volatile uint8_t history_abort = 0;
+
 enum {
     SERV_IDX,
     SD_IDX,
@@ -77,6 +130,14 @@ enum {
     SSID_VAL_IDX,
     PASS_IDX,
     PASS_VAL_IDX,
+    HIST_IDX,
+    HIST_VAL_IDX,
+    HIST_CCC_IDX,
+    HIST_CTRL_IDX,
+    HIST_CTRL_VAL_IDX,
+    HIST_CTRL_CCC_IDX,
+    BOOT_IDX,
+    BOOT_VAL_IDX,
     NUM_HANDLES
 };
 
@@ -116,7 +177,7 @@ static const esp_gatts_attr_db_t gatts_db[] = {
             ESP_GATT_PERM_READ,
             sizeof(sd_value),
             sizeof(sd_value),
-            (uint8_t *)&sd_value
+            (uint8_t *)sd_value
         }
     },
     // SD Characteristic CCC
@@ -179,8 +240,221 @@ static const esp_gatts_attr_db_t gatts_db[] = {
             (uint8_t *)&password_value
         }
     },
+    // History Characteristic Declaration
+    [HIST_IDX] = {
+        {ESP_GATT_AUTO_RSP},
+        {
+            ESP_UUID_LEN_16,
+            (uint8_t *)&characteristic_declaration_uuid,
+            ESP_GATT_PERM_READ,
+            sizeof(uint8_t),
+            sizeof(uint8_t),
+            (uint8_t *)&char_prop_notify
+        }
+    },
+    // History Characteristic Value
+    [HIST_VAL_IDX] = {
+        {ESP_GATT_AUTO_RSP},
+        {
+            ESP_UUID_LEN_16,
+            (uint8_t *)&gatts_history_uuid,
+            ESP_GATT_PERM_READ,
+            sizeof(history_value),
+            0,
+            (uint8_t *)&history_value
+        }
+    },
+    // History Characteristic CCC
+    [HIST_CCC_IDX] = {
+        {ESP_GATT_AUTO_RSP},
+        {
+            ESP_UUID_LEN_16,
+            (uint8_t *)&characteristic_client_config_uuid,
+            ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+            sizeof(uint16_t),
+            sizeof(history_ccc),
+            (uint8_t *)&history_ccc
+        }
+    },
+    // History Control Point Declaration
+    [HIST_CTRL_IDX] = {
+        {ESP_GATT_AUTO_RSP},
+        {
+            ESP_UUID_LEN_16,
+            (uint8_t *)&characteristic_declaration_uuid,
+            ESP_GATT_PERM_READ,
+            sizeof(uint8_t),
+            sizeof(uint8_t),
+            (uint8_t *)&char_prop_write_notify
+        }
+    },
+    // History Control Point Value
+    [HIST_CTRL_VAL_IDX] = {
+        {ESP_GATT_AUTO_RSP},
+        {
+            ESP_UUID_LEN_16,
+            (uint8_t *)&gatts_history_ctrl_uuid,
+            ESP_GATT_PERM_WRITE,
+            HISTORY_CTRL_LEN,
+            0,
+            (uint8_t *)&history_ctrl_value
+        }
+    },
+    // History Control Point CCC
+    [HIST_CTRL_CCC_IDX] = {
+        {ESP_GATT_AUTO_RSP},
+        {
+            ESP_UUID_LEN_16,
+            (uint8_t *)&characteristic_client_config_uuid,
+            ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+            sizeof(uint16_t),
+            sizeof(history_ctrl_ccc),
+            (uint8_t *)&history_ctrl_ccc
+        }
+    },
+    // Boot Report Characteristic Declaration
+    [BOOT_IDX] = {
+        {ESP_GATT_AUTO_RSP},
+        {
+            ESP_UUID_LEN_16,
+            (uint8_t *)&characteristic_declaration_uuid,
+            ESP_GATT_PERM_READ,
+            sizeof(uint8_t),
+            sizeof(uint8_t),
+            (uint8_t *)&char_prop_read
+        }
+    },
+    // Boot Report Characteristic Value, answered on read so it is always current
+    [BOOT_VAL_IDX] = {
+        {ESP_GATT_RSP_BY_APP},
+        {
+            ESP_UUID_LEN_16,
+            (uint8_t *)&gatts_boot_uuid,
+            ESP_GATT_PERM_READ,
+            sizeof(boot_value),
+            sizeof(boot_value),
+            (uint8_t *)&boot_value
+        }
+    },
 };
 
+static uint32_t read_le32(const uint8_t *buf) {
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void write_le32(uint8_t *buf, uint32_t value) {
+    buf[0] = value;
+    buf[1] = value >> 8;
+    buf[2] = value >> 16;
+    buf[3] = value >> 24;
+}
+
+static void pack_sensor_data(uint8_t *buf, struct sensor_data sd) {
+    buf[0] = (uint16_t)sd.temperature;
+    buf[1] = (uint16_t)sd.temperature >> 8;
+    buf[2] = sd.humidity;
+    buf[3] = sd.humidity >> 8;
+    write_le32(buf + 4, sd.pressure);
+}
+
+// the report is longer than the default MTU, so clients read it in pieces at increasing offsets
+static void boot_report_respond(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
+    static esp_gatt_rsp_t rsp;
+    uint16_t offset = param->read.is_long ? param->read.offset : 0;
+
+    memset(&rsp, 0, sizeof(rsp));
+    if (offset == 0) {
+        boot_profile_pack(boot_value);
+    }
+    rsp.attr_value.handle = param->read.handle;
+    rsp.attr_value.offset = offset;
+    if (offset < sizeof(boot_value)) {
+        rsp.attr_value.len = sizeof(boot_value) - offset;
+        if (rsp.attr_value.len > profile.mtu - 1) {
+            rsp.attr_value.len = profile.mtu - 1;
+        }
+        memcpy(rsp.attr_value.value, boot_value + offset, rsp.attr_value.len);
+    }
+    esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id, ESP_GATT_OK, &rsp);
+}
+
+static void history_respond(uint8_t status, uint32_t count) {
+    if (!profile.connected || history_ctrl_ccc[0] != 0x01) return;
+
+    uint8_t response[6] = {HISTORY_OP_RESPONSE, status};
+    write_le32(response + 2, count);
+    esp_ble_gatts_send_indicate(profile.gatts_if, profile.conn_id, handles[HIST_CTRL_VAL_IDX], sizeof(response), response, false);
+}
+
+// waits for the controller to have room rather than letting the notification queue overflow
+static bool history_send(uint8_t *packet, uint16_t len) {
+    while (esp_ble_get_cur_sendable_packets_num(profile.conn_id) == 0) {
+        if (!profile.connected || history_abort) return false;
+        xSemaphoreTake(history_uncongested, pdMS_TO_TICKS(100));
+    }
+    if (!profile.connected || history_abort) return false;
+    return esp_ble_gatts_send_indicate(profile.gatts_if, profile.conn_id, handles[HIST_VAL_IDX], len, packet, false) == ESP_OK;
+}
+
+static void history_transfer_task(void *parameter) {
+    struct history_request request;
+    struct history_cursor cursor;
+    struct history_record records[HISTORY_READ_BATCH];
+    static uint8_t packet[LOCAL_MTU - NOTIFY_HEADER_LEN];
+
+    while (1) {
+        xQueueReceive(history_requests, &request, portMAX_DELAY);
+
+        int64_t time_us_start = esp_timer_get_time();
+        uint16_t payload_len = (profile.mtu - NOTIFY_HEADER_LEN) / HISTORY_PACKED_RECORD_LEN * HISTORY_PACKED_RECORD_LEN;
+        uint16_t len = 0;
+        uint32_t sent = 0;
+        uint8_t status = HISTORY_STATUS_DONE;
+        uint8_t done = 0;
+        size_t count;
+
+        history_cursor_seek(&cursor, request.from);
+        while (!done && (count = history_read(&cursor, records, HISTORY_READ_BATCH)) > 0) {
+            for (size_t i = 0; i < count; i++) {
+                if (records[i].timestamp < request.from) continue;
+                if (records[i].timestamp > request.to) {
+                    done = 1;
+                    break;
+                }
+
+                uint8_t *p = packet + len;
+                write_le32(p, records[i].timestamp);
+                pack_sensor_data(p + 4, records[i].sd);
+                len += HISTORY_PACKED_RECORD_LEN;
+                sent++;
+
+                if (len == payload_len) {
+                    if (!history_send(packet, len)) {
+                        status = HISTORY_STATUS_ABORTED;
+                        done = 1;
+                        break;
+                    }
+                    len = 0;
+                }
+            }
+        }
+        if (status == HISTORY_STATUS_DONE && len > 0 && !history_send(packet, len)) {
+            status = HISTORY_STATUS_ABORTED;
+        }
+
+        history_respond(status, sent);
+        history_busy = 0;
+
+        int64_t time_us = esp_timer_get_time() - time_us_start;
+        ESP_LOGI(TAG, "History Transfer %s: %lu records in %lld ms (%lld records/s)",
+            status == HISTORY_STATUS_DONE ? "Complete" : "Aborted",
+            (unsigned long)sent,
+            time_us / 1000,
+            time_us > 0 ? (int64_t)sent * 1000000 / time_us : 0
+        );
+    }
+}
+
 static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
     switch(event) {
         case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
@@ -205,39 +479,90 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
             break;
         case ESP_GATTS_CREAT_ATTR_TAB_EVT:
             memcpy(handles, param->add_attr_tab.handles, sizeof(handles));
+            // start out with the reading restored from before a reset, if any
+            struct sensor_snapshot snapshot;
+            if (sensor_state_get(&snapshot)) {
+                uint8_t value[SD_PACKED_LEN];
+                pack_sensor_data(value, snapshot.sd);
+                esp_ble_gatts_set_attr_value(handles[SD_VAL_IDX], sizeof(value), value);
+            }
             esp_ble_gatts_start_service(handles[SERV_IDX]);
             ESP_LOGI(TAG, "GATT Server Attribute Table Created");
             break;
         case ESP_GATTS_READ_EVT:
+            if (param->read.handle == handles[BOOT_VAL_IDX]) {
+                boot_report_respond(gatts_if, param);
+            }
             ESP_LOGI(TAG, "Client Read Characteristic");
             break;
         case ESP_GATTS_WRITE_EVT:
             if (param->write.handle == handles[SD_CCC_IDX]) {
-                    esp_ble_gatts_set_attr_value(handles[SD_CCC_IDX], 2, param->write.value);
-                    memcpy(sd_ccc, param->write.value, 2);
-                    ESP_LOGI(TAG, "Client Wrote to Configuration");
+                if (param->write.len != CCC_LEN) break;
+                esp_ble_gatts_set_attr_value(handles[SD_CCC_IDX], CCC_LEN, param->write.value);
+                memcpy(sd_ccc, param->write.value, CCC_LEN);
+                ESP_LOGI(TAG, "Client Wrote to Configuration");
             } else if (param->write.handle == handles[SSID_VAL_IDX]) {
+                if (param->write.len > SSID_MAX_LEN) break;
                 memset(ssid_value, 0, SSID_MAX_LEN);
                 memcpy(ssid_value, param->write.value, param->write.len);
                 ESP_LOGI(TAG, "Client Set SSID: %s", ssid_value);
                 ssid_set = 1;
             } else if (param->write.handle == handles[PASS_VAL_IDX]) {
+                if (param->write.len > PASSWORD_MAX_LEN) break;
                 memset(password_value, 0, PASSWORD_MAX_LEN);
                 memcpy(password_value, param->write.value, param->write.len);
-                ESP_LOGI(TAG, "Client Set Password: %s", password_value);
+                ESP_LOGI(TAG, "Client Set Password");
                 if (ssid_set) {
                     callback(BLE_GATT_SERVER_SSID_PASSWORD_SET_EVENT);
                 }
+            } else if (param->write.handle == handles[HIST_CCC_IDX]) {
+                if (param->write.len != CCC_LEN) break;
+                memcpy(history_ccc, param->write.value, CCC_LEN);
+            } else if (param->write.handle == handles[HIST_CTRL_CCC_IDX]) {
+                if (param->write.len != CCC_LEN) break;
+                memcpy(history_ctrl_ccc, param->write.value, CCC_LEN);
+            } else if (param->write.handle == handles[HIST_CTRL_VAL_IDX]) {
+                if (param->write.len < 1) break;
+                if (param->write.value[0] == HISTORY_OP_ABORT) {
+                    history_abort = 1;
+                } else if (param->write.value[0] == HISTORY_OP_START && param->write.len == HISTORY_CTRL_LEN) {
+                    if (history_busy) {
+                        history_respond(HISTORY_STATUS_BUSY, 0);
+                        break;
+                    }
+                    struct history_request request = {
+                        .from = read_le32(param->write.value + 1),
+                        .to = read_le32(param->write.value + 5)
+                    };
+                    history_busy = 1;
+                    // cleared here, not when the task takes the request, so an abort right after isn't lost
+                    history_abort = 0;
+                    xQueueSend(history_requests, &request, 0);
+                    ESP_LOGI(TAG, "Client Requested History %lu - %lu", (unsigned long)request.from, (unsigned long)request.to);
+                }
+            }
+            break;
+        case ESP_GATTS_MTU_EVT:
+            profile.mtu = param->mtu.mtu;
+            ESP_LOGI(TAG, "MTU Set to %d", profile.mtu);
+            break;
+        case ESP_GATTS_CONGEST_EVT:
+            if (!param->congest.congested) {
+                xSemaphoreGive(history_uncongested);
             }
             break;
         case ESP_GATTS_CONNECT_EVT:
             profile.conn_id = param->connect.conn_id;
             profile.connected = 1;
+            profile.mtu = DEFAULT_MTU;
             ESP_LOGI(TAG, "Client Connected");
             break;
         case ESP_GATTS_DISCONNECT_EVT:
             memset(sd_ccc, 0, 2);
+            memset(history_ccc, 0, 2);
+            memset(history_ctrl_ccc, 0, 2);
             profile.connected = 0;
+            history_abort = 1;
             esp_ble_gap_start_advertising(&adv_params);
             ESP_LOGI(TAG, "Client Disconnected");
             break;
@@ -247,6 +572,10 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
 }
 
 void ble_gatt_server_init() {
+    history_requests = xQueueCreate(1, sizeof(struct history_request));
+    history_uncongested = xSemaphoreCreateBinary();
+    xTaskCreate(history_transfer_task, "BLE History Transfer", HISTORY_TASK_STACK, NULL, 1, NULL);
+
     esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
     esp_bt_controller_init(&bt_cfg);
     esp_bt_controller_enable(ESP_BT_MODE_BLE);
@@ -260,26 +589,30 @@ void ble_gatt_server_init() {
 
     esp_ble_gatts_app_register(0);
 
-    esp_ble_gatt_set_local_mtu(500);
+    esp_ble_gatt_set_local_mtu(LOCAL_MTU);
 }
 
-void ble_gatt_server_set_sensor_data(struct sensor_data sd_value_input) {
-    sd_value = sd_value_input;
-    esp_ble_gatts_set_attr_value(handles[SD_VAL_IDX], sizeof(struct sensor_data), (uint8_t *)&sd_value);
-}
+void ble_gatt_server_notify(struct sensor_data sd) {
+    trace_begin(TRACE_PROBE_BLE_NOTIFY);
+    uint8_t value[SD_PACKED_LEN];
+    pack_sensor_data(value, sd);
+    esp_ble_gatts_set_attr_value(handles[SD_VAL_IDX], sizeof(value), value);
 
-void ble_gatt_server_notify() {
     if (profile.connected && sd_ccc[0] == 0x01) {
-        esp_ble_gatts_send_indicate(
+        esp_err_t err = esp_ble_gatts_send_indicate(
             profile.gatts_if,
             profile.conn_id,
             handles[SD_VAL_IDX],
-            sizeof(struct sensor_data),
-            (uint8_t *)&sd_value,
+            sizeof(value),
+            value,
             false
         );
+        if (err == ESP_OK) {
+            metrics_increment(METRICS_BLE_NOTIFICATIONS);
+        }
         ESP_LOGI(TAG, "Notifying Client of Update");
     }
+    trace_end(TRACE_PROBE_BLE_NOTIFY);
 }
 
 void ble_gatt_server_register_callback(ble_gatt_server_callback_t cb) {
@@ -12,6 +12,5 @@ typedef enum {
 typedef void (*ble_gatt_server_callback_t)(ble_gatt_server_event_t);
 
 void ble_gatt_server_init();
-void ble_gatt_server_set_sensor_data(struct sensor_data sd_value_input);
-void ble_gatt_server_notify();
+void ble_gatt_server_notify(struct sensor_data sd);
 void ble_gatt_server_register_callback(ble_gatt_server_callback_t callback);
@@ -0,0 +1,119 @@
+#include "driver/i2c_master.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#include "bme280.h"
+
+#define TAG "BME280"
+
+#define BME280_I2C_HZ 400000
+#define BME280_I2C_TIMEOUT_MS 10
+#define BME280_CHIP_ID 0x60
+// one conversion of each channel at x1 oversampling takes at most 9.3 ms
+#define BME280_CONVERSION_MS 10
+#define BME280_STATUS_RETRIES 3
+
+#define BME280_REG_CALIB 0x88
+#define BME280_REG_CHIP_ID 0xD0
+#define BME280_REG_CALIB_H 0xE1
+#define BME280_REG_CTRL_HUM 0xF2
+#define BME280_REG_STATUS 0xF3
+#define BME280_REG_CTRL_MEAS 0xF4
+#define BME280_REG_DATA 0xF7
+
+#define BME280_OSRS_X1 0x01
+#define BME280_MODE_FORCED 0x01
+#define BME280_STATUS_MEASURING 0x08
+
+static i2c_master_bus_handle_t bus = NULL;
+static i2c_master_dev_handle_t dev = NULL;
+static struct bme280_calib calib;
+
+static esp_err_t read_registers(uint8_t reg, uint8_t *data, size_t len) {
+    return i2c_master_transmit_receive(dev, &reg, 1, data, len, BME280_I2C_TIMEOUT_MS);
+}
+
+static esp_err_t write_register(uint8_t reg, uint8_t value) {
+    uint8_t data[2] = {reg, value};
+    return i2c_master_transmit(dev, data, sizeof(data), BME280_I2C_TIMEOUT_MS);
+}
+
+esp_err_t bme280_init(int sda_pin, int scl_pin, uint8_t address) {
+    i2c_master_bus_config_t bus_config = {
+        .i2c_port = I2C_NUM_0,
+        .sda_io_num = sda_pin,
+        .scl_io_num = scl_pin,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t err = i2c_new_master_bus(&bus_config, &bus);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    i2c_device_config_t dev_config = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = address,
+        .scl_speed_hz = BME280_I2C_HZ,
+    };
+    err = i2c_master_bus_add_device(bus, &dev_config, &dev);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    uint8_t chip_id = 0;
+    err = read_registers(BME280_REG_CHIP_ID, &chip_id, 1);
+    if (err != ESP_OK || chip_id != BME280_CHIP_ID) {
+        ESP_LOGE(TAG, "No BME280 at 0x%02x (chip id 0x%02x)", address, chip_id);
+        return err != ESP_OK ? err : ESP_ERR_NOT_FOUND;
+    }
+
+    uint8_t calib_data[BME280_CALIB_LEN];
+    uint8_t calib_h_data[BME280_CALIB_H_LEN];
+    err = read_registers(BME280_REG_CALIB, calib_data, sizeof(calib_data));
+    if (err == ESP_OK) {
+        err = read_registers(BME280_REG_CALIB_H, calib_h_data, sizeof(calib_h_data));
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    bme280_parse_calib(calib_data, calib_h_data, &calib);
+
+    // humidity oversampling only takes effect after the next write to ctrl_meas
+    err = write_register(BME280_REG_CTRL_HUM, BME280_OSRS_X1);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    ESP_LOGI(TAG, "BME280 Initialized at 0x%02x", address);
+    return ESP_OK;
+}
+
+// triggers a single conversion, the sensor returns to sleep afterwards
+esp_err_t bme280_start() {
+    return write_register(BME280_REG_CTRL_MEAS, (BME280_OSRS_X1 << 5) | (BME280_OSRS_X1 << 2) | BME280_MODE_FORCED);
+}
+
+esp_err_t bme280_read(struct sensor_data *sd) {
+    uint8_t status = BME280_STATUS_MEASURING;
+    for (int i = 0; i <= BME280_STATUS_RETRIES; i++) {
+        esp_err_t err = read_registers(BME280_REG_STATUS, &status, 1);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if ((status & BME280_STATUS_MEASURING) == 0) break;
+        vTaskDelay(pdMS_TO_TICKS(BME280_CONVERSION_MS) + 1);
+    }
+    if (status & BME280_STATUS_MEASURING) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint8_t data[BME280_DATA_LEN];
+    esp_err_t err = read_registers(BME280_REG_DATA, data, sizeof(data));
+    if (err != ESP_OK) {
+        return err;
+    }
+    bme280_compensate(&calib, data, sd);
+    return ESP_OK;
+}
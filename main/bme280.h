@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "sensor_data.h"
+
+// Bosch BME280 on I2C, run in forced mode so it only draws current while a
+// conversion is in progress. A reading is split in two so the conversion
+// can run while other sensors in the same cycle are being read.
+
+#define BME280_CALIB_LEN 26
+#define BME280_CALIB_H_LEN 7
+#define BME280_DATA_LEN 8
+
+struct bme280_calib {
+    uint16_t t1;
+    int16_t t2;
+    int16_t t3;
+    uint16_t p1;
+    int16_t p2;
+    int16_t p3;
+    int16_t p4;
+    int16_t p5;
+    int16_t p6;
+    int16_t p7;
+    int16_t p8;
+    int16_t p9;
+    uint8_t h1;
+    int16_t h2;
+    uint8_t h3;
+    int16_t h4;
+    int16_t h5;
+    int8_t h6;
+};
+
+esp_err_t bme280_init(int sda_pin, int scl_pin, uint8_t address);
+esp_err_t bme280_start();
+esp_err_t bme280_read(struct sensor_data *sd);
+
+// pure datasheet integer compensation, kept free of driver state so it can run on the host
+void bme280_parse_calib(const uint8_t calib[BME280_CALIB_LEN], const uint8_t calib_h[BME280_CALIB_H_LEN], struct bme280_calib *c);
+void bme280_compensate(const struct bme280_calib *c, const uint8_t data[BME280_DATA_LEN], struct sensor_data *sd);
@@ -0,0 +1,79 @@
+#include "bme280.h"
+
+static uint16_t u16_le(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+// 0x88-0xA1 and 0xE1-0xE7, H4 and H5 share a nibble of 0xE5
+void bme280_parse_calib(const uint8_t calib[BME280_CALIB_LEN], const uint8_t calib_h[BME280_CALIB_H_LEN], struct bme280_calib *c) {
+    c->t1 = u16_le(calib + 0);
+    c->t2 = (int16_t)u16_le(calib + 2);
+    c->t3 = (int16_t)u16_le(calib + 4);
+    c->p1 = u16_le(calib + 6);
+    c->p2 = (int16_t)u16_le(calib + 8);
+    c->p3 = (int16_t)u16_le(calib + 10);
+    c->p4 = (int16_t)u16_le(calib + 12);
+    c->p5 = (int16_t)u16_le(calib + 14);
+    c->p6 = (int16_t)u16_le(calib + 16);
+    c->p7 = (int16_t)u16_le(calib + 18);
+    c->p8 = (int16_t)u16_le(calib + 20);
+    c->p9 = (int16_t)u16_le(calib + 22);
+    c->h1 = calib[25];
+    c->h2 = (int16_t)u16_le(calib_h + 0);
+    c->h3 = calib_h[2];
+    c->h4 = (int16_t)(((int8_t)calib_h[3] * 16) | (calib_h[4] & 0x0F));
+    c->h5 = (int16_t)(((int8_t)calib_h[5] * 16) | (calib_h[4] >> 4));
+    c->h6 = (int8_t)calib_h[6];
+}
+
+// returns hundredths of a degree, t_fine feeds the other two channels
+static int16_t compensate_temperature(const struct bme280_calib *c, int32_t adc_t, int32_t *t_fine) {
+    int32_t var1 = ((((adc_t >> 3) - ((int32_t)c->t1 << 1))) * ((int32_t)c->t2)) >> 11;
+    int32_t var2 = (((((adc_t >> 4) - ((int32_t)c->t1)) * ((adc_t >> 4) - ((int32_t)c->t1))) >> 12) * ((int32_t)c->t3)) >> 14;
+    *t_fine = var1 + var2;
+    return (*t_fine * 5 + 128) >> 8;
+}
+
+// returns pascals in Q24.8. The datasheet shifts signed values left, which is
+// undefined for negative ones in C, the same products are written as multiplies.
+static uint32_t compensate_pressure(const struct bme280_calib *c, int32_t adc_p, int32_t t_fine) {
+    int64_t var1 = ((int64_t)t_fine) - 128000;
+    int64_t var2 = var1 * var1 * (int64_t)c->p6;
+    var2 = var2 + var1 * (int64_t)c->p5 * 131072;
+    var2 = var2 + (int64_t)c->p4 * 34359738368;
+    var1 = ((var1 * var1 * (int64_t)c->p3) >> 8) + var1 * (int64_t)c->p2 * 4096;
+    var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)c->p1) >> 33;
+    if (var1 == 0) {
+        return 0;
+    }
+    int64_t p = 1048576 - adc_p;
+    p = (((p << 31) - var2) * 3125) / var1;
+    var1 = (((int64_t)c->p9) * (p >> 13) * (p >> 13)) >> 25;
+    var2 = (((int64_t)c->p8) * p) >> 19;
+    return ((p + var1 + var2) >> 8) + (int64_t)c->p7 * 16;
+}
+
+// returns percent relative humidity in Q22.10
+static uint32_t compensate_humidity(const struct bme280_calib *c, int32_t adc_h, int32_t t_fine) {
+    int32_t v = t_fine - ((int32_t)76800);
+    v = (((((adc_h << 14) - ((int32_t)c->h4 * 1048576) - (((int32_t)c->h5) * v)) + ((int32_t)16384)) >> 15)
+        * (((((((v * ((int32_t)c->h6)) >> 10) * (((v * ((int32_t)c->h3)) >> 11) + ((int32_t)32768))) >> 10)
+        + ((int32_t)2097152)) * ((int32_t)c->h2) + 8192) >> 14));
+    v = v - (((((v >> 15) * (v >> 15)) >> 7) * ((int32_t)c->h1)) >> 4);
+    v = v < 0 ? 0 : v;
+    v = v > 419430400 ? 419430400 : v;
+    return (uint32_t)(v >> 12);
+}
+
+// data is the 0xF7-0xFE burst: pressure and temperature are 20 bit, humidity 16 bit
+void bme280_compensate(const struct bme280_calib *c, const uint8_t data[BME280_DATA_LEN], struct sensor_data *sd) {
+    int32_t adc_p = ((int32_t)data[0] << 12) | ((int32_t)data[1] << 4) | (data[2] >> 4);
+    int32_t adc_t = ((int32_t)data[3] << 12) | ((int32_t)data[4] << 4) | (data[5] >> 4);
+    int32_t adc_h = ((int32_t)data[6] << 8) | data[7];
+    int32_t t_fine;
+
+    sd->temperature = compensate_temperature(c, adc_t, &t_fine);
+    sd->pressure = (compensate_pressure(c, adc_p, t_fine) + 128) >> 8;
+    sd->humidity = (compensate_humidity(c, adc_h, t_fine) * 100 + 512) >> 10;
+    sd->channels |= SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY | SENSOR_CHANNEL_PRESSURE;
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "boot_profile.h"
+
+#define TAG "BOOT_PROFILE"
+
+struct phase_time {
+    uint32_t start_us;
+    uint32_t end_us;
+};
+
+static const char *const phase_names[NUM_BOOT_PHASES] = {
+    [BOOT_PHASE_NVS] = "nvs",
+    [BOOT_PHASE_RESTORE] = "restore",
+    [BOOT_PHASE_SENSOR] = "sensor",
+    [BOOT_PHASE_LCD] = "lcd",
+    [BOOT_PHASE_BLE] = "ble",
+    [BOOT_PHASE_WIFI] = "wifi",
+    [BOOT_PHASE_STORAGE] = "storage",
+    [BOOT_PHASE_FILESYSTEM] = "filesystem",
+    [BOOT_PHASE_HTTP] = "http",
+    [BOOT_PHASE_FIRST_READING] = "first_reading",
+    [BOOT_PHASE_FIRST_IP] = "first_ip",
+    [BOOT_PHASE_FIRST_RESPONSE] = "first_response"
+};
+
+// each entry has a single writer and readers only format it, so aligned word stores are enough
+static volatile struct phase_time phases[NUM_BOOT_PHASES] = {0};
+
+static uint32_t now_us() {
+    // never zero, zero means not reached
+    uint32_t time_us = esp_timer_get_time();
+    return time_us > 0 ? time_us : 1;
+}
+
+void boot_profile_begin(enum boot_phase phase) {
+    if (phases[phase].start_us == 0) {
+        phases[phase].start_us = now_us();
+    }
+}
+
+void boot_profile_end(enum boot_phase phase) {
+    if (phases[phase].start_us == 0 || phases[phase].end_us != 0) return;
+
+    phases[phase].end_us = now_us();
+    ESP_LOGI(TAG, "%s took %lu us, done %lu ms after boot",
+        phase_names[phase],
+        (unsigned long)(phases[phase].end_us - phases[phase].start_us),
+        (unsigned long)(phases[phase].end_us / 1000)
+    );
+}
+
+void boot_profile_mark(enum boot_phase phase) {
+    boot_profile_begin(phase);
+    boot_profile_end(phase);
+}
+
+void boot_profile_pack(uint8_t *buf) {
+    for (int i = 0; i < NUM_BOOT_PHASES; i++) {
+        uint32_t times[2] = {phases[i].start_us, phases[i].end_us};
+        for (int j = 0; j < 2; j++) {
+            *buf++ = times[j];
+            *buf++ = times[j] >> 8;
+            *buf++ = times[j] >> 16;
+            *buf++ = times[j] >> 24;
+        }
+    }
+}
+
+int boot_profile_format_json(char *buf, size_t len) {
+    int n = snprintf(buf, len, "{");
+    for (int i = 0; i < NUM_BOOT_PHASES && n < (int)len; i++) {
+        uint32_t start_us = phases[i].start_us;
+        uint32_t end_us = phases[i].end_us;
+        if (end_us == 0) continue;
+        n += snprintf(buf + n, len - n, "%s\"%s\":{\"start_us\":%lu,\"end_us\":%lu}",
+            n > 1 ? "," : "",
+            phase_names[i],
+            (unsigned long)start_us,
+            (unsigned long)end_us
+        );
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, "}");
+    }
+    return n;
+}
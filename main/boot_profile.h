@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Timestamps of each startup phase and of the first reading, IP address and
+// HTTP response, in microseconds since boot. Every phase is recorded once
+// by whichever task runs it, so the report shows which ones overlapped.
+
+enum boot_phase {
+    BOOT_PHASE_NVS,
+    BOOT_PHASE_RESTORE,
+    BOOT_PHASE_SENSOR,
+    BOOT_PHASE_LCD,
+    BOOT_PHASE_BLE,
+    BOOT_PHASE_WIFI,
+    BOOT_PHASE_STORAGE,
+    BOOT_PHASE_FILESYSTEM,
+    BOOT_PHASE_HTTP,
+    BOOT_PHASE_FIRST_READING,
+    BOOT_PHASE_FIRST_IP,
+    BOOT_PHASE_FIRST_RESPONSE,
+    NUM_BOOT_PHASES
+};
+
+// little endian start and end of every phase, zero while it hasn't happened
+#define BOOT_PROFILE_PACKED_LEN (NUM_BOOT_PHASES * 8)
+#define BOOT_PROFILE_JSON_LEN 768
+
+void boot_profile_begin(enum boot_phase phase);
+void boot_profile_end(enum boot_phase phase);
+// for events rather than phases, starts and ends at once
+void boot_profile_mark(enum boot_phase phase);
+void boot_profile_pack(uint8_t *buf);
+int boot_profile_format_json(char *buf, size_t len);
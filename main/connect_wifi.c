@@ -1,40 +1,225 @@
+#include "esp_event.h"
 #include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
-#include "nvs_flash.h"
+#include "nvs.h"
 
 #include <string.h>
 
 #include "connect_wifi.h"
 
-#define MAX_ATTEMPTS 3
+#define NVS_NAMESPACE "wifi"
+#define RECONNECT_MIN_MS 1000
+#define RECONNECT_MAX_MS 60000
+#define POST_TIMEOUT_MS 100
 
 static const char *TAG = "CONNECT_WIFI";
 
-static int wifi_connection_attempts = 0;
-static int wifi_connected = 0;
-static SemaphoreHandle_t wifi_connect_done;
+// work handed to the default event loop, which owns all of the state below
+ESP_EVENT_DEFINE_BASE(CONNECT_WIFI_EVENT);
 
-static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
-    if (wifi_connection_attempts < MAX_ATTEMPTS) {
-        ESP_LOGI(TAG, "Reattempting to Connect to WIFI");
-        esp_wifi_connect();
-        wifi_connection_attempts++;
+enum {
+    CONNECT_WIFI_CREDENTIALS_EVENT,
+    CONNECT_WIFI_RECONNECT_EVENT
+};
+
+struct credentials {
+    uint8_t ssid[32];
+    uint8_t password[64];
+};
+
+// access point of the last connection, lets the driver skip the scan
+struct cached_ap {
+    uint8_t bssid[6];
+    uint8_t channel;
+};
+
+static wifi_config_t wifi_config = {};
+static uint8_t have_credentials = 0;
+static struct cached_ap cached_ap;
+static uint8_t have_cached_ap = 0;
+
+static uint8_t started = 0;
+static uint8_t sta_started = 0;
+static uint8_t associated = 0;
+static uint8_t attempt_cached = 0;
+static volatile uint8_t wifi_connected = 0;
+static uint32_t reconnect_delay_ms = RECONNECT_MIN_MS;
+static esp_timer_handle_t reconnect_timer;
+
+// start of the current outage, or of the first connection after boot
+static int64_t outage_start_us = 0;
+static uint8_t first_connection = 1;
+static volatile int32_t time_to_ip_ms = -1;
+
+static connect_wifi_callback_t callback = NULL;
+
+static void load_nvs() {
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) return;
+
+    struct credentials credentials;
+    size_t len = sizeof(credentials);
+    if (nvs_get_blob(nvs, "credentials", &credentials, &len) == ESP_OK && len == sizeof(credentials)) {
+        memcpy(wifi_config.sta.ssid, credentials.ssid, sizeof(wifi_config.sta.ssid));
+        memcpy(wifi_config.sta.password, credentials.password, sizeof(wifi_config.sta.password));
+        have_credentials = 1;
+    }
+    len = sizeof(cached_ap);
+    have_cached_ap = have_credentials && nvs_get_blob(nvs, "ap", &cached_ap, &len) == ESP_OK && len == sizeof(cached_ap);
+
+    nvs_close(nvs);
+}
+
+static void save_nvs(const char *key, const void *value, size_t len) {
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to Open NVS");
+        return;
+    }
+    if (value != NULL) {
+        nvs_set_blob(nvs, key, value, len);
+    } else {
+        nvs_erase_key(nvs, key);
+    }
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static void forget_cached_ap() {
+    if (!have_cached_ap) return;
+    have_cached_ap = 0;
+    save_nvs("ap", NULL, 0);
+}
+
+// an outage ended, keep the access point for the next boot if it changed
+static void remember_ap() {
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) return;
+    if (have_cached_ap && memcmp(cached_ap.bssid, ap_info.bssid, sizeof(cached_ap.bssid)) == 0
+        && cached_ap.channel == ap_info.primary) {
+        return;
+    }
+    memcpy(cached_ap.bssid, ap_info.bssid, sizeof(cached_ap.bssid));
+    cached_ap.channel = ap_info.primary;
+    have_cached_ap = 1;
+    save_nvs("ap", &cached_ap, sizeof(cached_ap));
+}
+
+static void start_attempt() {
+    attempt_cached = have_cached_ap;
+    wifi_config.sta.bssid_set = attempt_cached;
+    if (attempt_cached) {
+        memcpy(wifi_config.sta.bssid, cached_ap.bssid, sizeof(cached_ap.bssid));
+        wifi_config.sta.channel = cached_ap.channel;
     } else {
-        xSemaphoreGive(wifi_connect_done);
+        memset(wifi_config.sta.bssid, 0, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = 0;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    esp_wifi_connect();
+}
+
+static void reconnect_timer_callback(void *arg) {
+    esp_event_post(CONNECT_WIFI_EVENT, CONNECT_WIFI_RECONNECT_EVENT, NULL, 0, pdMS_TO_TICKS(POST_TIMEOUT_MS));
+}
+
+static void apply_credentials(const struct credentials *credentials) {
+    ESP_LOGI(TAG, "SSID Set: %.*s", (int)sizeof(credentials->ssid), credentials->ssid);
+    save_nvs("credentials", credentials, sizeof(*credentials));
+
+    memcpy(wifi_config.sta.ssid, credentials->ssid, sizeof(wifi_config.sta.ssid));
+    memcpy(wifi_config.sta.password, credentials->password, sizeof(wifi_config.sta.password));
+    have_credentials = 1;
+    forget_cached_ap();
+
+    if (!sta_started) return;
+    esp_timer_stop(reconnect_timer);
+    reconnect_delay_ms = RECONNECT_MIN_MS;
+    associated = 0;
+    outage_start_us = esp_timer_get_time();
+    esp_wifi_disconnect();
+    start_attempt();
+}
+
+static void connect_wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
+    switch (event_id) {
+        case CONNECT_WIFI_CREDENTIALS_EVENT:
+            apply_credentials(event_data);
+        break;
+        case CONNECT_WIFI_RECONNECT_EVENT:
+            ESP_LOGI(TAG, "Reattempting to Connect to WIFI");
+            start_attempt();
+        break;
+    }
+}
+
+static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
+    switch (event_id) {
+        case WIFI_EVENT_STA_START:
+            sta_started = 1;
+            if (have_credentials) {
+                ESP_LOGI(TAG, "Attempting to Connect to WIFI%s", have_cached_ap ? " (cached access point)" : "");
+                start_attempt();
+            } else {
+                ESP_LOGI(TAG, "No WIFI Credentials, Waiting for BLE");
+            }
+        break;
+        case WIFI_EVENT_STA_CONNECTED:
+            associated = 1;
+        break;
+        case WIFI_EVENT_STA_DISCONNECTED: {
+            wifi_event_sta_disconnected_t *event = event_data;
+            // our own disconnect after new credentials, the next attempt is already running
+            if (event->reason == WIFI_REASON_ASSOC_LEAVE) break;
+
+            if (outage_start_us == 0) {
+                outage_start_us = esp_timer_get_time();
+            }
+            // the access point moved or changed channel, scan straight away
+            if (attempt_cached && !associated) {
+                ESP_LOGI(TAG, "Cached Access Point Unreachable, Scanning");
+                forget_cached_ap();
+                start_attempt();
+                break;
+            }
+            associated = 0;
+
+            ESP_LOGI(TAG, "Disconnected from WIFI (reason %d), Retrying in %lu ms", event->reason, (unsigned long)reconnect_delay_ms);
+            esp_timer_start_once(reconnect_timer, (uint64_t)reconnect_delay_ms * 1000);
+            reconnect_delay_ms = reconnect_delay_ms * 2 < RECONNECT_MAX_MS ? reconnect_delay_ms * 2 : RECONNECT_MAX_MS;
+        }
+        break;
     }
 }
 
 static void ip_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
-    ESP_LOGI(TAG, "Connected to WIFI");
-    wifi_connection_attempts = 0;
-    wifi_connected = 1;
-    xSemaphoreGive(wifi_connect_done);
+    if (event_id == IP_EVENT_STA_GOT_IP) {
+        int64_t now_us = esp_timer_get_time();
+        time_to_ip_ms = (now_us - outage_start_us) / 1000;
+        ESP_LOGI(TAG, "Connected to WIFI in %ld ms, %lld ms after boot (%s, %s)",
+            (long)time_to_ip_ms,
+            now_us / 1000,
+            !first_connection ? "reconnect" : esp_reset_reason() == ESP_RST_POWERON ? "cold boot" : "warm boot",
+            attempt_cached ? "cached access point" : "scanned"
+        );
+        outage_start_us = 0;
+        first_connection = 0;
+        reconnect_delay_ms = RECONNECT_MIN_MS;
+        wifi_connected = 1;
+        remember_ap();
+        if (callback != NULL) callback(CONNECT_WIFI_GOT_IP_EVENT);
+    } else if (event_id == IP_EVENT_STA_LOST_IP) {
+        ESP_LOGW(TAG, "Lost IP Address");
+        wifi_connected = 0;
+        if (callback != NULL) callback(CONNECT_WIFI_LOST_IP_EVENT);
+    }
 }
 
 void connect_wifi_init() {
-    wifi_connect_done = xSemaphoreCreateBinary();
-
     // create default event loop
     esp_event_loop_create_default();
 
@@ -46,65 +231,54 @@ void connect_wifi_init() {
     // initialize wifi stack and start wifi task
     wifi_init_config_t init_config = WIFI_INIT_CONFIG_DEFAULT();
     esp_wifi_init(&init_config);
+    // credentials live in our own NVS namespace, the driver copy would only duplicate the writes
+    esp_wifi_set_storage(WIFI_STORAGE_RAM);
 
     // set the wifi controller to be a station
     esp_wifi_set_mode(WIFI_MODE_STA);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = reconnect_timer_callback,
+        .name = "wifi_reconnect"
+    };
+    esp_timer_create(&timer_args, &reconnect_timer);
+
+    esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL);
+    esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &ip_event_handler, NULL, NULL);
+    esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_LOST_IP, &ip_event_handler, NULL, NULL);
+    esp_event_handler_instance_register(CONNECT_WIFI_EVENT, ESP_EVENT_ANY_ID, &connect_wifi_event_handler, NULL, NULL);
+
+    load_nvs();
 }
 
+// called from the BLE stack's task, the event loop copies the credentials and applies them
 void connect_wifi_config(uint8_t *ssid, uint8_t *password) {
-    wifi_config_t wifi_config = {};
-    strcpy((char *)wifi_config.sta.ssid, (char *)ssid);
-    strcpy((char *)wifi_config.sta.password, (char *)password);
-    ESP_LOGI(TAG, "SSID Set: %s, Password Set: %s", wifi_config.sta.ssid, wifi_config.sta.password);
-    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    struct credentials credentials = {0};
+    // not terminated when full, a 32 character SSID and a 64 digit PSK are valid
+    memcpy(credentials.ssid, ssid, sizeof(credentials.ssid));
+    memcpy(credentials.password, password, sizeof(credentials.password));
+    if (esp_event_post(CONNECT_WIFI_EVENT, CONNECT_WIFI_CREDENTIALS_EVENT, &credentials, sizeof(credentials),
+            pdMS_TO_TICKS(POST_TIMEOUT_MS)) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to Pass On WIFI Credentials");
+    }
 }
 
+// returns at once, the connection is made and kept up by the event handlers
 void connect_wifi() {
-    if (wifi_connected) return;
-
-    esp_event_handler_instance_t wifi_event_handler_instance;
-    esp_event_handler_instance_register(
-        WIFI_EVENT,
-        WIFI_EVENT_STA_DISCONNECTED,
-        &wifi_event_handler,
-        NULL,
-        &wifi_event_handler_instance
-    );
-    esp_event_handler_instance_t ip_event_handler_instance;
-    esp_event_handler_instance_register(
-        IP_EVENT,
-        IP_EVENT_STA_GOT_IP,
-        &ip_event_handler,
-        NULL,
-        &ip_event_handler_instance
-    );
-
+    if (started) return;
+    started = 1;
+    outage_start_us = esp_timer_get_time();
     esp_wifi_start();
-
-    ESP_LOGI(TAG, "Attempting to Connect to WIFI");
-    esp_wifi_connect();
-
-    xSemaphoreTake(wifi_connect_done, 10000 / portTICK_PERIOD_MS);
-
-    if (!wifi_connected) {
-        ESP_LOGW(TAG, "Failed to Connect to WIFI");
-        esp_wifi_stop();
-    }
-
-    wifi_connection_attempts = 0;
-
-    esp_event_handler_instance_unregister(
-        WIFI_EVENT,
-        WIFI_EVENT_STA_DISCONNECTED,
-        wifi_event_handler_instance
-    );
-    esp_event_handler_instance_unregister(
-        IP_EVENT,
-        IP_EVENT_STA_GOT_IP,
-        ip_event_handler_instance
-    );
 }
 
 uint8_t connect_wifi_connected() {
     return wifi_connected;
 }
+
+void connect_wifi_register_callback(connect_wifi_callback_t cb) {
+    callback = cb;
+}
+
+int32_t connect_wifi_time_to_ip_ms() {
+    return time_to_ip_ms;
+}
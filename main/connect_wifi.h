@@ -1,6 +1,26 @@
 #pragma once
 
+#include <stdint.h>
+
+// Background Wi-Fi station. Credentials are kept in NVS and the last access
+// point's BSSID and channel are cached next to them, so a reboot rejoins
+// without a full scan. Lost connections are retried with exponential
+// backoff for as long as the device runs, and nothing here blocks the
+// caller.
+
+typedef enum {
+    CONNECT_WIFI_GOT_IP_EVENT,
+    CONNECT_WIFI_LOST_IP_EVENT
+} connect_wifi_event_t;
+
+typedef void (*connect_wifi_callback_t)(connect_wifi_event_t);
+
 void connect_wifi_init();
 void connect_wifi();
 uint8_t connect_wifi_connected();
+// callable from any task, the new credentials are saved and used on the default event loop,
+// ssid holds 32 bytes and password 64, zero padded and only terminated when shorter
 void connect_wifi_config(uint8_t *ssid, uint8_t *password);
+void connect_wifi_register_callback(connect_wifi_callback_t callback);
+// time from starting, or from losing the connection, to the last IP address, -1 until there is one
+int32_t connect_wifi_time_to_ip_ms();
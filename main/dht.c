@@ -0,0 +1,111 @@
+#include "driver/gpio.h"
+#include "driver/rmt_rx.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "sdkconfig.h"
+
+#include "dht.h"
+
+#define TAG "DHT"
+
+#if CONFIG_WEATHER_STATION_SENSOR_DHT22
+// the AM2302 wants 1-10 ms, too short to sleep for with a 10 ms tick
+#define DHT_NAME "DHT22"
+#define DHT_START_US 1100
+#define dht_convert dht22_convert
+#else
+// the DHT11 wants at least 18 ms, rounded up to whole ticks
+#define DHT_NAME "DHT11"
+#define DHT_START_MS 20
+#define dht_convert dht11_convert
+#endif
+
+#define DHT_FRAME_TIMEOUT_MS 20
+#define DHT_RESOLUTION_HZ 1000000
+#define DHT_MEM_BLOCK_SYMBOLS 64
+
+static int dht_pin;
+static rmt_channel_handle_t rx_channel = NULL;
+static QueueHandle_t rx_done;
+static rmt_symbol_word_t symbols[DHT_MEM_BLOCK_SYMBOLS];
+static struct dht_pulse pulses[DHT_MEM_BLOCK_SYMBOLS * 2];
+
+static const rmt_receive_config_t receive_config = {
+    // ignore glitches shorter than 1 us, end the frame once the bus idles high for 200 us
+    .signal_range_min_ns = 1000,
+    .signal_range_max_ns = 200000,
+};
+
+static bool rx_done_callback(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *edata, void *user_data) {
+    BaseType_t task_woken = pdFALSE;
+    xQueueSendFromISR(rx_done, edata, &task_woken);
+    return task_woken == pdTRUE;
+}
+
+void dht_init(int pin) {
+    dht_pin = pin;
+    rx_done = xQueueCreate(1, sizeof(rmt_rx_done_event_data_t));
+
+    rmt_rx_channel_config_t channel_config = {
+        .gpio_num = pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = DHT_RESOLUTION_HZ,
+        .mem_block_symbols = DHT_MEM_BLOCK_SYMBOLS,
+    };
+    rmt_new_rx_channel(&channel_config, &rx_channel);
+
+    rmt_rx_event_callbacks_t callbacks = {
+        .on_recv_done = rx_done_callback,
+    };
+    rmt_rx_register_event_callbacks(rx_channel, &callbacks, NULL);
+    rmt_enable(rx_channel);
+
+    // open drain keeps the RMT input attached while we drive the start pulse
+    gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_level(pin, 1);
+
+    ESP_LOGI(TAG, DHT_NAME " Initialized on GPIO %d", pin);
+}
+
+esp_err_t dht_read(struct sensor_data *sd) {
+    rmt_rx_done_event_data_t edata;
+    uint8_t frame[DHT_FRAME_LEN];
+
+    gpio_set_level(dht_pin, 0);
+#ifdef DHT_START_US
+    esp_rom_delay_us(DHT_START_US);
+#else
+    vTaskDelay(pdMS_TO_TICKS(DHT_START_MS) + 1);
+#endif
+
+    xQueueReset(rx_done);
+    rmt_receive(rx_channel, symbols, sizeof(symbols), &receive_config);
+    gpio_set_level(dht_pin, 1);
+
+    if (xQueueReceive(rx_done, &edata, pdMS_TO_TICKS(DHT_FRAME_TIMEOUT_MS) + 1) == pdFALSE) {
+        // no edges arrived, restart the channel to abort the pending receive
+        rmt_disable(rx_channel);
+        rmt_enable(rx_channel);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    size_t num_pulses = 0;
+    for (size_t i = 0; i < edata.num_symbols; i++) {
+        rmt_symbol_word_t symbol = edata.received_symbols[i];
+        if (symbol.duration0) {
+            pulses[num_pulses++] = (struct dht_pulse){symbol.level0, symbol.duration0};
+        }
+        if (symbol.duration1) {
+            pulses[num_pulses++] = (struct dht_pulse){symbol.level1, symbol.duration1};
+        }
+    }
+
+    esp_err_t err = dht_decode(pulses, num_pulses, frame);
+    if (err != ESP_OK) {
+        return err;
+    }
+    dht_convert(frame, sd);
+    return ESP_OK;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "sensor_data.h"
+
+// DHT11 and DHT22 (AM2302) share the single wire protocol and the 40 bit
+// frame and only differ in start pulse length and in how the frame is
+// scaled. The model is chosen in Kconfig.
+
+#define DHT_FRAME_LEN 5
+
+struct dht_pulse {
+    uint8_t level;
+    uint16_t duration_us;
+};
+
+void dht_init(int pin);
+esp_err_t dht_read(struct sensor_data *sd);
+
+// pure decoders for a captured pulse train, kept free of driver state so they can run on the host
+esp_err_t dht_decode(const struct dht_pulse *pulses, size_t num_pulses, uint8_t frame[DHT_FRAME_LEN]);
+void dht11_convert(const uint8_t frame[DHT_FRAME_LEN], struct sensor_data *sd);
+void dht22_convert(const uint8_t frame[DHT_FRAME_LEN], struct sensor_data *sd);
@@ -0,0 +1,65 @@
+#include "dht.h"
+
+#define DHT_RESPONSE_MIN_US 50
+#define DHT_RESPONSE_MAX_US 120
+#define DHT_BIT_THRESHOLD_US 50
+#define DHT_BIT_MAX_US 100
+#define DHT_NUM_BITS 40
+
+esp_err_t dht_decode(const struct dht_pulse *pulses, size_t num_pulses, uint8_t frame[DHT_FRAME_LEN]) {
+    // find the 80 us low / 80 us high response that precedes the data bits
+    size_t i = 0;
+    for (; i + 1 < num_pulses; i++) {
+        if (pulses[i].level == 0
+            && pulses[i].duration_us >= DHT_RESPONSE_MIN_US
+            && pulses[i].duration_us <= DHT_RESPONSE_MAX_US
+            && pulses[i+1].level == 1
+            && pulses[i+1].duration_us >= DHT_RESPONSE_MIN_US
+            && pulses[i+1].duration_us <= DHT_RESPONSE_MAX_US) {
+            break;
+        }
+    }
+    i += 2;
+
+    // each bit is a 50 us low followed by a 26-28 us (0) or 70 us (1) high
+    uint64_t data = 0;
+    for (int bit = 0; bit < DHT_NUM_BITS; bit++, i += 2) {
+        if (i + 1 >= num_pulses || pulses[i].level != 0 || pulses[i+1].level != 1) {
+            return ESP_ERR_TIMEOUT;
+        }
+        if (pulses[i+1].duration_us > DHT_BIT_MAX_US) {
+            return ESP_ERR_TIMEOUT;
+        }
+        data = (data << 1) | (pulses[i+1].duration_us > DHT_BIT_THRESHOLD_US);
+    }
+
+    uint16_t checksum =
+          ((data & 0xFF00000000) >> 32)
+        + ((data & 0x00FF000000) >> 24)
+        + ((data & 0x0000FF0000) >> 16)
+        + ((data & 0x000000FF00) >> 8);
+    if ((checksum & 0xFF) != (data & 0xFF)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    for (int byte = 0; byte < DHT_FRAME_LEN; byte++) {
+        frame[byte] = data >> (8 * (DHT_FRAME_LEN - 1 - byte));
+    }
+    return ESP_OK;
+}
+
+// integral and tenths bytes, newer parts flag negative temperatures in bit 7 of the tenths
+void dht11_convert(const uint8_t frame[DHT_FRAME_LEN], struct sensor_data *sd) {
+    int16_t temperature = frame[2] * 100 + (frame[3] & 0x7F) * 10;
+    sd->temperature = (frame[3] & 0x80) ? -temperature : temperature;
+    sd->humidity = frame[0] * 100 + frame[1] * 10;
+    sd->channels |= SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY;
+}
+
+// big endian tenths, temperature is sign and magnitude
+void dht22_convert(const uint8_t frame[DHT_FRAME_LEN], struct sensor_data *sd) {
+    int16_t temperature = (((frame[2] & 0x7F) << 8) | frame[3]) * 10;
+    sd->temperature = (frame[2] & 0x80) ? -temperature : temperature;
+    sd->humidity = ((frame[0] << 8) | frame[1]) * 10;
+    sd->channels |= SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY;
+}
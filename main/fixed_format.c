@@ -0,0 +1,114 @@
+#include <stdio.h>
+
+#include "fixed_format.h"
+
+#define MAX_DECIMALS 4
+
+static const uint32_t powers_of_ten[MAX_DECIMALS + 1] = {1, 10, 100, 1000, 10000};
+
+// Sign of fl(n / d) - n / d when the quotient is rounded to nearest even
+// with the given number of mantissa bits. Only needed on decimal ties, so a
+// bit at a time long division is cheap enough.
+static int rounding_direction(uint64_t n, uint64_t d, int bits) {
+    uint64_t r = n % d;
+    uint64_t q = n / d;
+    int significant = 0;
+    while (significant < 64 && (q >> significant) != 0) {
+        significant++;
+    }
+    int last = q & 1;
+
+    // leading zero fraction bits don't count towards the mantissa
+    while (significant < bits) {
+        if (r == 0) return 0;
+        r <<= 1;
+        last = r >= d;
+        if (last) r -= d;
+        if (significant > 0 || last) significant++;
+    }
+
+    r <<= 1;
+    int round = r >= d;
+    if (round) r -= d;
+    if (!round) return r != 0 ? -1 : 0;
+    if (r != 0) return 1;
+    return last ? 1 : -1;
+}
+
+// an empty string and a negative length, like snprintf on an encoding error
+static int reject(char *buf, size_t len) {
+    if (len > 0) {
+        buf[0] = '\0';
+    }
+    return -1;
+}
+
+int fixed_format(char *buf, size_t len, int64_t num, uint32_t den, int width, int decimals, int bits) {
+    if (decimals < 0 || decimals > MAX_DECIMALS) {
+        return reject(buf, len);
+    }
+
+    uint64_t magnitude = num < 0 ? -(uint64_t)num : (uint64_t)num;
+    uint64_t scaled = magnitude * powers_of_ten[decimals];
+    uint64_t digits = scaled / den;
+    uint64_t twice_rest = scaled % den * 2;
+    if (twice_rest > den) {
+        digits++;
+    } else if (twice_rest == den) {
+        int direction = rounding_direction(magnitude, den, bits);
+        if (direction > 0 || (direction == 0 && (digits & 1))) digits++;
+    }
+
+    // filled backwards from the end, 20 digits, point, sign and zero padding
+    char text[32];
+    char *p = text + sizeof(text) - 1;
+    *p = '\0';
+    for (int i = 0; i < decimals; i++) {
+        *--p = '0' + digits % 10;
+        digits /= 10;
+    }
+    if (decimals > 0) {
+        *--p = '.';
+    }
+    do {
+        *--p = '0' + digits % 10;
+        digits /= 10;
+    } while (digits != 0);
+
+    // printf prints the sign of negative values that round to zero too
+    int sign = num < 0;
+    while (text + sizeof(text) - 1 - p + sign < width && p > text + 1) {
+        *--p = '0';
+    }
+    if (sign) {
+        *--p = '-';
+    }
+    return snprintf(buf, len, "%s", p);
+}
+
+int fixed_format_celsius(char *buf, size_t len, struct sensor_data sd, int width, int decimals) {
+    return fixed_format(buf, len, sd.temperature, 100, width, decimals, FIXED_FORMAT_FLOAT);
+}
+
+// F = (9 C + 16000) / 500 with C in hundredths. Up to 3 decimals the only
+// ties are half degrees, which the float path computed exactly. At 4 the
+// float path rounded through a product with 1.8 that is not reproduced
+// here, so that is refused.
+int fixed_format_fahrenheit(char *buf, size_t len, struct sensor_data sd, int width, int decimals) {
+    if (decimals > 3) {
+        return reject(buf, len);
+    }
+    return fixed_format(buf, len, 9 * (int32_t)sd.temperature + 16000, 500, width, decimals, FIXED_FORMAT_FLOAT);
+}
+
+int fixed_format_humidity(char *buf, size_t len, struct sensor_data sd, int width, int decimals) {
+    return fixed_format(buf, len, sd.humidity, 100, width, decimals, FIXED_FORMAT_FLOAT);
+}
+
+// a float holds hectopascals to about 1e-4, short of a fourth decimal
+int fixed_format_hectopascals(char *buf, size_t len, struct sensor_data sd, int width, int decimals) {
+    if (decimals > 3) {
+        return reject(buf, len);
+    }
+    return fixed_format(buf, len, sd.pressure, 100, width, decimals, FIXED_FORMAT_FLOAT);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sensor_data.h"
+
+// Decimal formatting of fixed point values with integer arithmetic only, so
+// sinks don't pull newlib's float printf onto their stacks. The text is
+// exactly what printf("%0*.*f") printed for the float expressions used
+// before, including decimal ties, which are broken the way the nearest
+// binary value would have been rounded.
+
+// longest formatted reading plus terminator, see fixed_format.c
+#define FIXED_FORMAT_LEN 12
+
+// mantissa bits of the binary value being reproduced
+#define FIXED_FORMAT_FLOAT 24
+#define FIXED_FORMAT_DOUBLE 53
+
+// formats num / den, returns the length like snprintf and never writes more than len bytes,
+// or writes an empty string and returns -1 for more than 4 decimals
+int fixed_format(char *buf, size_t len, int64_t num, uint32_t den, int width, int decimals, int bits);
+
+// fahrenheit and hectopascals support up to 3 decimals
+
+int fixed_format_celsius(char *buf, size_t len, struct sensor_data sd, int width, int decimals);
+int fixed_format_fahrenheit(char *buf, size_t len, struct sensor_data sd, int width, int decimals);
+int fixed_format_humidity(char *buf, size_t len, struct sensor_data sd, int width, int decimals);
+int fixed_format_hectopascals(char *buf, size_t len, struct sensor_data sd, int width, int decimals);
@@ -0,0 +1,226 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "flash_ring.h"
+
+#define TAG "FLASH_RING"
+
+#define FLASH_RING_MAGIC 0x57535452
+#define FLASH_RING_HEADER_SIZE 16
+#define FLASH_RING_MAX_RECORD_SIZE 64
+
+struct sector_header {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t record_size;
+    uint32_t format;
+};
+
+static uint32_t sector_offset(struct flash_ring *ring, uint32_t sector) {
+    return sector * ring->partition->erase_size;
+}
+
+static uint32_t slot_offset(struct flash_ring *ring, uint32_t sector, uint32_t slot) {
+    return sector_offset(ring, sector) + FLASH_RING_HEADER_SIZE + slot * ring->record_size;
+}
+
+static bool read_header(struct flash_ring *ring, uint32_t sector, uint32_t *seq) {
+    struct sector_header header;
+    if (esp_partition_read(ring->partition, sector_offset(ring, sector), &header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    // sectors written with another record layout are recycled as if erased
+    if (header.magic != FLASH_RING_MAGIC || header.record_size != ring->record_size || header.format != ring->format) {
+        return false;
+    }
+    *seq = header.seq;
+    return true;
+}
+
+static bool slot_empty(struct flash_ring *ring, uint32_t sector, uint32_t slot) {
+    uint8_t record[FLASH_RING_MAX_RECORD_SIZE];
+    esp_partition_read(ring->partition, slot_offset(ring, sector, slot), record, ring->record_size);
+    for (uint32_t i = 0; i < ring->record_size; i++) {
+        if (record[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static esp_err_t start_sector(struct flash_ring *ring, uint32_t sector, uint32_t seq) {
+    esp_err_t err = esp_partition_erase_range(ring->partition, sector_offset(ring, sector), ring->partition->erase_size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    struct sector_header header = {
+        .magic = FLASH_RING_MAGIC,
+        .seq = seq,
+        .record_size = ring->record_size,
+        .format = ring->format
+    };
+    return esp_partition_write(ring->partition, sector_offset(ring, sector), &header, sizeof(header));
+}
+
+esp_err_t flash_ring_init(struct flash_ring *ring, const char *partition_label, uint32_t record_size, uint32_t format) {
+    memset(ring, 0, sizeof(*ring));
+
+    ring->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label);
+    if (ring->partition == NULL) {
+        ESP_LOGE(TAG, "Partition (%s) not found.", partition_label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (record_size == 0 || record_size > FLASH_RING_MAX_RECORD_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    ring->lock = xSemaphoreCreateMutex();
+    ring->record_size = record_size;
+    ring->format = format;
+    ring->records_per_sector = (ring->partition->erase_size - FLASH_RING_HEADER_SIZE) / record_size;
+    ring->num_sectors = ring->partition->size / ring->partition->erase_size;
+
+    // the newest sector is appended to, the oldest is the next one to be recycled
+    bool found = false;
+    uint32_t tail_seq = 0;
+    for (uint32_t sector = 0; sector < ring->num_sectors; sector++) {
+        uint32_t seq;
+        if (!read_header(ring, sector, &seq)) {
+            continue;
+        }
+        if (!found || seq > ring->head_seq) {
+            ring->head_sector = sector;
+            ring->head_seq = seq;
+        }
+        if (!found || seq < tail_seq) {
+            ring->tail_sector = sector;
+            tail_seq = seq;
+        }
+        found = true;
+    }
+
+    if (!found) {
+        ring->head_seq = 1;
+        esp_err_t err = start_sector(ring, 0, ring->head_seq);
+        if (err != ESP_OK) {
+            return err;
+        }
+    } else {
+        // records are written in order, so the first empty slot can be binary searched
+        uint32_t lo = 0;
+        uint32_t hi = ring->records_per_sector;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (slot_empty(ring, ring->head_sector, mid)) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        ring->head_slot = lo;
+    }
+
+    ESP_LOGI(TAG, "Opened %s: %lu sectors of %lu records, head at %lu:%lu",
+        partition_label,
+        (unsigned long)ring->num_sectors,
+        (unsigned long)ring->records_per_sector,
+        (unsigned long)ring->head_sector,
+        (unsigned long)ring->head_slot
+    );
+    return ESP_OK;
+}
+
+esp_err_t flash_ring_append(struct flash_ring *ring, const void *record) {
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+
+    if (ring->head_slot == ring->records_per_sector) {
+        uint32_t next = (ring->head_sector + 1) % ring->num_sectors;
+        if (next == ring->tail_sector && ring->num_sectors > 1) {
+            ring->tail_sector = (ring->tail_sector + 1) % ring->num_sectors;
+        }
+        err = start_sector(ring, next, ring->head_seq + 1);
+        if (err != ESP_OK) {
+            xSemaphoreGive(ring->lock);
+            return err;
+        }
+        ring->head_sector = next;
+        ring->head_seq++;
+        ring->head_slot = 0;
+    }
+
+    // a failed write may leave the slot dirty, so it is never retried
+    err = esp_partition_write(ring->partition, slot_offset(ring, ring->head_sector, ring->head_slot), record, ring->record_size);
+    ring->head_slot++;
+
+    xSemaphoreGive(ring->lock);
+    return err;
+}
+
+void flash_ring_cursor_init(struct flash_ring *ring, struct flash_ring_cursor *cursor) {
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+    cursor->sector = ring->tail_sector;
+    cursor->slot = 0;
+    read_header(ring, cursor->sector, &cursor->seq);
+    xSemaphoreGive(ring->lock);
+}
+
+void flash_ring_cursor_seek(struct flash_ring *ring, struct flash_ring_cursor *cursor, flash_ring_compare_t compare, const void *key) {
+    uint8_t record[FLASH_RING_MAX_RECORD_SIZE];
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+
+    // binary search for the last sector whose first record is not past the key
+    uint32_t num_used = (ring->head_sector + ring->num_sectors - ring->tail_sector) % ring->num_sectors + 1;
+    uint32_t lo = 0;
+    uint32_t hi = num_used;
+    uint32_t found = 0;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        uint32_t sector = (ring->tail_sector + mid) % ring->num_sectors;
+        esp_partition_read(ring->partition, slot_offset(ring, sector, 0), record, ring->record_size);
+        if (compare(record, key) <= 0) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    cursor->sector = (ring->tail_sector + found) % ring->num_sectors;
+    cursor->slot = 0;
+    read_header(ring, cursor->sector, &cursor->seq);
+    xSemaphoreGive(ring->lock);
+}
+
+size_t flash_ring_read(struct flash_ring *ring, struct flash_ring_cursor *cursor, void *records, size_t max_records) {
+    xSemaphoreTake(ring->lock, portMAX_DELAY);
+
+    uint32_t seq;
+    if (!read_header(ring, cursor->sector, &seq) || seq != cursor->seq) {
+        ESP_LOGW(TAG, "Reader overtaken by writer, skipping to oldest record");
+        cursor->sector = ring->tail_sector;
+        cursor->slot = 0;
+        read_header(ring, cursor->sector, &cursor->seq);
+    }
+
+    if (cursor->slot == ring->records_per_sector && cursor->sector != ring->head_sector) {
+        cursor->sector = (cursor->sector + 1) % ring->num_sectors;
+        cursor->slot = 0;
+        read_header(ring, cursor->sector, &cursor->seq);
+    }
+
+    uint32_t end = (cursor->sector == ring->head_sector) ? ring->head_slot : ring->records_per_sector;
+    size_t count = end - cursor->slot;
+    if (count > max_records) {
+        count = max_records;
+    }
+    if (count > 0) {
+        esp_partition_read(ring->partition, slot_offset(ring, cursor->sector, cursor->slot), records, count * ring->record_size);
+        cursor->slot += count;
+    }
+
+    xSemaphoreGive(ring->lock);
+    return count;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Fixed-size records in a wrap-around ring of flash sectors. Each sector
+// starts with a header carrying a sequence number, so the newest and oldest
+// sectors can be found after a reset. Sectors are erased strictly in ring
+// order, which spreads wear evenly over the whole partition. The header also
+// records the record size and a caller-defined format version, and sectors
+// written in any other layout are recycled as if erased.
+
+struct flash_ring {
+    const esp_partition_t *partition;
+    SemaphoreHandle_t lock;
+    uint32_t record_size;
+    uint32_t format;
+    uint32_t records_per_sector;
+    uint32_t num_sectors;
+    uint32_t head_sector;
+    uint32_t head_slot;
+    uint32_t head_seq;
+    uint32_t tail_sector;
+};
+
+struct flash_ring_cursor {
+    uint32_t sector;
+    uint32_t seq;
+    uint32_t slot;
+};
+
+// orders a stored record against a search key, like memcmp
+typedef int (*flash_ring_compare_t)(const void *record, const void *key);
+
+esp_err_t flash_ring_init(struct flash_ring *ring, const char *partition_label, uint32_t record_size, uint32_t format);
+esp_err_t flash_ring_append(struct flash_ring *ring, const void *record);
+void flash_ring_cursor_init(struct flash_ring *ring, struct flash_ring_cursor *cursor);
+void flash_ring_cursor_seek(struct flash_ring *ring, struct flash_ring_cursor *cursor, flash_ring_compare_t compare, const void *key);
+size_t flash_ring_read(struct flash_ring *ring, struct flash_ring_cursor *cursor, void *records, size_t max_records);
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "fixed_format.h"
+#include "history.h"
+#include "retained.h"
+#include "sdkconfig.h"
+
+#define TAG "HISTORY"
+
+#define HISTORY_PARTITION "history"
+// bumped whenever the block layout changes
+#define HISTORY_FORMAT 2
+#define HISTORY_FLUSH_S CONFIG_WEATHER_STATION_HISTORY_FLUSH_S
+
+static struct flash_ring ring;
+static uint8_t ring_ready = 0;
+
+// samples are collected into a block in RTC memory and written out once it
+// is full or HISTORY_FLUSH_S old, so a reset does not lose the samples that
+// were not flushed yet and a power cut loses at most HISTORY_FLUSH_S of them
+static SemaphoreHandle_t pending_lock;
+RTC_NOINIT_ATTR static struct history_block pending;
+RTC_NOINIT_ATTR static struct retained_header pending_header;
+static struct history_block_state pending_state;
+
+static uint8_t block_crc(const struct history_block *block) {
+    return esp_rom_crc8_le(0, (const uint8_t *)block, sizeof(*block) - 1);
+}
+
+static int compare_timestamp(const void *block, const void *key) {
+    uint32_t timestamp = ((const struct history_block *)block)->timestamp;
+    uint32_t from = *(const uint32_t *)key;
+    return (timestamp > from) - (timestamp < from);
+}
+
+// the retained copy is cleared before the write, so a reset in the middle
+// loses the block rather than storing it a second time after the reboot
+static void flush_pending() {
+    struct history_block block = pending;
+    pending.count = 0;
+    retained_commit(&pending_header, &pending, sizeof(pending));
+
+    block.crc = block_crc(&block);
+    if (flash_ring_append(&ring, &block) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to Append Block");
+    }
+    ESP_LOGD(TAG, "Wrote block of %u samples", block.count);
+}
+
+// a block kept over a reset is written out at once rather than waiting to
+// fill, RTC memory would not keep it over a power cut that follows
+static void restore_pending() {
+    if (!retained_valid(&pending_header, &pending, sizeof(pending)) || pending.count == 0) {
+        pending.count = 0;
+        return;
+    }
+    ESP_LOGI(TAG, "Writing %u Samples Kept Over Reset", pending.count);
+    flush_pending();
+}
+
+void history_init() {
+    pending_lock = xSemaphoreCreateMutex();
+    ring_ready = flash_ring_init(&ring, HISTORY_PARTITION, sizeof(struct history_block), HISTORY_FORMAT) == ESP_OK;
+    if (ring_ready) {
+        restore_pending();
+    }
+}
+
+void history_append(time_t timestamp, struct sensor_data sd) {
+    if (!ring_ready || timestamp < HISTORY_MIN_VALID_TIME) return;
+
+    struct history_record record = {
+        .timestamp = timestamp,
+        .sd = sd
+    };
+
+    xSemaphoreTake(pending_lock, portMAX_DELAY);
+    if (pending.count > 0 && record.timestamp - pending.timestamp < HISTORY_FLUSH_S
+        && history_block_append(&pending, &pending_state, &record)) {
+        retained_commit(&pending_header, &pending, sizeof(pending));
+        xSemaphoreGive(pending_lock);
+        return;
+    }
+
+    if (pending.count > 0) {
+        flush_pending();
+    }
+    history_block_start(&pending, &pending_state, &record);
+    retained_commit(&pending_header, &pending, sizeof(pending));
+    xSemaphoreGive(pending_lock);
+}
+
+static void cursor_reset(struct history_cursor *cursor) {
+    cursor->block.count = 0;
+    cursor->open_timestamp = 0;
+    cursor->open_count = 0;
+    history_block_reader_init(&cursor->block, &cursor->state);
+}
+
+// decodes past the records of the open block the cursor has already returned
+static void cursor_skip_read(struct history_cursor *cursor) {
+    struct history_record record;
+    history_block_reader_init(&cursor->block, &cursor->state);
+    if (cursor->block.timestamp != cursor->open_timestamp) return;
+    for (uint8_t i = 0; i < cursor->open_count; i++) {
+        history_block_next(&cursor->block, &cursor->state, &record);
+    }
+}
+
+void history_cursor_init(struct history_cursor *cursor) {
+    if (!ring_ready) return;
+    flash_ring_cursor_init(&ring, &cursor->ring_cursor);
+    cursor_reset(cursor);
+}
+
+// lands at or shortly before the first record from `from` onwards
+void history_cursor_seek(struct history_cursor *cursor, uint32_t from) {
+    if (!ring_ready) return;
+    flash_ring_cursor_seek(&ring, &cursor->ring_cursor, compare_timestamp, &from);
+    cursor_reset(cursor);
+}
+
+// The open block is copied once the ring is read to its end. It may grow or
+// be flushed into the ring before the next call, so the copy is remembered
+// and the records already returned from it are skipped when it comes round
+// again.
+static bool cursor_next_block(struct history_cursor *cursor) {
+    bool found = false;
+
+    // the pending lock keeps a block from being flushed between reading the
+    // end of the ring and copying the pending block
+    xSemaphoreTake(pending_lock, portMAX_DELAY);
+    while (!found && flash_ring_read(&ring, &cursor->ring_cursor, &cursor->block, 1) == 1) {
+        // torn or failed writes are skipped rather than exported
+        found = cursor->block.crc == block_crc(&cursor->block)
+            && (cursor->block.timestamp != cursor->open_timestamp || cursor->block.count > cursor->open_count);
+    }
+    if (found) {
+        cursor_skip_read(cursor);
+        cursor->open_timestamp = 0;
+        cursor->open_count = 0;
+    } else if (pending.count > 0
+        && (pending.timestamp != cursor->open_timestamp || pending.count > cursor->open_count)) {
+        cursor->block = pending;
+        cursor_skip_read(cursor);
+        cursor->open_timestamp = pending.timestamp;
+        cursor->open_count = pending.count;
+        found = true;
+    }
+    xSemaphoreGive(pending_lock);
+    return found;
+}
+
+size_t history_read(struct history_cursor *cursor, struct history_record *records, size_t max_records) {
+    if (!ring_ready) return 0;
+
+    size_t count = 0;
+    while (count < max_records) {
+        if (history_block_next(&cursor->block, &cursor->state, &records[count])) {
+            count++;
+        } else if (!cursor_next_block(cursor)) {
+            break;
+        }
+    }
+    return count;
+}
+
+int history_format_csv(struct history_record record, char *buf, size_t len) {
+    char time_str[32];
+    time_t timestamp = record.timestamp;
+    struct tm time_info;
+    localtime_r(&timestamp, &time_info);
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &time_info);
+
+    char celsius[FIXED_FORMAT_LEN];
+    char humidity[FIXED_FORMAT_LEN];
+    fixed_format_celsius(celsius, sizeof(celsius), record.sd, 0, 1);
+    fixed_format_humidity(humidity, sizeof(humidity), record.sd, 0, 1);
+
+    if (sensor_data_has(record.sd, SENSOR_CHANNEL_PRESSURE)) {
+        char hectopascals[FIXED_FORMAT_LEN];
+        fixed_format_hectopascals(hectopascals, sizeof(hectopascals), record.sd, 0, 1);
+        return snprintf(buf, len, "%s,%s,%s,%s\n", time_str, celsius, humidity, hectopascals);
+    }
+    return snprintf(buf, len, "%s,%s,%s\n", time_str, celsius, humidity);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "flash_ring.h"
+#include "history_block.h"
+#include "sensor.h"
+#include "sensor_data.h"
+
+// samples taken before SNTP has set the clock are not worth keeping
+#define HISTORY_MIN_VALID_TIME 946684800
+#if SENSOR_CHANNELS & SENSOR_CHANNEL_PRESSURE
+#define HISTORY_CSV_HEADER "time,temperature,humidity,pressure\n"
+#else
+#define HISTORY_CSV_HEADER "time,temperature,humidity\n"
+#endif
+#define HISTORY_CSV_LINE_LEN 64
+
+struct history_cursor {
+    struct flash_ring_cursor ring_cursor;
+    struct history_block block;
+    struct history_block_state state;
+    // the open block last copied and how many of its records were read, so
+    // neither a later copy nor the block once flushed repeats them
+    uint32_t open_timestamp;
+    uint8_t open_count;
+};
+
+void history_init();
+void history_append(time_t timestamp, struct sensor_data sd);
+void history_cursor_init(struct history_cursor *cursor);
+void history_cursor_seek(struct history_cursor *cursor, uint32_t from);
+size_t history_read(struct history_cursor *cursor, struct history_record *records, size_t max_records);
+int history_format_csv(struct history_record record, char *buf, size_t len);
@@ -0,0 +1,151 @@
+#include <string.h>
+
+#include "history_block.h"
+
+#define HISTORY_BLOCK_STEP_CHANGED 0x01
+#define HISTORY_BLOCK_TEMPERATURE_CHANGED 0x02
+#define HISTORY_BLOCK_HUMIDITY_CHANGED 0x04
+#define HISTORY_BLOCK_PRESSURE_CHANGED 0x08
+
+// control byte plus the longest varints of a 32, 17, 16 and 32 bit value
+#define HISTORY_BLOCK_MAX_ENTRY_LEN (1 + 5 + 3 + 3 + 5)
+
+static uint32_t zigzag_encode(uint32_t value) {
+    return (value << 1) ^ (0 - (value >> 31));
+}
+
+static uint32_t zigzag_decode(uint32_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+static uint8_t varint_write(uint8_t *buf, uint32_t value) {
+    uint8_t len = 0;
+    while (value >= 0x80) {
+        buf[len++] = value | 0x80;
+        value >>= 7;
+    }
+    buf[len++] = value;
+    return len;
+}
+
+static bool varint_read(const struct history_block *block, struct history_block_state *state, uint32_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (state->pos >= HISTORY_BLOCK_DATA_LEN) {
+            return false;
+        }
+        uint8_t byte = block->data[state->pos++];
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void history_block_start(struct history_block *block, struct history_block_state *state, const struct history_record *record) {
+    memset(block, 0xFF, sizeof(*block));
+    block->timestamp = record->timestamp;
+    block->temperature = record->sd.temperature;
+    block->humidity = record->sd.humidity;
+    block->pressure = record->sd.pressure;
+    block->channels = record->sd.channels;
+    block->count = 1;
+
+    state->prev = *record;
+    state->prev_step = 0;
+    state->pos = 0;
+    state->index = 1;
+}
+
+// returns false without touching the block if the record does not fit
+bool history_block_append(struct history_block *block, struct history_block_state *state, const struct history_record *record) {
+    uint8_t entry[HISTORY_BLOCK_MAX_ENTRY_LEN];
+    uint8_t len = 1;
+
+    // unsigned arithmetic wraps, so clock steps backwards round trip as well
+    uint32_t step = record->timestamp - state->prev.timestamp;
+    uint32_t temperature_delta = (uint32_t)(record->sd.temperature - state->prev.sd.temperature);
+    uint16_t humidity_xor = record->sd.humidity ^ state->prev.sd.humidity;
+    uint32_t pressure_delta = record->sd.pressure - state->prev.sd.pressure;
+
+    if (record->sd.channels != block->channels) {
+        return false;
+    }
+
+    entry[0] = 0;
+    if (step != state->prev_step) {
+        entry[0] |= HISTORY_BLOCK_STEP_CHANGED;
+        len += varint_write(entry + len, zigzag_encode(step - state->prev_step));
+    }
+    if (temperature_delta != 0) {
+        entry[0] |= HISTORY_BLOCK_TEMPERATURE_CHANGED;
+        len += varint_write(entry + len, zigzag_encode(temperature_delta));
+    }
+    if (humidity_xor != 0) {
+        entry[0] |= HISTORY_BLOCK_HUMIDITY_CHANGED;
+        len += varint_write(entry + len, humidity_xor);
+    }
+    if (pressure_delta != 0) {
+        entry[0] |= HISTORY_BLOCK_PRESSURE_CHANGED;
+        len += varint_write(entry + len, zigzag_encode(pressure_delta));
+    }
+
+    if (state->pos + len > HISTORY_BLOCK_DATA_LEN || block->count == UINT8_MAX) {
+        return false;
+    }
+    memcpy(block->data + state->pos, entry, len);
+    state->pos += len;
+    block->count++;
+
+    state->prev = *record;
+    state->prev_step = step;
+    state->index = block->count;
+    return true;
+}
+
+void history_block_reader_init(const struct history_block *block, struct history_block_state *state) {
+    memset(state, 0, sizeof(*state));
+}
+
+// returns false once the block is exhausted or its data is malformed
+bool history_block_next(const struct history_block *block, struct history_block_state *state, struct history_record *record) {
+    if (state->index >= block->count) {
+        return false;
+    }
+
+    if (state->index == 0) {
+        state->prev.timestamp = block->timestamp;
+        state->prev.sd.temperature = block->temperature;
+        state->prev.sd.humidity = block->humidity;
+        state->prev.sd.pressure = block->pressure;
+        state->prev.sd.channels = block->channels;
+    } else {
+        if (state->pos >= HISTORY_BLOCK_DATA_LEN) {
+            return false;
+        }
+        uint8_t control = block->data[state->pos++];
+        uint32_t value;
+        if (control & HISTORY_BLOCK_STEP_CHANGED) {
+            if (!varint_read(block, state, &value)) return false;
+            state->prev_step += zigzag_decode(value);
+        }
+        state->prev.timestamp += state->prev_step;
+        if (control & HISTORY_BLOCK_TEMPERATURE_CHANGED) {
+            if (!varint_read(block, state, &value)) return false;
+            state->prev.sd.temperature += zigzag_decode(value);
+        }
+        if (control & HISTORY_BLOCK_HUMIDITY_CHANGED) {
+            if (!varint_read(block, state, &value)) return false;
+            state->prev.sd.humidity ^= value;
+        }
+        if (control & HISTORY_BLOCK_PRESSURE_CHANGED) {
+            if (!varint_read(block, state, &value)) return false;
+            state->prev.sd.pressure += zigzag_decode(value);
+        }
+    }
+
+    state->index++;
+    *record = state->prev;
+    return true;
+}
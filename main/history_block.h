@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sensor_data.h"
+
+// Compressed run of history records that can be decoded on its own. The
+// first record is stored verbatim in the header. Each following record is a
+// control byte flagging which fields changed, followed only by the changed
+// fields: the change in timestamp step, temperature and pressure as zigzag
+// varints, and the humidity XOR the previous humidity as a varint. A sample
+// taken on schedule with an unchanged reading costs a single byte. All
+// records in a block measure the same channels.
+
+#define HISTORY_BLOCK_SIZE 64
+#define HISTORY_BLOCK_HEADER_LEN 14
+#define HISTORY_BLOCK_DATA_LEN (HISTORY_BLOCK_SIZE - HISTORY_BLOCK_HEADER_LEN - 1)
+
+struct history_record {
+    uint32_t timestamp;
+    struct sensor_data sd;
+};
+
+// packed on-flash layout, never all 0xFF since the timestamp cannot be
+struct history_block {
+    uint32_t timestamp;
+    int16_t temperature;
+    uint16_t humidity;
+    uint32_t pressure;
+    uint8_t channels;
+    uint8_t count;
+    uint8_t data[HISTORY_BLOCK_DATA_LEN];
+    uint8_t crc;
+} __attribute__((packed));
+
+// shared by the encoder and the decoder, pos is the offset into data
+struct history_block_state {
+    struct history_record prev;
+    uint32_t prev_step;
+    uint8_t pos;
+    uint8_t index;
+};
+
+void history_block_start(struct history_block *block, struct history_block_state *state, const struct history_record *record);
+bool history_block_append(struct history_block *block, struct history_block_state *state, const struct history_record *record);
+void history_block_reader_init(const struct history_block *block, struct history_block_state *state);
+bool history_block_next(const struct history_block *block, struct history_block_state *state, struct history_record *record);
@@ -1,77 +1,467 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <time.h>
 #include <sys/time.h>
 #include <esp_sntp.h>
 
 #include "esp_http_server.h"
 #include "esp_log.h"
+#include "esp_random.h"
 #include "esp_spiffs.h"
+#include "esp_timer.h"
 
+#include "boot_profile.h"
+#include "fixed_format.h"
+#include "history.h"
 #include "http_server.h"
+#include "http_workers.h"
+#include "live_feed.h"
+#include "metrics.h"
+#include "page_template.h"
+#include "rollup.h"
+#include "sampler.h"
+#include "sensor_state.h"
+#include "static_assets.h"
+#include "trace.h"
 
 static const char *TAG = "HTTP_SERVER";
 
+#define CHUNK_LEN 1024
+#define DOWNLOAD_BATCH 16
+#define SUMMARY_BUCKET_JSON_LEN 256
+#define QUERY_LEN 96
+#define ETAG_LEN 24
+#define IF_NONE_MATCH_LEN 64
+#define ACCEPT_ENCODING_LEN 128
+// every URI below plus the trace dump
+#define MAX_URI_HANDLERS 9
+
+struct chunk_buffer {
+    httpd_req_t *req;
+    esp_err_t err;
+    size_t len;
+    size_t total;
+    char data[CHUNK_LEN];
+};
+
+// user_ctx of every timed URI, handlers served by the workers are timed there
+struct http_route {
+    enum metrics_route metric;
+    http_workers_handler_t handler;
+};
+
 static httpd_handle_t server = NULL;
-static struct sensor_data sd;
-static char message_buffer[4096] = {0};
-static char log_buffer[32768] = {0};
 
-static void implant_string(char *template, char *target, char *value) {
-    char *dest = strstr(template, target);
-    if (dest == NULL) {
-        ESP_LOGE(TAG, "Target string (%s) not found in template.", target);
-        return;
+enum {
+    INDEX_SLOT_FAHRENHEIT,
+    INDEX_SLOT_CELSIUS,
+    INDEX_SLOT_HUMIDITY,
+    NUM_INDEX_SLOTS
+};
+
+static const char *const index_slot_names[NUM_INDEX_SLOTS] = {
+    [INDEX_SLOT_FAHRENHEIT] = "fh",
+    [INDEX_SLOT_CELSIUS] = "cs",
+    [INDEX_SLOT_HUMIDITY] = "hm"
+};
+
+static struct page_template index_template;
+// sequence numbers restart at boot, so ETags also carry a per-boot id
+static uint32_t boot_id;
+
+static void chunk_flush(struct chunk_buffer *buf) {
+    if (buf->err == ESP_OK && buf->len > 0) {
+        buf->err = httpd_resp_send_chunk(buf->req, buf->data, buf->len);
+        buf->total += buf->len;
     }
-    strncpy(dest, value, strlen(target));
+    buf->len = 0;
+}
+
+// flushes early so the next write of up to len bytes fits
+static void chunk_reserve(struct chunk_buffer *buf, size_t len) {
+    if (sizeof(buf->data) - buf->len < len) {
+        chunk_flush(buf);
+    }
+}
+
+static esp_err_t chunk_end(struct chunk_buffer *buf) {
+    chunk_flush(buf);
+    if (buf->err != ESP_OK) {
+        return buf->err;
+    }
+    return httpd_resp_send_chunk(buf->req, NULL, 0);
+}
+
+// the ETag has to be set by the caller, httpd keeps a pointer to it until the response is sent
+static bool not_modified(httpd_req_t *req, const char *etag) {
+    char if_none_match[IF_NONE_MATCH_LEN];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) != ESP_OK
+        || strstr(if_none_match, etag) == NULL) {
+        return false;
+    }
+    httpd_resp_set_status(req, "304 Not Modified");
+    return true;
+}
+
+static void format_reading_etag(char *etag, size_t len, const struct sensor_snapshot *snapshot) {
+    snprintf(etag, len, "\"%08lx-%lu\"", (unsigned long)boot_id, (unsigned long)snapshot->seq);
+}
+
+static esp_err_t timed_handler(httpd_req_t *req) {
+    const struct http_route *route = req->user_ctx;
+    int64_t time_us_start = esp_timer_get_time();
+    esp_err_t err = route->handler(req);
+    metrics_observe_request(route->metric, esp_timer_get_time() - time_us_start);
+    return err;
 }
 
 static esp_err_t get_handler(httpd_req_t *req) {
-    float humidity = sensor_data_get_humidity(sd);
-    float celsius = sensor_data_get_celsius(sd);
-    float fahrenheit = sensor_data_get_fahrenheit(sd);
-
-    FILE *f = fopen("/filesystem/index.html", "r");
-    fread(message_buffer, 1, sizeof(message_buffer), f);
-    fclose(f);
-
-    char temp[6] = {0};
-    sprintf(temp, "%02.0f", humidity);
-    implant_string(message_buffer, "hm", temp);
-    sprintf(temp, "%02.0f", celsius);
-    implant_string(message_buffer, "cs", temp);
-    sprintf(temp, "%02.0f", fahrenheit);
-    implant_string(message_buffer, "fh", temp);
-
-    httpd_resp_send(req, message_buffer, HTTPD_RESP_USE_STRLEN);
-    ESP_LOGI(TAG, "Received GET Request");
+    int64_t time_us_start = esp_timer_get_time();
+
+    struct sensor_snapshot snapshot;
+    sensor_state_get(&snapshot);
+
+    // the page only changes with the reading, the assets it links are cached on their own
+    char etag[ETAG_LEN];
+    format_reading_etag(etag, sizeof(etag), &snapshot);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    if (not_modified(req, etag)) {
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    trace_begin(TRACE_PROBE_HTTP_INDEX);
+
+    char values[NUM_INDEX_SLOTS][PAGE_TEMPLATE_VALUE_LEN];
+    fixed_format_fahrenheit(values[INDEX_SLOT_FAHRENHEIT], PAGE_TEMPLATE_VALUE_LEN, snapshot.sd, 2, 0);
+    fixed_format_celsius(values[INDEX_SLOT_CELSIUS], PAGE_TEMPLATE_VALUE_LEN, snapshot.sd, 2, 0);
+    fixed_format_humidity(values[INDEX_SLOT_HUMIDITY], PAGE_TEMPLATE_VALUE_LEN, snapshot.sd, 2, 0);
+
+    page_template_render(&index_template, req, values);
+    trace_end(TRACE_PROBE_HTTP_INDEX);
+    boot_profile_mark(BOOT_PHASE_FIRST_RESPONSE);
+    ESP_LOGI(TAG, "Received GET Request, rendered in %lld us", esp_timer_get_time() - time_us_start);
     return ESP_OK;
 }
 
+static const struct http_route route_get = { METRICS_ROUTE_INDEX, get_handler };
+
 static httpd_uri_t uri_get = {
     .uri = "/",
     .method = HTTP_GET,
-    .handler = get_handler,
-    .user_ctx = NULL
+    .handler = timed_handler,
+    .user_ctx = (void *)&route_get
 };
 
 static esp_err_t download_handler(httpd_req_t *req) {
-    FILE *f = fopen("/filesystem/log.csv", "r");
-    fread(log_buffer, 1, sizeof(log_buffer), f);
-    fclose(f);
+    struct history_cursor cursor;
+    struct history_record records[DOWNLOAD_BATCH];
+    struct chunk_buffer buf = { .req = req };
+    size_t count;
+    int64_t time_us_start = esp_timer_get_time();
 
+    trace_begin(TRACE_PROBE_HTTP_DOWNLOAD);
+    history_cursor_init(&cursor);
     httpd_resp_set_type(req, "text/csv");
-    httpd_resp_send(req, log_buffer, HTTPD_RESP_USE_STRLEN);
-    ESP_LOGI(TAG, "Received Download Request");
+
+    buf.len = sprintf(buf.data, HISTORY_CSV_HEADER);
+    while ((count = history_read(&cursor, records, DOWNLOAD_BATCH)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            chunk_reserve(&buf, HISTORY_CSV_LINE_LEN);
+            buf.len += history_format_csv(records[i], buf.data + buf.len, sizeof(buf.data) - buf.len);
+        }
+        if (buf.err != ESP_OK) {
+            ESP_LOGW(TAG, "Download Aborted by Client");
+            trace_end(TRACE_PROBE_HTTP_DOWNLOAD);
+            return ESP_FAIL;
+        }
+    }
+    esp_err_t err = chunk_end(&buf);
+    trace_end(TRACE_PROBE_HTTP_DOWNLOAD);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Download Aborted by Client");
+        return ESP_FAIL;
+    }
+
+    int64_t time_us = esp_timer_get_time() - time_us_start;
+    ESP_LOGI(TAG, "Received Download Request, sent %zu bytes in %lld ms (%lld KB/s)",
+        buf.total,
+        time_us / 1000,
+        time_us > 0 ? (int64_t)buf.total * 1000000 / 1024 / time_us : 0
+    );
     return ESP_OK;
 }
 
+static const struct http_route route_download = { METRICS_ROUTE_DOWNLOAD, download_handler };
+
+// long running, served from the worker pool so the page stays responsive
 static httpd_uri_t uri_download = {
     .uri = "/log.csv",
     .method = HTTP_GET,
-    .handler = download_handler,
+    .handler = http_workers_dispatch,
+    .user_ctx = (void *)&route_download
+};
+
+static uint32_t query_uint(const char *query, const char *key, uint32_t default_value) {
+    char value[16];
+    if (httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK) {
+        return default_value;
+    }
+    return strtoul(value, NULL, 10);
+}
+
+// values are hundredths, printed in tenths the way %.1f printed the double quotients
+static int format_summary_channel(char *buf, size_t len, const char *name, int64_t min, int64_t max, int64_t sum, uint16_t count) {
+    char min_str[FIXED_FORMAT_LEN];
+    char max_str[FIXED_FORMAT_LEN];
+    char mean_str[FIXED_FORMAT_LEN];
+    fixed_format(min_str, sizeof(min_str), min, 100, 0, 1, FIXED_FORMAT_DOUBLE);
+    fixed_format(max_str, sizeof(max_str), max, 100, 0, 1, FIXED_FORMAT_DOUBLE);
+    fixed_format(mean_str, sizeof(mean_str), sum, (uint32_t)count * 100, 0, 1, FIXED_FORMAT_DOUBLE);
+    return snprintf(buf, len, ",\"%s\":{\"min\":%s,\"max\":%s,\"mean\":%s}", name, min_str, max_str, mean_str);
+}
+
+static esp_err_t summary_handler(httpd_req_t *req) {
+    char query[QUERY_LEN] = {0};
+    char resolution_str[8] = {0};
+    httpd_req_get_url_query_str(req, query, sizeof(query));
+    httpd_query_key_value(query, "resolution", resolution_str, sizeof(resolution_str));
+
+    enum rollup_resolution resolution = strcmp(resolution_str, "day") == 0 ? ROLLUP_DAILY : ROLLUP_HOURLY;
+    uint32_t from = query_uint(query, "from", 0);
+    uint32_t to = query_uint(query, "to", UINT32_MAX);
+
+    struct rollup_cursor cursor;
+    struct rollup_bucket bucket;
+    struct chunk_buffer buf = { .req = req };
+    rollup_cursor_init(&cursor, resolution, from, to);
+
+    httpd_resp_set_type(req, "application/json");
+    buf.len = snprintf(buf.data, sizeof(buf.data), "{\"resolution\":\"%s\",\"buckets\":[", resolution == ROLLUP_DAILY ? "day" : "hour");
+    for (int i = 0; rollup_next(&cursor, &bucket); i++) {
+        chunk_reserve(&buf, SUMMARY_BUCKET_JSON_LEN);
+        buf.len += snprintf(buf.data + buf.len, sizeof(buf.data) - buf.len,
+            "%s{\"start\":%lu,\"count\":%u",
+            i == 0 ? "" : ",",
+            (unsigned long)bucket.start,
+            bucket.count
+        );
+        buf.len += format_summary_channel(buf.data + buf.len, sizeof(buf.data) - buf.len, "temperature",
+            bucket.temperature_min, bucket.temperature_max, bucket.temperature_sum, bucket.count);
+        buf.len += format_summary_channel(buf.data + buf.len, sizeof(buf.data) - buf.len, "humidity",
+            bucket.humidity_min, bucket.humidity_max, bucket.humidity_sum, bucket.count);
+        if (bucket.channels & SENSOR_CHANNEL_PRESSURE) {
+            buf.len += format_summary_channel(buf.data + buf.len, sizeof(buf.data) - buf.len, "pressure",
+                bucket.pressure_min, bucket.pressure_max, bucket.pressure_sum, bucket.count);
+        }
+        buf.len += snprintf(buf.data + buf.len, sizeof(buf.data) - buf.len, "}");
+        if (buf.err != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    // no terminator, the buffer may have exactly two bytes left
+    chunk_reserve(&buf, 2);
+    memcpy(buf.data + buf.len, "]}", 2);
+    buf.len += 2;
+    if (chunk_end(&buf) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Received Summary Request");
+    return ESP_OK;
+}
+
+static const struct http_route route_summary = { METRICS_ROUTE_SUMMARY, summary_handler };
+
+static httpd_uri_t uri_summary = {
+    .uri = "/api/summary",
+    .method = HTTP_GET,
+    .handler = http_workers_dispatch,
+    .user_ctx = (void *)&route_summary
+};
+
+static esp_err_t current_handler(httpd_req_t *req) {
+    struct sensor_snapshot snapshot;
+    if (!sensor_state_get(&snapshot)) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "5");
+        return httpd_resp_sendstr(req, "No reading yet");
+    }
+
+    char etag[ETAG_LEN];
+    char cache_control[32];
+    format_reading_etag(etag, sizeof(etag), &snapshot);
+    snprintf(cache_control, sizeof(cache_control), "max-age=%lu", (unsigned long)sampler_seconds_until_next());
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", cache_control);
+    if (not_modified(req, etag)) {
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    char json[SENSOR_STATE_JSON_LEN];
+    int len = sensor_state_format_json(&snapshot, json, sizeof(json));
+    httpd_resp_set_type(req, "application/json");
+    boot_profile_mark(BOOT_PHASE_FIRST_RESPONSE);
+    return httpd_resp_send(req, json, len);
+}
+
+static const struct http_route route_current = { METRICS_ROUTE_CURRENT, current_handler };
+
+static httpd_uri_t uri_current = {
+    .uri = "/api/current",
+    .method = HTTP_GET,
+    .handler = timed_handler,
+    .user_ctx = (void *)&route_current
+};
+
+static esp_err_t boot_handler(httpd_req_t *req) {
+    char json[BOOT_PROFILE_JSON_LEN];
+    int len = boot_profile_format_json(json, sizeof(json));
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, json, len);
+}
+
+static const struct http_route route_boot = { METRICS_ROUTE_BOOT, boot_handler };
+
+static httpd_uri_t uri_boot = {
+    .uri = "/api/boot",
+    .method = HTTP_GET,
+    .handler = timed_handler,
+    .user_ctx = (void *)&route_boot
+};
+
+static const struct http_route route_metrics = { METRICS_ROUTE_METRICS, metrics_send };
+
+static httpd_uri_t uri_metrics = {
+    .uri = "/metrics",
+    .method = HTTP_GET,
+    .handler = timed_handler,
+    .user_ctx = (void *)&route_metrics
+};
+
+static const struct static_asset *find_asset(const char *uri) {
+    size_t len = strcspn(uri, "?");
+    for (size_t i = 0; i < num_static_assets; i++) {
+        if (strlen(static_assets[i].path) == len && strncmp(static_assets[i].path, uri, len) == 0) {
+            return &static_assets[i];
+        }
+    }
+    return NULL;
+}
+
+// whether an Accept-Encoding list takes a coding: 1 listed, 0 listed with
+// q=0, -1 not listed
+static int coding_accepted(const char *list, const char *coding) {
+    size_t coding_len = strlen(coding);
+    const char *item = list;
+    while (*(item += strspn(item, " \t,")) != '\0') {
+        size_t item_len = strcspn(item, ",");
+        const char *end = item + item_len;
+        if (strcspn(item, " \t;,") == coding_len && strncasecmp(item, coding, coding_len) == 0) {
+            const char *param = memchr(item, ';', item_len);
+            while (param != NULL) {
+                param += 1 + strspn(param + 1, " \t");
+                // q=0, q=0. and q=0.000 refuse the coding, any other weight takes it
+                if ((*param == 'q' || *param == 'Q') && param[1] == '=' && param[2] == '0') {
+                    const char *digit = param + 3;
+                    if (*digit == '.') {
+                        digit += 1 + strspn(digit + 1, "0");
+                    }
+                    if (digit == end || strchr(" \t;", *digit) != NULL) {
+                        return 0;
+                    }
+                }
+                param = memchr(param, ';', end - param);
+            }
+            return 1;
+        }
+        item = end;
+    }
+    return -1;
+}
+
+// without the header any coding will do, otherwise gzip or * must be listed without q=0
+static bool accepts_gzip(httpd_req_t *req) {
+    char accept_encoding[ACCEPT_ENCODING_LEN];
+    esp_err_t err = httpd_req_get_hdr_value_str(req, "Accept-Encoding", accept_encoding, sizeof(accept_encoding));
+    if (err == ESP_ERR_NOT_FOUND) {
+        return true;
+    }
+    if (err != ESP_OK && err != ESP_ERR_HTTPD_RESULT_TRUNC) {
+        return false;
+    }
+    int accepted = coding_accepted(accept_encoding, "gzip");
+    if (accepted < 0) {
+        accepted = coding_accepted(accept_encoding, "x-gzip");
+    }
+    if (accepted < 0) {
+        accepted = coding_accepted(accept_encoding, "*");
+    }
+    return accepted > 0;
+}
+
+// every browser accepts gzip, so only the compressed copy is kept and
+// clients that refuse it get a 406
+static esp_err_t assets_handler(httpd_req_t *req) {
+    const struct static_asset *asset = find_asset(req->uri);
+    if (asset == NULL) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+
+    // caches have to keep the request's encoding next to the response, the 406 included
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    if (!accepts_gzip(req)) {
+        httpd_resp_set_status(req, "406 Not Acceptable");
+        return httpd_resp_sendstr(req, "Only available gzip encoded");
+    }
+
+    // the path changes with the content, so a cached copy never goes stale
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=31536000, immutable");
+    if (not_modified(req, asset->etag)) {
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, asset->content_type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)asset->data, asset->len);
+}
+
+static const struct http_route route_assets = { METRICS_ROUTE_ASSETS, assets_handler };
+
+static httpd_uri_t uri_assets = {
+    .uri = STATIC_ASSETS_URI,
+    .method = HTTP_GET,
+    .handler = timed_handler,
+    .user_ctx = (void *)&route_assets
+};
+
+#if CONFIG_WEATHER_STATION_TRACE
+// not timed, the dump pauses recording for a tick
+static httpd_uri_t uri_trace = {
+    .uri = "/api/trace",
+    .method = HTTP_GET,
+    .handler = trace_send,
+    .user_ctx = NULL
+};
+#endif
+
+static esp_err_t live_handler(httpd_req_t *req) {
+    return live_feed_subscribe(req);
+}
+
+static httpd_uri_t uri_live = {
+    .uri = "/api/live",
+    .method = HTTP_GET,
+    .handler = live_handler,
     .user_ctx = NULL
 };
 
 void initialize_sntp() {
+    // the server restarts with every new IP address, SNTP keeps running across them
+    if (esp_sntp_enabled()) return;
     esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
     esp_sntp_setservername(0, "pool.ntp.org");
     esp_sntp_init();
@@ -85,6 +475,11 @@ void http_server_init() {
         .format_if_mount_failed = true
     };
     esp_vfs_spiffs_register(&config);
+
+    page_template_load(&index_template, "/filesystem/index.html", index_slot_names, NUM_INDEX_SLOTS);
+    live_feed_init();
+    http_workers_init(timed_handler);
+    boot_id = esp_random();
 }
 
 void http_server_start() {
@@ -93,36 +488,32 @@ void http_server_start() {
     initialize_sntp();
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_uri_handlers = MAX_URI_HANDLERS;
+    config.uri_match_fn = httpd_uri_match_wildcard;
     httpd_start(&server, &config);
     httpd_register_uri_handler(server, &uri_get);
     httpd_register_uri_handler(server, &uri_download);
+    httpd_register_uri_handler(server, &uri_summary);
+    httpd_register_uri_handler(server, &uri_current);
+    httpd_register_uri_handler(server, &uri_live);
+    httpd_register_uri_handler(server, &uri_boot);
+    httpd_register_uri_handler(server, &uri_metrics);
+    httpd_register_uri_handler(server, &uri_assets);
+#if CONFIG_WEATHER_STATION_TRACE
+    httpd_register_uri_handler(server, &uri_trace);
+#endif
+    http_workers_resume();
 
     ESP_LOGI(TAG, "Started HTTP Server");
 }
 
 void http_server_stop() {
+    if (server == NULL) return;
+
+    live_feed_close_all();
+    http_workers_drain();
     httpd_stop(server);
     server = NULL;
     ESP_LOGI(TAG, "Stopped HTTP Server");
 }
 
-void http_server_set_sensor_data(struct sensor_data sd_input) {
-    sd = sd_input;
-
-    uint8_t humidity = sensor_data_get_humidity(sd);
-    float celsius = sensor_data_get_celsius(sd);
-
-    char time_str[64];
-    time_t now;
-    struct tm time_info;
-    time(&now);
-    localtime_r(&now, &time_info);
-    strftime(time_str, 64, "%Y-%m-%d %H:%M:%S", &time_info);
-    if (time_str[0] == '1') return;
-
-    sprintf(message_buffer, "%s,%.1f,%d\n", time_str, celsius, humidity);
-
-    FILE *f = fopen("/filesystem/log.csv", "a");
-    fwrite(message_buffer, 1, strlen(message_buffer), f);
-    fclose(f);
-}
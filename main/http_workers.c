@@ -0,0 +1,160 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include "http_workers.h"
+
+#define TAG "HTTP_WORKERS"
+
+#define NUM_WORKERS CONFIG_WEATHER_STATION_HTTP_WORKERS
+#define QUEUE_LEN CONFIG_WEATHER_STATION_HTTP_WORKER_QUEUE_LEN
+#define WORKER_STACK_SIZE 4096
+
+static http_workers_handler_t run_handler;
+// async copies of the requests waiting for a worker
+static QueueHandle_t jobs;
+// one count per worker not running a job, drain takes them all to wait for the running ones
+static SemaphoreHandle_t idle_workers;
+// held from the accepting check to the send, so drain can't slip in between,
+// and around taking a job and recording it as running
+static SemaphoreHandle_t dispatch_lock;
+static bool accepting = false;
+// session of the job each worker is running, fd -1 when idle
+static struct {
+    httpd_handle_t handle;
+    int fd;
+} running[NUM_WORKERS];
+static uint32_t num_rejected = 0;
+
+static esp_err_t reject(httpd_req_t *req) {
+    char retry_after[8];
+    snprintf(retry_after, sizeof(retry_after), "%d", HTTP_WORKERS_RETRY_AFTER_S);
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", retry_after);
+    return httpd_resp_sendstr(req, "Server busy");
+}
+
+static void runJobs(void* parameter) {
+    int worker = (int)(intptr_t)parameter;
+    httpd_req_t *req;
+    httpd_handle_t handle = NULL;
+    int fd = -1;
+
+    while(1) {
+        // peek first so a drain can't miss a job that was taken off the queue but not started
+        xQueuePeek(jobs, &req, portMAX_DELAY);
+        xSemaphoreTake(idle_workers, portMAX_DELAY);
+        xSemaphoreTake(dispatch_lock, portMAX_DELAY);
+        bool received = xQueueReceive(jobs, &req, 0) == pdTRUE;
+        bool run = received && accepting;
+        if (run) {
+            handle = req->handle;
+            fd = httpd_req_to_sockfd(req);
+            running[worker].handle = handle;
+            running[worker].fd = fd;
+        }
+        xSemaphoreGive(dispatch_lock);
+
+        if (run) {
+            esp_err_t err = run_handler(req);
+            // cleared before the session can go away with the request
+            xSemaphoreTake(dispatch_lock, portMAX_DELAY);
+            running[worker].fd = -1;
+            xSemaphoreGive(dispatch_lock);
+            httpd_req_async_handler_complete(req);
+            // the server closes the connection when an inline handler fails, do the same here
+            if (err != ESP_OK) {
+                httpd_sess_trigger_close(handle, fd);
+            }
+        } else if (received) {
+            // taken after a drain began
+            reject(req);
+            httpd_req_async_handler_complete(req);
+        }
+        xSemaphoreGive(idle_workers);
+    }
+}
+
+void http_workers_init(http_workers_handler_t handler) {
+    run_handler = handler;
+    jobs = xQueueCreate(QUEUE_LEN, sizeof(httpd_req_t *));
+    idle_workers = xSemaphoreCreateCounting(NUM_WORKERS, NUM_WORKERS);
+    dispatch_lock = xSemaphoreCreateMutex();
+
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        running[i].fd = -1;
+        xTaskCreatePinnedToCore(
+            runJobs,
+            "HTTP Worker",
+            WORKER_STACK_SIZE,
+            (void *)(intptr_t)i,
+            1,
+            NULL,
+            tskNO_AFFINITY
+        );
+    }
+}
+
+// runs on the server task, the only producer, so a free slot can't be taken before the send
+esp_err_t http_workers_dispatch(httpd_req_t *req) {
+    xSemaphoreTake(dispatch_lock, portMAX_DELAY);
+    bool queued = false;
+    if (accepting && uxQueueSpacesAvailable(jobs) > 0) {
+        httpd_req_t *async_req;
+        if (httpd_req_async_handler_begin(req, &async_req) == ESP_OK) {
+            xQueueSend(jobs, &async_req, 0);
+            queued = true;
+        }
+    } else {
+        num_rejected++;
+        ESP_LOGW(TAG, "Rejected %s, all workers busy (%lu total)", req->uri, (unsigned long)num_rejected);
+    }
+    xSemaphoreGive(dispatch_lock);
+
+    return queued ? ESP_OK : reject(req);
+}
+
+static void reject_queued() {
+    httpd_req_t *req;
+    while (xQueueReceive(jobs, &req, 0) == pdTRUE) {
+        reject(req);
+        httpd_req_async_handler_complete(req);
+    }
+}
+
+// once the flag is down under the lock nothing more is queued or started, a
+// dispatch that got past the check has already sent its request. Running
+// jobs have their sockets closed, so they fail at their next send instead
+// of each waiting out the send timeout on a link that is gone while the
+// caller, the event loop, waits for them.
+void http_workers_drain() {
+    xSemaphoreTake(dispatch_lock, portMAX_DELAY);
+    accepting = false;
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        if (running[i].fd >= 0) {
+            httpd_sess_trigger_close(running[i].handle, running[i].fd);
+        }
+    }
+    xSemaphoreGive(dispatch_lock);
+
+    reject_queued();
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        xSemaphoreTake(idle_workers, portMAX_DELAY);
+    }
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        xSemaphoreGive(idle_workers);
+    }
+}
+
+void http_workers_resume() {
+    xSemaphoreTake(dispatch_lock, portMAX_DELAY);
+    accepting = true;
+    xSemaphoreGive(dispatch_lock);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Small pool of tasks for long running handlers such as the log download.
+// A URI registered with http_workers_dispatch as its handler is detached
+// from the server task as an async request and queued, so the page and the
+// API stay responsive while it runs. A worker then passes it to the handler
+// given to http_workers_init, which finds the real one through the user_ctx
+// of the URI. When every worker is busy and the queue is full the client
+// gets a 503 straight away.
+
+#define HTTP_WORKERS_RETRY_AFTER_S 5
+
+typedef esp_err_t (*http_workers_handler_t)(httpd_req_t *req);
+
+void http_workers_init(http_workers_handler_t handler);
+esp_err_t http_workers_dispatch(httpd_req_t *req);
+// answers queued requests with 503, closes the connections of running ones and
+// waits for them to return, call before httpd_stop
+void http_workers_drain();
+void http_workers_resume();
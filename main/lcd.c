@@ -0,0 +1,123 @@
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include <string.h>
+
+#include "lcd.h"
+#include "trace.h"
+
+#define TAG "LCD"
+
+#define RS 23
+#define RW 22
+#define E 21
+#define D7 27
+#define D6 13
+#define D5 15
+#define D4 4
+#define D3 16
+#define D2 17
+#define D1 18
+#define D0 19
+
+#define LCD_CMD_CLEAR 0x001
+#define LCD_CMD_ENTRY_MODE_INCREMENT 0x006
+#define LCD_CMD_DISPLAY_ON_NO_CURSOR 0x00C
+#define LCD_CMD_FUNCTION_SET_8BIT_TWO_LINE 0x038
+#define LCD_CMD_SET_DDRAM_ADDRESS 0x080
+#define LCD_WRITE_DATA 0x100
+
+// datasheet times are 37 us and 1.52 ms at 270 kHz, padded for a slow oscillator
+#define LCD_EXEC_US 50
+#define LCD_CLEAR_MS 3
+
+static const uint8_t row_address[LCD_ROWS] = {0x00, 0x40};
+
+// what the controller is showing versus what the next flush should show
+static char shown[LCD_ROWS][LCD_COLS];
+static char pending[LCD_ROWS][LCD_COLS];
+static int address = -1;
+
+static void send_command(int command) {
+    trace_begin(TRACE_PROBE_LCD_COMMAND);
+    gpio_set_level(RS, (command & 0x100) != 0);
+    gpio_set_level(D7, (command & 0x080) != 0);
+    gpio_set_level(D6, (command & 0x040) != 0);
+    gpio_set_level(D5, (command & 0x020) != 0);
+    gpio_set_level(D4, (command & 0x010) != 0);
+    gpio_set_level(D3, (command & 0x008) != 0);
+    gpio_set_level(D2, (command & 0x004) != 0);
+    gpio_set_level(D1, (command & 0x002) != 0);
+    gpio_set_level(D0, (command & 0x001) != 0);
+
+    gpio_set_level(E, 1);
+    esp_rom_delay_us(1);
+    gpio_set_level(E, 0);
+    esp_rom_delay_us(LCD_EXEC_US);
+    trace_end(TRACE_PROBE_LCD_COMMAND);
+}
+
+static void clear_display() {
+    send_command(LCD_CMD_CLEAR);
+    // vTaskDelay(n) may return after n - 1 ticks, so round up and add one
+    vTaskDelay((LCD_CLEAR_MS * configTICK_RATE_HZ + 999) / 1000 + 1);
+    memset(shown, ' ', sizeof(shown));
+    address = 0;
+}
+
+void lcd_init() {
+    gpio_num_t output_pins[11] = {RS, RW, E, D0, D1, D2, D3, D4, D5, D6, D7};
+    uint64_t output_pin_bit_mask = 0;
+    for (int i = 0; i < 11; i++) {
+        output_pin_bit_mask |= (1ULL << output_pins[i]);
+    }
+    gpio_config_t output_gpio_conf = {
+        .pin_bit_mask = output_pin_bit_mask,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE
+    };
+    gpio_config(&output_gpio_conf);
+
+    // the display runs from 5 V, so RW stays low and the busy flag is never read back
+    gpio_set_level(RW, 0);
+
+    send_command(LCD_CMD_FUNCTION_SET_8BIT_TWO_LINE);
+    send_command(LCD_CMD_DISPLAY_ON_NO_CURSOR);
+    send_command(LCD_CMD_ENTRY_MODE_INCREMENT);
+    clear_display();
+    memset(pending, ' ', sizeof(pending));
+}
+
+void lcd_set_line(int row, const char *text) {
+    size_t len = strnlen(text, LCD_COLS);
+    memcpy(pending[row], text, len);
+    memset(pending[row] + len, ' ', LCD_COLS - len);
+}
+
+void lcd_flush() {
+    int64_t time_us_start = esp_timer_get_time();
+    int cells = 0;
+
+    for (int row = 0; row < LCD_ROWS; row++) {
+        for (int col = 0; col < LCD_COLS; col++) {
+            if (pending[row][col] == shown[row][col]) continue;
+
+            // consecutive changed cells ride on the controller's auto-increment
+            int target = row_address[row] + col;
+            if (address != target) {
+                send_command(LCD_CMD_SET_DDRAM_ADDRESS | target);
+            }
+            send_command(LCD_WRITE_DATA | (uint8_t)pending[row][col]);
+            shown[row][col] = pending[row][col];
+            address = target + 1;
+            cells++;
+        }
+    }
+
+    ESP_LOGD(TAG, "Frame updated %d cells in %lld us", cells, esp_timer_get_time() - time_us_start);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#define LCD_ROWS 2
+#define LCD_COLS 16
+
+void lcd_init();
+void lcd_set_line(int row, const char *text);
+void lcd_flush();
@@ -0,0 +1,138 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+
+#include "live_feed.h"
+
+#define TAG "LIVE_FEED"
+
+#define LIVE_FEED_RETRY_MS 10000
+#define LIVE_FEED_EVENT_LEN (SENSOR_STATE_JSON_LEN + 32)
+// chunk size line and trailing CRLF around each event
+#define LIVE_FEED_FRAME_LEN (LIVE_FEED_EVENT_LEN + 16)
+
+static SemaphoreHandle_t clients_lock;
+static httpd_req_t *clients[LIVE_FEED_MAX_CLIENTS] = {0};
+static uint32_t num_dropped = 0;
+
+// slots of subscribers still being sent their first event, which happens
+// outside the lock, and of those close_all ended in the meantime
+static char reserved_marker, cancelled_marker;
+#define SLOT_RESERVED ((httpd_req_t *)&reserved_marker)
+#define SLOT_CANCELLED ((httpd_req_t *)&cancelled_marker)
+
+static bool is_client(httpd_req_t *req) {
+    return req != NULL && req != SLOT_RESERVED && req != SLOT_CANCELLED;
+}
+
+static int format_event(const struct sensor_snapshot *snapshot, char *buf, size_t len) {
+    char json[SENSOR_STATE_JSON_LEN];
+    sensor_state_format_json(snapshot, json, sizeof(json));
+    return snprintf(buf, len, "id: %lu\ndata: %s\n\n", (unsigned long)snapshot->seq, json);
+}
+
+// must be called with the clients lock held
+static void drop_client(int i) {
+    httpd_req_t *req = clients[i];
+    httpd_handle_t handle = req->handle;
+    int fd = httpd_req_to_sockfd(req);
+
+    clients[i] = NULL;
+    httpd_req_async_handler_complete(req);
+    httpd_sess_trigger_close(handle, fd);
+}
+
+void live_feed_init() {
+    clients_lock = xSemaphoreCreateMutex();
+}
+
+esp_err_t live_feed_subscribe(httpd_req_t *req) {
+    char event[LIVE_FEED_EVENT_LEN];
+    int len = snprintf(event, sizeof(event), "retry: %d\n\n", LIVE_FEED_RETRY_MS);
+
+    // start with the current reading so the page is up to date at once
+    struct sensor_snapshot snapshot;
+    if (sensor_state_get(&snapshot)) {
+        len += format_event(&snapshot, event + len, sizeof(event) - len);
+    }
+
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    int slot = -1;
+    for (int i = 0; i < LIVE_FEED_MAX_CLIENTS; i++) {
+        if (clients[i] == NULL) {
+            slot = i;
+            clients[i] = SLOT_RESERVED;
+            break;
+        }
+    }
+    xSemaphoreGive(clients_lock);
+    if (slot < 0) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "60");
+        httpd_resp_sendstr(req, "Too many live clients");
+        return ESP_OK;
+    }
+
+    // a new client that is slow to take its first event holds up only itself, not publish
+    httpd_resp_set_type(req, "text/event-stream");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_req_t *async_req = NULL;
+    esp_err_t err = httpd_resp_send_chunk(req, event, len);
+    if (err == ESP_OK) {
+        err = httpd_req_async_handler_begin(req, &async_req);
+    }
+
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    bool cancelled = clients[slot] == SLOT_CANCELLED;
+    clients[slot] = err == ESP_OK && !cancelled ? async_req : NULL;
+    xSemaphoreGive(clients_lock);
+    if (err == ESP_OK && cancelled) {
+        // closed while the first event was being sent, the server closes the session on failure
+        httpd_req_async_handler_complete(async_req);
+        return ESP_FAIL;
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to Subscribe Client");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Client Subscribed (slot %d)", slot);
+    return ESP_OK;
+}
+
+void live_feed_publish(const struct sensor_snapshot *snapshot) {
+    char event[LIVE_FEED_EVENT_LEN];
+    char frame[LIVE_FEED_FRAME_LEN];
+    int event_len = format_event(snapshot, event, sizeof(event));
+    int len = snprintf(frame, sizeof(frame), "%x\r\n%s\r\n", event_len, event);
+
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    for (int i = 0; i < LIVE_FEED_MAX_CLIENTS; i++) {
+        if (!is_client(clients[i])) continue;
+
+        // a partial write would corrupt the chunked stream, so it counts as a failure
+        int sent = send(httpd_req_to_sockfd(clients[i]), frame, len, MSG_DONTWAIT);
+        if (sent != len) {
+            drop_client(i);
+            num_dropped++;
+            ESP_LOGW(TAG, "Dropped Slow or Closed Client (slot %d, %lu total)", i, (unsigned long)num_dropped);
+        }
+    }
+    xSemaphoreGive(clients_lock);
+}
+
+void live_feed_close_all() {
+    xSemaphoreTake(clients_lock, portMAX_DELAY);
+    for (int i = 0; i < LIVE_FEED_MAX_CLIENTS; i++) {
+        if (is_client(clients[i])) {
+            drop_client(i);
+        } else if (clients[i] == SLOT_RESERVED) {
+            clients[i] = SLOT_CANCELLED;
+        }
+    }
+    xSemaphoreGive(clients_lock);
+}
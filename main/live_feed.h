@@ -0,0 +1,18 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#include "sensor_state.h"
+
+// Server-Sent Events stream of new readings. Subscribers are held as async
+// requests, so an open stream does not occupy the server task, and every
+// event is written without blocking. A client that cannot take an event
+// straight away is disconnected rather than allowed to stall the others.
+
+#define LIVE_FEED_MAX_CLIENTS 4
+
+void live_feed_init();
+esp_err_t live_feed_subscribe(httpd_req_t *req);
+void live_feed_publish(const struct sensor_snapshot *snapshot);
+void live_feed_close_all();
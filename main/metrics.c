@@ -0,0 +1,213 @@
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "esp_heap_caps.h"
+#include "esp_spiffs.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "metrics.h"
+
+#define METRICS_CHUNK_LEN 512
+// longest single line written, the buffer is flushed before it could overflow
+#define METRICS_LINE_LEN 160
+#define MAX_APP_TASKS 8
+#define NUM_LATENCY_BUCKETS 10
+
+struct metrics_writer {
+    httpd_req_t *req;
+    esp_err_t err;
+    size_t len;
+    char data[METRICS_CHUNK_LEN];
+};
+
+struct task_entry {
+    const char *label;
+    TaskHandle_t handle;
+};
+
+// the handle is stored last, a reader that finds it set also sees the label
+struct app_task_entry {
+    const char *label;
+    _Atomic(TaskHandle_t) handle;
+};
+
+struct request_histogram {
+    atomic_uint buckets[NUM_LATENCY_BUCKETS];
+    // in milliseconds, 32 bits of microseconds would wrap after 71 minutes of
+    // handler time, long before the counts do, milliseconds last 49 days. Each
+    // request is rounded to the nearest one.
+    atomic_uint sum_ms;
+};
+
+static const char *const counter_names[NUM_METRICS_COUNTERS] = {
+    [METRICS_SAMPLES_OK] = "weather_samples_total{result=\"ok\"}",
+    [METRICS_SAMPLES_TIMEOUT] = "weather_samples_total{result=\"timeout\"}",
+    [METRICS_SAMPLES_CHECKSUM] = "weather_samples_total{result=\"checksum\"}",
+    [METRICS_SAMPLES_ERROR] = "weather_samples_total{result=\"error\"}",
+    [METRICS_SAMPLES_REJECTED] = "weather_samples_total{result=\"rejected\"}",
+    [METRICS_BLE_NOTIFICATIONS] = "weather_ble_notifications_total"
+};
+
+static const char *const route_names[NUM_METRICS_ROUTES] = {
+    [METRICS_ROUTE_INDEX] = "/",
+    [METRICS_ROUTE_DOWNLOAD] = "/log.csv",
+    [METRICS_ROUTE_SUMMARY] = "/api/summary",
+    [METRICS_ROUTE_CURRENT] = "/api/current",
+    [METRICS_ROUTE_BOOT] = "/api/boot",
+    [METRICS_ROUTE_METRICS] = "/metrics",
+    [METRICS_ROUTE_ASSETS] = "/assets/*"
+};
+
+// upper bounds in microseconds, the last bucket is +Inf
+static const uint32_t bucket_bounds_us[NUM_LATENCY_BUCKETS - 1] = {
+    5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000
+};
+static const char *const bucket_labels[NUM_LATENCY_BUCKETS] = {
+    "0.005", "0.01", "0.025", "0.05", "0.1", "0.25", "0.5", "1", "2.5", "+Inf"
+};
+
+// tasks created inside ESP-IDF, missing ones are skipped
+static const struct task_entry system_tasks[] = {
+    {"httpd", NULL},
+    {"BTC_TASK", NULL},
+    {"BTU_TASK", NULL},
+    {"BTController", NULL}
+};
+
+static atomic_uint counters[NUM_METRICS_COUNTERS];
+static struct request_histogram histograms[NUM_METRICS_ROUTES];
+static struct app_task_entry app_tasks[MAX_APP_TASKS];
+// slots taken, may run past MAX_APP_TASKS when too many register
+static atomic_uint num_app_tasks = 0;
+
+void metrics_increment(enum metrics_counter counter) {
+    atomic_fetch_add_explicit(&counters[counter], 1, memory_order_relaxed);
+}
+
+void metrics_observe_request(enum metrics_route route, uint32_t time_us) {
+    int bucket = 0;
+    while (bucket < NUM_LATENCY_BUCKETS - 1 && time_us > bucket_bounds_us[bucket]) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&histograms[route].buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histograms[route].sum_ms, (time_us + 500) / 1000, memory_order_relaxed);
+}
+
+// tasks may register concurrently, each takes a slot of its own
+void metrics_register_task(const char *label, TaskHandle_t task) {
+    if (task == NULL) return;
+    unsigned i = atomic_fetch_add_explicit(&num_app_tasks, 1, memory_order_relaxed);
+    if (i >= MAX_APP_TASKS) return;
+    app_tasks[i].label = label;
+    atomic_store_explicit(&app_tasks[i].handle, task, memory_order_release);
+}
+
+static void emit(struct metrics_writer *writer, const char *format, ...) {
+    if (sizeof(writer->data) - writer->len < METRICS_LINE_LEN) {
+        if (writer->err == ESP_OK) {
+            writer->err = httpd_resp_send_chunk(writer->req, writer->data, writer->len);
+        }
+        writer->len = 0;
+    }
+
+    size_t space = sizeof(writer->data) - writer->len;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(writer->data + writer->len, space, format, args);
+    va_end(args);
+    if (n > 0) {
+        writer->len += (size_t)n < space ? (size_t)n : space - 1;
+    }
+}
+
+static void emit_task(struct metrics_writer *writer, bool cpu_time, const char *label, TaskHandle_t task) {
+    if (!cpu_time) {
+        emit(writer, "weather_task_stack_free_bytes{task=\"%s\"} %lu\n", label, (unsigned long)uxTaskGetStackHighWaterMark(task));
+        return;
+    }
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    // the run time counter ticks in microseconds of esp_timer
+    uint64_t run_time_us = ulTaskGetRunTimeCounter(task);
+    emit(writer, "weather_task_cpu_seconds_total{task=\"%s\"} %llu.%06llu\n", label, run_time_us / 1000000, run_time_us % 1000000);
+#endif
+}
+
+// one metric at a time, samples of a metric have to follow its TYPE line
+static void emit_tasks(struct metrics_writer *writer, bool cpu_time) {
+    unsigned num_tasks = atomic_load_explicit(&num_app_tasks, memory_order_relaxed);
+    if (num_tasks > MAX_APP_TASKS) num_tasks = MAX_APP_TASKS;
+    for (unsigned i = 0; i < num_tasks; i++) {
+        // a slot taken by a registration that hasn't finished yet
+        TaskHandle_t task = atomic_load_explicit(&app_tasks[i].handle, memory_order_acquire);
+        if (task != NULL) {
+            emit_task(writer, cpu_time, app_tasks[i].label, task);
+        }
+    }
+    for (size_t i = 0; i < sizeof(system_tasks) / sizeof(system_tasks[0]); i++) {
+        TaskHandle_t task = xTaskGetHandle(system_tasks[i].label);
+        if (task != NULL) {
+            emit_task(writer, cpu_time, system_tasks[i].label, task);
+        }
+    }
+}
+
+esp_err_t metrics_send(httpd_req_t *req) {
+    // served inline on the server task, so there is only ever one scrape at a time
+    static struct metrics_writer writer;
+    writer.req = req;
+    writer.err = ESP_OK;
+    writer.len = 0;
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    emit(&writer, "# TYPE weather_samples_total counter\n");
+    for (int i = 0; i < NUM_METRICS_COUNTERS; i++) {
+        if (i == METRICS_BLE_NOTIFICATIONS) {
+            emit(&writer, "# TYPE weather_ble_notifications_total counter\n");
+        }
+        emit(&writer, "%s %u\n", counter_names[i], (unsigned)atomic_load_explicit(&counters[i], memory_order_relaxed));
+    }
+
+    emit(&writer, "# TYPE weather_uptime_seconds gauge\nweather_uptime_seconds %lld\n", esp_timer_get_time() / 1000000);
+    emit(&writer, "# TYPE weather_heap_free_bytes gauge\nweather_heap_free_bytes %u\n", (unsigned)heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+    emit(&writer, "# TYPE weather_heap_largest_free_block_bytes gauge\nweather_heap_largest_free_block_bytes %u\n",
+        (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+
+    size_t total = 0;
+    size_t used = 0;
+    if (esp_spiffs_info(NULL, &total, &used) == ESP_OK) {
+        emit(&writer, "# TYPE weather_spiffs_used_bytes gauge\nweather_spiffs_used_bytes %u\n", (unsigned)used);
+        emit(&writer, "# TYPE weather_spiffs_total_bytes gauge\nweather_spiffs_total_bytes %u\n", (unsigned)total);
+    }
+
+    emit(&writer, "# TYPE weather_task_stack_free_bytes gauge\n");
+    emit_tasks(&writer, false);
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    emit(&writer, "# TYPE weather_task_cpu_seconds_total counter\n");
+    emit_tasks(&writer, true);
+#endif
+
+    emit(&writer, "# TYPE weather_http_request_duration_seconds histogram\n");
+    for (int i = 0; i < NUM_METRICS_ROUTES; i++) {
+        struct request_histogram *histogram = &histograms[i];
+        unsigned cumulative = 0;
+        for (int j = 0; j < NUM_LATENCY_BUCKETS; j++) {
+            cumulative += atomic_load_explicit(&histogram->buckets[j], memory_order_relaxed);
+            emit(&writer, "weather_http_request_duration_seconds_bucket{uri=\"%s\",le=\"%s\"} %u\n", route_names[i], bucket_labels[j], cumulative);
+        }
+        unsigned sum_ms = atomic_load_explicit(&histogram->sum_ms, memory_order_relaxed);
+        emit(&writer, "weather_http_request_duration_seconds_sum{uri=\"%s\"} %u.%03u\n", route_names[i], sum_ms / 1000, sum_ms % 1000);
+        emit(&writer, "weather_http_request_duration_seconds_count{uri=\"%s\"} %u\n", route_names[i], cumulative);
+    }
+
+    if (writer.err == ESP_OK && writer.len > 0) {
+        writer.err = httpd_resp_send_chunk(req, writer.data, writer.len);
+    }
+    if (writer.err != ESP_OK) {
+        return writer.err;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Counters for the Prometheus text format served at /metrics. Hot paths only
+// do relaxed atomic increments, everything else (task, heap and filesystem
+// state) is read when the endpoint is scraped.
+
+enum metrics_counter {
+    METRICS_SAMPLES_OK,
+    METRICS_SAMPLES_TIMEOUT,
+    METRICS_SAMPLES_CHECKSUM,
+    METRICS_SAMPLES_ERROR,
+    METRICS_SAMPLES_REJECTED,
+    METRICS_BLE_NOTIFICATIONS,
+    NUM_METRICS_COUNTERS
+};
+
+enum metrics_route {
+    METRICS_ROUTE_INDEX,
+    METRICS_ROUTE_DOWNLOAD,
+    METRICS_ROUTE_SUMMARY,
+    METRICS_ROUTE_CURRENT,
+    METRICS_ROUTE_BOOT,
+    METRICS_ROUTE_METRICS,
+    METRICS_ROUTE_ASSETS,
+    NUM_METRICS_ROUTES
+};
+
+void metrics_increment(enum metrics_counter counter);
+void metrics_observe_request(enum metrics_route route, uint32_t time_us);
+// tasks created by the application, system tasks are looked up by name
+void metrics_register_task(const char *label, TaskHandle_t task);
+esp_err_t metrics_send(httpd_req_t *req);
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "page_template.h"
+
+#define TAG "PAGE_TEMPLATE"
+
+#define PAGE_TEMPLATE_CHUNK_LEN 512
+
+struct render_buffer {
+    httpd_req_t *req;
+    esp_err_t err;
+    size_t len;
+    char data[PAGE_TEMPLATE_CHUNK_LEN];
+};
+
+static int find_slot(const char *name, size_t name_len, const char *const *slot_names, size_t num_slots) {
+    for (size_t i = 0; i < num_slots; i++) {
+        if (strlen(slot_names[i]) == name_len && strncmp(slot_names[i], name, name_len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// a template that failed to load renders as an empty page
+static esp_err_t load_failed(struct page_template *tmpl, esp_err_t err) {
+    free(tmpl->text);
+    memset(tmpl, 0, sizeof(*tmpl));
+    return err;
+}
+
+esp_err_t page_template_load(struct page_template *tmpl, const char *path, const char *const *slot_names, size_t num_slots) {
+    memset(tmpl, 0, sizeof(*tmpl));
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "Template (%s) could not be opened.", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(f);
+        return ESP_FAIL;
+    }
+
+    tmpl->text = malloc(size + 1);
+    if (tmpl->text == NULL) {
+        fclose(f);
+        return ESP_ERR_NO_MEM;
+    }
+    size_t len = fread(tmpl->text, 1, size, f);
+    tmpl->text[len] = '\0';
+    fclose(f);
+
+    const char *p = tmpl->text;
+    tmpl->num_segments = 0;
+    while (*p != '\0') {
+        if (tmpl->num_segments == PAGE_TEMPLATE_MAX_SEGMENTS) {
+            ESP_LOGE(TAG, "Template (%s) has too many placeholders.", path);
+            return load_failed(tmpl, ESP_ERR_INVALID_SIZE);
+        }
+        struct page_template_segment *segment = &tmpl->segments[tmpl->num_segments++];
+        segment->literal = p;
+        segment->slot = -1;
+
+        const char *open = strstr(p, "{{");
+        const char *close = open ? strstr(open + 2, "}}") : NULL;
+        if (close == NULL) {
+            segment->literal_len = strlen(p);
+            break;
+        }
+
+        segment->slot = find_slot(open + 2, close - open - 2, slot_names, num_slots);
+        if (segment->slot < 0) {
+            ESP_LOGE(TAG, "Placeholder (%.*s) has no value.", (int)(close - open - 2), open + 2);
+            segment->literal_len = close + 2 - p;
+        } else {
+            segment->literal_len = open - p;
+        }
+        p = close + 2;
+    }
+
+    ESP_LOGI(TAG, "Loaded %s: %zu bytes in %zu segments", path, len, tmpl->num_segments);
+    return ESP_OK;
+}
+
+static void render_flush(struct render_buffer *buf) {
+    if (buf->err == ESP_OK && buf->len > 0) {
+        buf->err = httpd_resp_send_chunk(buf->req, buf->data, buf->len);
+    }
+    buf->len = 0;
+}
+
+static void render_append(struct render_buffer *buf, const char *data, size_t len) {
+    while (len > 0) {
+        size_t n = sizeof(buf->data) - buf->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(buf->data + buf->len, data, n);
+        buf->len += n;
+        data += n;
+        len -= n;
+        if (buf->len == sizeof(buf->data)) {
+            render_flush(buf);
+        }
+    }
+}
+
+esp_err_t page_template_render(const struct page_template *tmpl, httpd_req_t *req, char (*values)[PAGE_TEMPLATE_VALUE_LEN]) {
+    struct render_buffer buf = {
+        .req = req,
+        .err = ESP_OK,
+        .len = 0
+    };
+
+    for (size_t i = 0; i < tmpl->num_segments; i++) {
+        const struct page_template_segment *segment = &tmpl->segments[i];
+        render_append(&buf, segment->literal, segment->literal_len);
+        if (segment->slot >= 0) {
+            render_append(&buf, values[segment->slot], strlen(values[segment->slot]));
+        }
+    }
+    render_flush(&buf);
+
+    if (buf.err != ESP_OK) {
+        return buf.err;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
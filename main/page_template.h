@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#define PAGE_TEMPLATE_MAX_SEGMENTS 16
+#define PAGE_TEMPLATE_VALUE_LEN 12
+
+// A page split once at load time into literal text and {{name}} placeholders,
+// so rendering only has to interleave the literals with formatted values.
+
+struct page_template_segment {
+    const char *literal;
+    size_t literal_len;
+    int slot;
+};
+
+struct page_template {
+    char *text;
+    size_t num_segments;
+    struct page_template_segment segments[PAGE_TEMPLATE_MAX_SEGMENTS];
+};
+
+esp_err_t page_template_load(struct page_template *tmpl, const char *path, const char *const *slot_names, size_t num_slots);
+esp_err_t page_template_render(const struct page_template *tmpl, httpd_req_t *req, char (*values)[PAGE_TEMPLATE_VALUE_LEN]);
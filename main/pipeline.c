@@ -0,0 +1,243 @@
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#include "ble_gatt_server.h"
+#include "boot_profile.h"
+#include "fixed_format.h"
+#include "history.h"
+#include "lcd.h"
+#include "live_feed.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "pipeline_stats.h"
+#include "rollup.h"
+#include "sample_bus.h"
+#include "sample_filter.h"
+#include "sampler.h"
+#include "sensor.h"
+#include "sensor_state.h"
+#include "trace.h"
+
+#define TAG "PIPELINE"
+
+#define PIPELINE_STATS_LOG_INTERVAL 60
+
+static void pollSensors(void* parameter) {
+    struct sensor_data sd;
+    struct sensor_snapshot snapshot;
+    int64_t time_us_start;
+
+    static struct sample_filter filter;
+    const struct sample_filter_config filter_config = {
+        .window = CONFIG_WEATHER_STATION_FILTER_WINDOW,
+        .ema_percent = CONFIG_WEATHER_STATION_FILTER_EMA_PERCENT,
+        .max_temperature_jump = CONFIG_WEATHER_STATION_FILTER_TEMPERATURE_JUMP * 10,
+        .max_humidity_jump = CONFIG_WEATHER_STATION_FILTER_HUMIDITY_JUMP * 100,
+        .max_pressure_jump = CONFIG_WEATHER_STATION_FILTER_PRESSURE_JUMP * 100
+    };
+    sample_filter_init(&filter, &filter_config);
+    sampler_init();
+
+    while(1) {
+        pipeline_stats_record(PIPELINE_STAGE_SCHEDULE, sampler_wait());
+
+        time_us_start = pipeline_stats_begin();
+        trace_begin(TRACE_PROBE_SENSOR_READ);
+        esp_err_t err = sensor_read(&sd);
+        trace_end(TRACE_PROBE_SENSOR_READ);
+        pipeline_stats_end(PIPELINE_STAGE_ACQUIRE, time_us_start);
+        if (err == ESP_ERR_TIMEOUT) {
+            ESP_LOGW(TAG, "%s Read Timed Out", sensor_name());
+            metrics_increment(METRICS_SAMPLES_TIMEOUT);
+            sampler_failure();
+            continue;
+        } else if (err != ESP_OK) {
+            ESP_LOGW(TAG, "%s Read Failed (%s)", sensor_name(), esp_err_to_name(err));
+            metrics_increment(err == ESP_ERR_INVALID_CRC ? METRICS_SAMPLES_CHECKSUM : METRICS_SAMPLES_ERROR);
+            sampler_failure();
+            continue;
+        }
+
+        // a frame can pass its checksum and still be wrong, those are retried like failed reads
+        enum sample_filter_result result = sample_filter_add(&filter, &sd);
+        if (result != SAMPLE_FILTER_ACCEPTED) {
+            ESP_LOGW(TAG, "%s Reading Rejected (%s)", sensor_name(), result == SAMPLE_FILTER_JUMP ? "jump" : "implausible");
+            metrics_increment(METRICS_SAMPLES_REJECTED);
+            sampler_failure();
+            continue;
+        }
+        if (sd.quality == SENSOR_QUALITY_GOOD && sampler_retries() > 0) {
+            sd.quality = SENSOR_QUALITY_RETRIED;
+        }
+        metrics_increment(METRICS_SAMPLES_OK);
+        sampler_success(sd);
+
+        // publishing is a seqlock write plus non-blocking queue sends, sinks run in their own tasks
+        time_us_start = pipeline_stats_begin();
+        trace_begin(TRACE_PROBE_PUBLISH);
+        snapshot = sensor_state_publish(sd);
+        sample_bus_publish(&snapshot);
+        trace_end(TRACE_PROBE_PUBLISH);
+        boot_profile_mark(BOOT_PHASE_FIRST_READING);
+        pipeline_stats_end(PIPELINE_STAGE_PUBLISH, time_us_start);
+
+        char humidity[FIXED_FORMAT_LEN];
+        char celsius[FIXED_FORMAT_LEN];
+        char fahrenheit[FIXED_FORMAT_LEN];
+        fixed_format_humidity(humidity, sizeof(humidity), sd, 0, 1);
+        fixed_format_celsius(celsius, sizeof(celsius), sd, 0, 2);
+        fixed_format_fahrenheit(fahrenheit, sizeof(fahrenheit), sd, 0, 2);
+
+        if (sensor_data_has(sd, SENSOR_CHANNEL_PRESSURE)) {
+            char hectopascals[FIXED_FORMAT_LEN];
+            fixed_format_hectopascals(hectopascals, sizeof(hectopascals), sd, 0, 1);
+            ESP_LOGI(TAG, "Humidity: %s%% | Temperature: %s°C ~ %s°F | Pressure: %s hPa", humidity, celsius, fahrenheit, hectopascals);
+        } else {
+            ESP_LOGI(TAG, "Humidity: %s%% | Temperature: %s°C ~ %s°F", humidity, celsius, fahrenheit);
+        }
+
+        if (snapshot.seq % PIPELINE_STATS_LOG_INTERVAL == 0) {
+            pipeline_stats_log();
+            sample_bus_log();
+        }
+    }
+}
+
+static void drawLCD(struct sensor_data sd) {
+    char line[LCD_COLS + 1];
+    char value[FIXED_FORMAT_LEN];
+
+    trace_begin(TRACE_PROBE_LCD_DRAW);
+    fixed_format_fahrenheit(value, sizeof(value), sd, 0, 2);
+    snprintf(line, sizeof(line), " Temp: %s F", value);
+    lcd_set_line(0, line);
+    fixed_format_humidity(value, sizeof(value), sd, 0, 0);
+    snprintf(line, sizeof(line), " Humidity: %s%%", value);
+    lcd_set_line(1, line);
+
+    lcd_flush();
+    trace_end(TRACE_PROBE_LCD_DRAW);
+}
+
+static void outputLCD(void* parameter) {
+    struct sensor_snapshot snapshot;
+
+    boot_profile_begin(BOOT_PHASE_LCD);
+    lcd_init();
+    boot_profile_end(BOOT_PHASE_LCD);
+
+    // show the reading restored from before a reset until a new one arrives
+    if (sensor_state_get(&snapshot)) {
+        drawLCD(snapshot.sd);
+    }
+
+    while(1) {
+        sample_bus_receive(SAMPLE_SINK_LCD, &snapshot, portMAX_DELAY);
+        int64_t time_us_start = pipeline_stats_begin();
+        drawLCD(snapshot.sd);
+        pipeline_stats_end(PIPELINE_STAGE_LCD, time_us_start);
+    }
+}
+
+static void notifyBLE(void* parameter) {
+    struct sensor_snapshot snapshot;
+    while(1) {
+        sample_bus_receive(SAMPLE_SINK_BLE, &snapshot, portMAX_DELAY);
+        int64_t time_us_start = pipeline_stats_begin();
+        ble_gatt_server_notify(snapshot.sd);
+        pipeline_stats_end(PIPELINE_STAGE_BLE, time_us_start);
+    }
+}
+
+static void logSamples(void* parameter) {
+    struct sensor_snapshot snapshot;
+    int64_t time_us_start;
+    while(1) {
+        sample_bus_receive(SAMPLE_SINK_LOGGER, &snapshot, portMAX_DELAY);
+
+        time_us_start = pipeline_stats_begin();
+        trace_begin(TRACE_PROBE_HISTORY_APPEND);
+        history_append(snapshot.timestamp, snapshot.sd);
+        trace_end(TRACE_PROBE_HISTORY_APPEND);
+        pipeline_stats_end(PIPELINE_STAGE_HISTORY, time_us_start);
+
+        time_us_start = pipeline_stats_begin();
+        rollup_add(snapshot.timestamp, snapshot.sd);
+        pipeline_stats_end(PIPELINE_STAGE_ROLLUP, time_us_start);
+    }
+}
+
+static void streamLive(void* parameter) {
+    struct sensor_snapshot snapshot;
+    while(1) {
+        sample_bus_receive(SAMPLE_SINK_LIVE, &snapshot, portMAX_DELAY);
+        int64_t time_us_start = pipeline_stats_begin();
+        live_feed_publish(&snapshot);
+        pipeline_stats_end(PIPELINE_STAGE_LIVE, time_us_start);
+    }
+}
+
+void pipeline_start_sampling() {
+    TaskHandle_t task;
+    xTaskCreatePinnedToCore(
+        pollSensors,
+        "Measure Temperature and Humidity",
+        2048,
+        NULL,
+        3,
+        &task,
+        1
+    );
+    metrics_register_task("sensor", task);
+
+    xTaskCreatePinnedToCore(
+        outputLCD,
+        "Output Data to LCD",
+        2048,
+        NULL,
+        1,
+        &task,
+        1
+    );
+    metrics_register_task("lcd", task);
+}
+
+void pipeline_start_logger() {
+    TaskHandle_t task;
+    xTaskCreatePinnedToCore(
+        logSamples,
+        "Log Samples to Flash",
+        3072,
+        NULL,
+        1,
+        &task,
+        1
+    );
+    metrics_register_task("logger", task);
+}
+
+void pipeline_start_live() {
+    xTaskCreatePinnedToCore(
+        streamLive,
+        "Stream Live Samples",
+        3072,
+        NULL,
+        1,
+        NULL,
+        1
+    );
+}
+
+void pipeline_start_ble() {
+    TaskHandle_t task;
+    xTaskCreatePinnedToCore(
+        notifyBLE,
+        "Notify BLE Client",
+        2560,
+        NULL,
+        2,
+        &task,
+        1
+    );
+    metrics_register_task("ble_notify", task);
+}
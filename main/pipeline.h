@@ -0,0 +1,13 @@
+#pragma once
+
+// The sampling task and one task per sink of the sample bus. Each is started
+// once what it feeds is ready, the bus holds the readings taken before then.
+
+// the sensor and LCD tasks, the sensor must be initialized
+void pipeline_start_sampling();
+// the history and rollup must be initialized
+void pipeline_start_logger();
+// the live feed must be initialized
+void pipeline_start_live();
+// the GATT server must be initialized
+void pipeline_start_ble();
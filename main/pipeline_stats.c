@@ -0,0 +1,70 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "fixed_format.h"
+#include "pipeline_stats.h"
+
+#define TAG "PIPELINE_STATS"
+
+static const char *const stage_names[NUM_PIPELINE_STAGES] = {
+    [PIPELINE_STAGE_SCHEDULE] = "late",
+    [PIPELINE_STAGE_ACQUIRE] = "acquire",
+    [PIPELINE_STAGE_PUBLISH] = "publish",
+    [PIPELINE_STAGE_HISTORY] = "history",
+    [PIPELINE_STAGE_ROLLUP] = "rollup",
+    [PIPELINE_STAGE_BLE] = "ble",
+    [PIPELINE_STAGE_LCD] = "lcd",
+    [PIPELINE_STAGE_LIVE] = "live"
+};
+
+// each stage is only ever recorded from one task, so plain fields are enough
+static struct pipeline_stage_stats stats[NUM_PIPELINE_STAGES] = {0};
+
+int64_t pipeline_stats_begin() {
+    return esp_timer_get_time();
+}
+
+void pipeline_stats_end(enum pipeline_stage stage, int64_t time_us_start) {
+    pipeline_stats_record(stage, esp_timer_get_time() - time_us_start);
+}
+
+void pipeline_stats_record(enum pipeline_stage stage, uint32_t time_us) {
+    stats[stage].last_us = time_us;
+    if (time_us > stats[stage].max_us) {
+        stats[stage].max_us = time_us;
+    }
+    stats[stage].total_us += time_us;
+    // lowest free stack seen by the task running the stage, in bytes
+    uint32_t stack_free = uxTaskGetStackHighWaterMark(NULL);
+    if (stats[stage].count == 0 || stack_free < stats[stage].stack_free) {
+        stats[stage].stack_free = stack_free;
+    }
+    stats[stage].count++;
+}
+
+void pipeline_stats_get(enum pipeline_stage stage, struct pipeline_stage_stats *stage_stats) {
+    *stage_stats = stats[stage];
+}
+
+void pipeline_stats_log() {
+    int64_t uptime_s = esp_timer_get_time() / 1000000;
+    uint32_t samples = stats[PIPELINE_STAGE_PUBLISH].count;
+    char rate[FIXED_FORMAT_LEN] = "0.00";
+    if (uptime_s > 0) {
+        fixed_format(rate, sizeof(rate), (int64_t)samples * 60, uptime_s, 0, 2, FIXED_FORMAT_DOUBLE);
+    }
+    ESP_LOGI(TAG, "%lu samples in %lld s (%s samples/min)", (unsigned long)samples, uptime_s, rate);
+    for (int i = 0; i < NUM_PIPELINE_STAGES; i++) {
+        if (stats[i].count == 0) continue;
+        ESP_LOGI(TAG, "%-8s n=%-6lu last=%-6lu avg=%-6llu max=%-6lu us stack=%lu",
+            stage_names[i],
+            (unsigned long)stats[i].count,
+            (unsigned long)stats[i].last_us,
+            stats[i].total_us / stats[i].count,
+            (unsigned long)stats[i].max_us,
+            (unsigned long)stats[i].stack_free
+        );
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+enum pipeline_stage {
+    PIPELINE_STAGE_SCHEDULE,
+    PIPELINE_STAGE_ACQUIRE,
+    PIPELINE_STAGE_PUBLISH,
+    PIPELINE_STAGE_HISTORY,
+    PIPELINE_STAGE_ROLLUP,
+    PIPELINE_STAGE_BLE,
+    PIPELINE_STAGE_LCD,
+    PIPELINE_STAGE_LIVE,
+    NUM_PIPELINE_STAGES
+};
+
+struct pipeline_stage_stats {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t stack_free;
+};
+
+int64_t pipeline_stats_begin();
+void pipeline_stats_end(enum pipeline_stage stage, int64_t time_us_start);
+void pipeline_stats_record(enum pipeline_stage stage, uint32_t time_us);
+void pipeline_stats_get(enum pipeline_stage stage, struct pipeline_stage_stats *stats);
+void pipeline_stats_log();
@@ -0,0 +1,25 @@
+#include "esp_app_desc.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+
+#include "retained.h"
+
+#define TAG "RETAINED"
+
+static uint32_t seed = 0;
+
+void retained_init() {
+    const esp_app_desc_t *app = esp_app_get_description();
+    seed = esp_rom_crc32_le(0, app->app_elf_sha256, sizeof(app->app_elf_sha256));
+    ESP_LOGI(TAG, "Reset Reason %d", esp_reset_reason());
+}
+
+void retained_commit(struct retained_header *header, const void *data, size_t len) {
+    header->size = len;
+    header->crc = esp_rom_crc32_le(seed, data, len);
+}
+
+bool retained_valid(const struct retained_header *header, const void *data, size_t len) {
+    return header->size == len && header->crc == esp_rom_crc32_le(seed, data, len);
+}
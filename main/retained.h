@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_attr.h"
+
+// State kept in RTC slow memory across software, watchdog and brownout
+// resets. RTC_NOINIT_ATTR memory is not cleared at boot, so it holds garbage
+// after a power cycle. Every retained copy is therefore committed with a
+// checksum seeded by the firmware image hash, and a copy left behind by a
+// power cycle or by a different build is ignored.
+
+struct retained_header {
+    uint32_t size;
+    uint32_t crc;
+};
+
+void retained_init();
+void retained_commit(struct retained_header *header, const void *data, size_t len);
+bool retained_valid(const struct retained_header *header, const void *data, size_t len);
@@ -0,0 +1,149 @@
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "history.h"
+#include "retained.h"
+#include "rollup.h"
+
+#define TAG "ROLLUP"
+
+// bumped whenever the bucket layout changes
+#define ROLLUP_FORMAT 2
+
+static const char *const partition_labels[NUM_ROLLUP_RESOLUTIONS] = {
+    [ROLLUP_HOURLY] = "rollup_hour",
+    [ROLLUP_DAILY] = "rollup_day"
+};
+
+static struct flash_ring rings[NUM_ROLLUP_RESOLUTIONS];
+static uint8_t ring_ready[NUM_ROLLUP_RESOLUTIONS] = {0};
+
+// buckets still collecting samples, persisted once their period ends and
+// kept in RTC memory until then, so a reset doesn't lose the partial period
+RTC_NOINIT_ATTR static struct rollup_bucket open_buckets[NUM_ROLLUP_RESOLUTIONS];
+RTC_NOINIT_ATTR static struct retained_header open_buckets_header;
+static SemaphoreHandle_t open_buckets_lock;
+
+static uint8_t record_crc(const struct rollup_record *record) {
+    return esp_rom_crc8_le(0, (const uint8_t *)&record->bucket, sizeof(record->bucket));
+}
+
+static int compare_start(const void *record, const void *key) {
+    uint32_t start = ((const struct rollup_record *)record)->bucket.start;
+    uint32_t from = *(const uint32_t *)key;
+    return (start > from) - (start < from);
+}
+
+static void restore_open_buckets() {
+    if (!retained_valid(&open_buckets_header, open_buckets, sizeof(open_buckets))) {
+        memset(open_buckets, 0, sizeof(open_buckets));
+        return;
+    }
+    ESP_LOGI(TAG, "Restored %u Hourly and %u Daily Unflushed Samples",
+        open_buckets[ROLLUP_HOURLY].count, open_buckets[ROLLUP_DAILY].count);
+}
+
+void rollup_init() {
+    open_buckets_lock = xSemaphoreCreateMutex();
+    restore_open_buckets();
+    for (int i = 0; i < NUM_ROLLUP_RESOLUTIONS; i++) {
+        ring_ready[i] = flash_ring_init(&rings[i], partition_labels[i], sizeof(struct rollup_record), ROLLUP_FORMAT) == ESP_OK;
+    }
+}
+
+void rollup_add(time_t timestamp, struct sensor_data sd) {
+    if (timestamp < HISTORY_MIN_VALID_TIME) return;
+
+    for (int i = 0; i < NUM_ROLLUP_RESOLUTIONS; i++) {
+        uint32_t start = rollup_bucket_start(i, timestamp);
+        struct rollup_record closed = {0};
+
+        xSemaphoreTake(open_buckets_lock, portMAX_DELAY);
+        if (open_buckets[i].count > 0 && open_buckets[i].start != start) {
+            closed.bucket = open_buckets[i];
+            memset(&open_buckets[i], 0, sizeof(open_buckets[i]));
+        }
+        open_buckets[i].start = start;
+        rollup_bucket_add(&open_buckets[i], sd);
+        retained_commit(&open_buckets_header, open_buckets, sizeof(open_buckets));
+        xSemaphoreGive(open_buckets_lock);
+
+        // a power cycle mid-period leaves a partial bucket, readers merge records sharing a start
+        if (closed.bucket.count > 0 && ring_ready[i]) {
+            closed.crc = record_crc(&closed);
+            if (flash_ring_append(&rings[i], &closed) != ESP_OK) {
+                ESP_LOGW(TAG, "Failed to Persist Bucket");
+            }
+        }
+    }
+}
+
+void rollup_cursor_init(struct rollup_cursor *cursor, enum rollup_resolution resolution, uint32_t from, uint32_t to) {
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->resolution = resolution;
+    cursor->from = rollup_bucket_start(resolution, from);
+    cursor->to = to;
+    cursor->stored_done = !ring_ready[resolution];
+    if (ring_ready[resolution]) {
+        flash_ring_cursor_seek(&rings[resolution], &cursor->ring_cursor, compare_start, &cursor->from);
+    }
+}
+
+static bool next_partial(struct rollup_cursor *cursor, struct rollup_bucket *bucket) {
+    while (!cursor->stored_done) {
+        if (cursor->index == cursor->num_records) {
+            cursor->num_records = flash_ring_read(&rings[cursor->resolution], &cursor->ring_cursor, cursor->records, ROLLUP_BATCH);
+            cursor->index = 0;
+            if (cursor->num_records == 0) {
+                cursor->stored_done = true;
+                break;
+            }
+        }
+
+        struct rollup_record *record = &cursor->records[cursor->index++];
+        if (record->crc != record_crc(record) || record->bucket.start < cursor->from) continue;
+        if (record->bucket.start > cursor->to) {
+            cursor->stored_done = true;
+            break;
+        }
+        *bucket = record->bucket;
+        return true;
+    }
+
+    if (!cursor->open_done) {
+        cursor->open_done = true;
+        xSemaphoreTake(open_buckets_lock, portMAX_DELAY);
+        *bucket = open_buckets[cursor->resolution];
+        xSemaphoreGive(open_buckets_lock);
+        return bucket->count > 0 && bucket->start >= cursor->from && bucket->start <= cursor->to;
+    }
+    return false;
+}
+
+bool rollup_next(struct rollup_cursor *cursor, struct rollup_bucket *bucket) {
+    struct rollup_bucket partial;
+    while (next_partial(cursor, &partial)) {
+        if (cursor->has_pending && partial.start == cursor->pending.start) {
+            rollup_bucket_merge(&cursor->pending, &partial);
+            continue;
+        }
+        if (cursor->has_pending) {
+            *bucket = cursor->pending;
+            cursor->pending = partial;
+            return true;
+        }
+        cursor->pending = partial;
+        cursor->has_pending = true;
+    }
+
+    if (cursor->has_pending) {
+        *bucket = cursor->pending;
+        cursor->has_pending = false;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "flash_ring.h"
+#include "sensor_data.h"
+
+#define ROLLUP_BATCH 8
+
+enum rollup_resolution {
+    ROLLUP_HOURLY,
+    ROLLUP_DAILY,
+    NUM_ROLLUP_RESOLUTIONS
+};
+
+// min/max/sum/count over one hour or day, in the fixed point units of struct sensor_data
+struct rollup_bucket {
+    uint32_t start;
+    uint64_t pressure_sum;
+    int32_t temperature_sum;
+    uint32_t humidity_sum;
+    uint32_t pressure_min;
+    uint32_t pressure_max;
+    uint16_t count;
+    int16_t temperature_min;
+    int16_t temperature_max;
+    uint16_t humidity_min;
+    uint16_t humidity_max;
+    uint8_t channels;
+};
+
+struct rollup_record {
+    struct rollup_bucket bucket;
+    uint8_t crc;
+    uint8_t reserved[7];
+};
+
+struct rollup_cursor {
+    enum rollup_resolution resolution;
+    uint32_t from;
+    uint32_t to;
+    struct flash_ring_cursor ring_cursor;
+    struct rollup_record records[ROLLUP_BATCH];
+    size_t num_records;
+    size_t index;
+    bool stored_done;
+    bool open_done;
+    bool has_pending;
+    struct rollup_bucket pending;
+};
+
+void rollup_init();
+void rollup_add(time_t timestamp, struct sensor_data sd);
+void rollup_cursor_init(struct rollup_cursor *cursor, enum rollup_resolution resolution, uint32_t from, uint32_t to);
+bool rollup_next(struct rollup_cursor *cursor, struct rollup_bucket *bucket);
+
+// pure bucket math, in rollup_bucket.c so it can run on the host
+uint32_t rollup_bucket_start(enum rollup_resolution resolution, uint32_t timestamp);
+void rollup_bucket_add(struct rollup_bucket *bucket, struct sensor_data sd);
+void rollup_bucket_merge(struct rollup_bucket *bucket, const struct rollup_bucket *other);
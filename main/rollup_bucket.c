@@ -0,0 +1,44 @@
+#include "rollup.h"
+
+static const uint32_t periods[NUM_ROLLUP_RESOLUTIONS] = {
+    [ROLLUP_HOURLY] = 3600,
+    [ROLLUP_DAILY] = 86400
+};
+
+uint32_t rollup_bucket_start(enum rollup_resolution resolution, uint32_t timestamp) {
+    return timestamp - timestamp % periods[resolution];
+}
+
+// every reading in a bucket measures the same channels, see sensor.h
+void rollup_bucket_add(struct rollup_bucket *bucket, struct sensor_data sd) {
+    if (bucket->count == 0 || sd.temperature < bucket->temperature_min) bucket->temperature_min = sd.temperature;
+    if (bucket->count == 0 || sd.temperature > bucket->temperature_max) bucket->temperature_max = sd.temperature;
+    if (bucket->count == 0 || sd.humidity < bucket->humidity_min) bucket->humidity_min = sd.humidity;
+    if (bucket->count == 0 || sd.humidity > bucket->humidity_max) bucket->humidity_max = sd.humidity;
+    if (bucket->count == 0 || sd.pressure < bucket->pressure_min) bucket->pressure_min = sd.pressure;
+    if (bucket->count == 0 || sd.pressure > bucket->pressure_max) bucket->pressure_max = sd.pressure;
+    bucket->temperature_sum += sd.temperature;
+    bucket->humidity_sum += sd.humidity;
+    bucket->pressure_sum += sd.pressure;
+    bucket->channels |= sd.channels;
+    bucket->count++;
+}
+
+void rollup_bucket_merge(struct rollup_bucket *bucket, const struct rollup_bucket *other) {
+    if (other->count == 0) return;
+    if (bucket->count == 0) {
+        *bucket = *other;
+        return;
+    }
+    if (other->temperature_min < bucket->temperature_min) bucket->temperature_min = other->temperature_min;
+    if (other->temperature_max > bucket->temperature_max) bucket->temperature_max = other->temperature_max;
+    if (other->humidity_min < bucket->humidity_min) bucket->humidity_min = other->humidity_min;
+    if (other->humidity_max > bucket->humidity_max) bucket->humidity_max = other->humidity_max;
+    if (other->pressure_min < bucket->pressure_min) bucket->pressure_min = other->pressure_min;
+    if (other->pressure_max > bucket->pressure_max) bucket->pressure_max = other->pressure_max;
+    bucket->temperature_sum += other->temperature_sum;
+    bucket->humidity_sum += other->humidity_sum;
+    bucket->pressure_sum += other->pressure_sum;
+    bucket->channels |= other->channels;
+    bucket->count += other->count;
+}
@@ -0,0 +1,78 @@
+#include "esp_log.h"
+#include "freertos/queue.h"
+
+#include "sample_bus.h"
+
+#define TAG "SAMPLE_BUS"
+
+struct sample_sink_config {
+    const char *name;
+    UBaseType_t depth;
+    // latest-value sinks replace their unread sample instead of dropping the new one
+    bool latest_only;
+};
+
+static const struct sample_sink_config sink_configs[NUM_SAMPLE_SINKS] = {
+    [SAMPLE_SINK_LCD] = {"lcd", 1, true},
+    [SAMPLE_SINK_BLE] = {"ble", 1, true},
+    [SAMPLE_SINK_LOGGER] = {"logger", 16, false},
+    [SAMPLE_SINK_LIVE] = {"live", 1, true}
+};
+
+static QueueHandle_t queues[NUM_SAMPLE_SINKS];
+static struct sample_bus_stats stats[NUM_SAMPLE_SINKS] = {0};
+
+void sample_bus_init() {
+    for (int i = 0; i < NUM_SAMPLE_SINKS; i++) {
+        queues[i] = xQueueCreate(sink_configs[i].depth, sizeof(struct sensor_snapshot));
+    }
+}
+
+void sample_bus_publish(const struct sensor_snapshot *snapshot) {
+    for (int i = 0; i < NUM_SAMPLE_SINKS; i++) {
+        UBaseType_t depth = uxQueueMessagesWaiting(queues[i]);
+        if (sink_configs[i].latest_only) {
+            if (depth > 0) {
+                stats[i].dropped++;
+            }
+            xQueueOverwrite(queues[i], snapshot);
+        } else if (xQueueSend(queues[i], snapshot, 0) != pdTRUE) {
+            stats[i].dropped++;
+            ESP_LOGW(TAG, "Sink (%s) overflowed, sample dropped", sink_configs[i].name);
+            continue;
+        } else {
+            depth++;
+        }
+        if (depth > stats[i].max_depth) {
+            stats[i].max_depth = depth;
+        }
+    }
+}
+
+bool sample_bus_receive(enum sample_sink sink, struct sensor_snapshot *snapshot, TickType_t timeout) {
+    if (xQueueReceive(queues[sink], snapshot, timeout) != pdTRUE) {
+        return false;
+    }
+    stats[sink].delivered++;
+    return true;
+}
+
+void sample_bus_get_stats(enum sample_sink sink, struct sample_bus_stats *sink_stats) {
+    *sink_stats = stats[sink];
+}
+
+const char *sample_bus_sink_name(enum sample_sink sink) {
+    return sink_configs[sink].name;
+}
+
+void sample_bus_log() {
+    for (int i = 0; i < NUM_SAMPLE_SINKS; i++) {
+        ESP_LOGI(TAG, "%-8s delivered=%-6lu dropped=%-6lu max_depth=%lu/%lu",
+            sink_configs[i].name,
+            (unsigned long)stats[i].delivered,
+            (unsigned long)stats[i].dropped,
+            (unsigned long)stats[i].max_depth,
+            (unsigned long)sink_configs[i].depth
+        );
+    }
+}
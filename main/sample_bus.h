@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "sensor_state.h"
+
+// Fans each published snapshot out to one bounded queue per consumer, so
+// the acquisition task never waits on a slow sink.
+
+enum sample_sink {
+    SAMPLE_SINK_LCD,
+    SAMPLE_SINK_BLE,
+    SAMPLE_SINK_LOGGER,
+    SAMPLE_SINK_LIVE,
+    NUM_SAMPLE_SINKS
+};
+
+struct sample_bus_stats {
+    uint32_t delivered;
+    uint32_t dropped;
+    uint32_t max_depth;
+};
+
+void sample_bus_init();
+void sample_bus_publish(const struct sensor_snapshot *snapshot);
+bool sample_bus_receive(enum sample_sink sink, struct sensor_snapshot *snapshot, TickType_t timeout);
+void sample_bus_get_stats(enum sample_sink sink, struct sample_bus_stats *stats);
+const char *sample_bus_sink_name(enum sample_sink sink);
+void sample_bus_log();
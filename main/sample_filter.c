@@ -0,0 +1,143 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "sample_filter.h"
+
+#define NUM_CHANNELS 3
+#define AVERAGE_SCALE 16
+
+// widest range of any supported sensor
+#define TEMPERATURE_MIN -4000
+#define TEMPERATURE_MAX 8500
+#define HUMIDITY_MAX 10000
+#define PRESSURE_MIN 30000
+#define PRESSURE_MAX 110000
+
+static const uint8_t channel_masks[NUM_CHANNELS] = {
+    SENSOR_CHANNEL_TEMPERATURE,
+    SENSOR_CHANNEL_HUMIDITY,
+    SENSOR_CHANNEL_PRESSURE
+};
+
+static int32_t get_channel(const struct sensor_data *sd, int channel) {
+    switch (channel) {
+        case 0: return sd->temperature;
+        case 1: return sd->humidity;
+        default: return sd->pressure;
+    }
+}
+
+static void set_channel(struct sensor_data *sd, int channel, int32_t value) {
+    switch (channel) {
+        case 0: sd->temperature = value; break;
+        case 1: sd->humidity = value; break;
+        default: sd->pressure = value; break;
+    }
+}
+
+static bool plausible(const struct sensor_data *sd) {
+    if (sensor_data_has(*sd, SENSOR_CHANNEL_TEMPERATURE)
+        && (sd->temperature < TEMPERATURE_MIN || sd->temperature > TEMPERATURE_MAX)) {
+        return false;
+    }
+    if (sensor_data_has(*sd, SENSOR_CHANNEL_HUMIDITY) && sd->humidity > HUMIDITY_MAX) {
+        return false;
+    }
+    if (sensor_data_has(*sd, SENSOR_CHANNEL_PRESSURE)
+        && (sd->pressure < PRESSURE_MIN || sd->pressure > PRESSURE_MAX)) {
+        return false;
+    }
+    return true;
+}
+
+// even counts, while the window fills, take the mean of the middle two
+static int32_t median(const struct sample_filter *filter, int channel) {
+    int32_t sorted[SAMPLE_FILTER_MAX_WINDOW];
+    int n = filter->count;
+    for (int i = 0; i < n; i++) {
+        int32_t value = filter->readings[channel][i];
+        int j = i;
+        for (; j > 0 && sorted[j - 1] > value; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = value;
+    }
+    return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+static bool differs(const struct sample_filter *filter, const struct sensor_data *sd, const struct sensor_data *reference) {
+    const int32_t max_jumps[NUM_CHANNELS] = {
+        filter->config.max_temperature_jump,
+        filter->config.max_humidity_jump,
+        filter->config.max_pressure_jump
+    };
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+        if (sensor_data_has(*sd, channel_masks[channel])
+            && abs(get_channel(sd, channel) - get_channel(reference, channel)) > max_jumps[channel]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool jumped(const struct sample_filter *filter, const struct sensor_data *sd) {
+    if (filter->count == 0) return false;
+
+    struct sensor_data reference = *sd;
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+        set_channel(&reference, channel, median(filter, channel));
+    }
+    return differs(filter, sd, &reference);
+}
+
+void sample_filter_init(struct sample_filter *filter, const struct sample_filter_config *config) {
+    filter->config = *config;
+    if (filter->config.window < 1) filter->config.window = 1;
+    if (filter->config.window > SAMPLE_FILTER_MAX_WINDOW) filter->config.window = SAMPLE_FILTER_MAX_WINDOW;
+    if (filter->config.ema_percent < 1 || filter->config.ema_percent > 100) filter->config.ema_percent = 100;
+    filter->count = 0;
+    filter->next = 0;
+    filter->jumps = 0;
+}
+
+enum sample_filter_result sample_filter_add(struct sample_filter *filter, struct sensor_data *sd) {
+    if (!plausible(sd)) {
+        return SAMPLE_FILTER_IMPLAUSIBLE;
+    }
+
+    sd->quality = SENSOR_QUALITY_GOOD;
+    if (jumped(filter, sd)) {
+        // scattered outliers restart the run, only a steady new level completes it
+        if (filter->jumps == 0 || differs(filter, sd, &filter->jump)) {
+            filter->jump = *sd;
+            filter->jumps = 0;
+        }
+        if (++filter->jumps < SAMPLE_FILTER_JUMP_CONFIRM) {
+            return SAMPLE_FILTER_JUMP;
+        }
+        filter->count = 0;
+        filter->next = 0;
+        sd->quality = SENSOR_QUALITY_RESTARTED;
+    }
+    filter->jumps = 0;
+
+    bool first = filter->count == 0;
+    if (filter->count < filter->config.window) {
+        filter->count++;
+    }
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+        filter->readings[channel][filter->next] = get_channel(sd, channel);
+    }
+    filter->next = (filter->next + 1) % filter->config.window;
+
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+        if (!sensor_data_has(*sd, channel_masks[channel])) continue;
+
+        int32_t scaled = median(filter, channel) * AVERAGE_SCALE;
+        int32_t *average = &filter->average[channel];
+        *average = first ? scaled : *average + (scaled - *average) * filter->config.ema_percent / 100;
+        // round half away from zero back to the channel unit
+        set_channel(sd, channel, (*average + (*average < 0 ? -AVERAGE_SCALE / 2 : AVERAGE_SCALE / 2)) / AVERAGE_SCALE);
+    }
+    return SAMPLE_FILTER_ACCEPTED;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sensor_data.h"
+
+// Rejects readings outside the physical range of the channels or too far
+// from the recent median, then smooths the accepted ones with a running
+// median followed by an exponential moving average. A real step change
+// shows up as several jumps in a row that agree with each other, which
+// restarts the filter at the new level instead of rejecting it forever.
+
+#define SAMPLE_FILTER_MAX_WINDOW 7
+// consecutive, agreeing jumps taken as a real change
+#define SAMPLE_FILTER_JUMP_CONFIRM 3
+
+enum sample_filter_result {
+    SAMPLE_FILTER_ACCEPTED,
+    SAMPLE_FILTER_IMPLAUSIBLE,
+    SAMPLE_FILTER_JUMP
+};
+
+struct sample_filter_config {
+    uint8_t window;               // readings in the median, 1 turns it off
+    uint8_t ema_percent;          // weight of a new median in the average, 100 turns it off
+    int32_t max_temperature_jump; // hundredths of a degree
+    int32_t max_humidity_jump;    // hundredths of a percent
+    int32_t max_pressure_jump;    // pascals
+};
+
+struct sample_filter {
+    struct sample_filter_config config;
+    int32_t readings[3][SAMPLE_FILTER_MAX_WINDOW];
+    // sixteenths of the channel unit, so small steps aren't lost to rounding
+    int32_t average[3];
+    // first reading of the current run of jumps
+    struct sensor_data jump;
+    uint8_t count;
+    uint8_t next;
+    uint8_t jumps;
+};
+
+void sample_filter_init(struct sample_filter *filter, const struct sample_filter_config *config);
+// replaces an accepted reading with the filtered one and sets its quality
+enum sample_filter_result sample_filter_add(struct sample_filter *filter, struct sensor_data *sd);
@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#include "retained.h"
+#include "sampler.h"
+
+#define TAG "SAMPLER"
+
+#define SAMPLE_PERIOD_MS CONFIG_WEATHER_STATION_SAMPLE_PERIOD_MS
+#define SAMPLE_RETRY_MS CONFIG_WEATHER_STATION_SAMPLE_RETRY_MS
+#define SAMPLE_MAX_RETRIES CONFIG_WEATHER_STATION_SAMPLE_MAX_RETRIES
+
+struct sampler_state {
+    int64_t deadline_us;
+    uint32_t period_ms;
+    uint32_t retries;
+    struct sensor_data last_sd;
+    uint8_t have_last_sd;
+};
+
+// kept across resets so a reboot resumes the schedule instead of restarting it
+RTC_NOINIT_ATTR static struct sampler_state state;
+RTC_NOINIT_ATTR static struct retained_header state_header;
+// whole-second copy of the deadline that other tasks can read without tearing
+static volatile uint32_t deadline_s = 0;
+
+static int64_t wall_time_us() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void set_deadline(int64_t time_us) {
+    state.deadline_us = time_us;
+    deadline_s = (time_us + 999999) / 1000000;
+    retained_commit(&state_header, &state, sizeof(state));
+}
+
+static int64_t next_boundary_us(int64_t now_us) {
+    int64_t period_us = (int64_t)state.period_ms * 1000;
+    return (now_us / period_us + 1) * period_us;
+}
+
+// deadlines sit on multiples of the period, so read time never feeds into the next one
+static void schedule_next_boundary() {
+    state.retries = 0;
+    set_deadline(next_boundary_us(wall_time_us()));
+}
+
+void sampler_init() {
+    int64_t now_us = wall_time_us();
+    if (retained_valid(&state_header, &state, sizeof(state))) {
+        ESP_LOGI(TAG, "Resuming Schedule, period %lu ms", (unsigned long)state.period_ms);
+        set_deadline(state.deadline_us > now_us ? state.deadline_us : now_us);
+        return;
+    }
+
+    state.period_ms = SAMPLE_PERIOD_MS;
+    state.retries = 0;
+    state.have_last_sd = 0;
+    set_deadline(now_us);
+}
+
+// sleeps until the deadline and returns how late the wakeup was in microseconds
+int64_t sampler_wait() {
+    int64_t now_us;
+    while ((now_us = wall_time_us()) < state.deadline_us) {
+        // no deadline is set further out than the next boundary, so one that
+        // is must come from an SNTP step backwards and would stall sampling
+        if (state.deadline_us > next_boundary_us(now_us)) {
+            schedule_next_boundary();
+            continue;
+        }
+        // vTaskDelay(n) may return after n - 1 ticks, the loop covers the remainder
+        uint32_t remaining_ms = (state.deadline_us - now_us + 999) / 1000;
+        TickType_t ticks = (remaining_ms * configTICK_RATE_HZ + 999) / 1000;
+        vTaskDelay(ticks > 0 ? ticks : 1);
+    }
+    // more than a period late is an SNTP step forwards, typically the first
+    // one from 1970, not lateness, it would swamp the schedule stats
+    if (now_us - state.deadline_us > (int64_t)state.period_ms * 1000) {
+        schedule_next_boundary();
+        return 0;
+    }
+    return now_us - state.deadline_us;
+}
+
+void sampler_success(struct sensor_data sd) {
+#if CONFIG_WEATHER_STATION_ADAPTIVE_SAMPLING
+    if (state.have_last_sd) {
+        // thresholds are in tenths of a degree and whole percent, readings in hundredths
+        int temperature_delta = abs(sd.temperature - state.last_sd.temperature);
+        int humidity_delta = abs(sd.humidity - state.last_sd.humidity);
+        uint32_t previous_period_ms = state.period_ms;
+        if (temperature_delta >= CONFIG_WEATHER_STATION_ADAPTIVE_TEMPERATURE_DELTA * 10
+            || humidity_delta >= CONFIG_WEATHER_STATION_ADAPTIVE_HUMIDITY_DELTA * 100) {
+            if (state.period_ms / 2 >= CONFIG_WEATHER_STATION_ADAPTIVE_MIN_PERIOD_MS) {
+                state.period_ms /= 2;
+            }
+        } else if (state.period_ms * 2 <= SAMPLE_PERIOD_MS) {
+            state.period_ms *= 2;
+        }
+        if (state.period_ms != previous_period_ms) {
+            ESP_LOGI(TAG, "Sample Period Changed to %lu ms", (unsigned long)state.period_ms);
+        }
+    }
+    state.last_sd = sd;
+    state.have_last_sd = 1;
+#endif
+    schedule_next_boundary();
+}
+
+// a retry that would not come before the next boundary is dropped, the
+// reading at the boundary takes its place
+void sampler_failure() {
+    int64_t now_us = wall_time_us();
+    int64_t retry_us = now_us + (int64_t)SAMPLE_RETRY_MS * 1000;
+    if (state.retries < SAMPLE_MAX_RETRIES && retry_us < next_boundary_us(now_us)) {
+        state.retries++;
+        set_deadline(retry_us);
+        return;
+    }
+    ESP_LOGW(TAG, "Giving Up on Sample After %lu Retries", (unsigned long)state.retries);
+    schedule_next_boundary();
+}
+
+// failed or rejected reads so far in the current period
+uint32_t sampler_retries() {
+    return state.retries;
+}
+
+uint32_t sampler_period_ms() {
+    return state.period_ms;
+}
+
+// seconds until the next scheduled reading, rounded up
+uint32_t sampler_seconds_until_next() {
+    uint32_t next_s = deadline_s;
+    uint32_t now_s = time(NULL);
+    return next_s > now_s ? next_s - now_s : 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sensor_data.h"
+
+void sampler_init();
+int64_t sampler_wait();
+void sampler_success(struct sensor_data sd);
+void sampler_failure();
+uint32_t sampler_retries();
+uint32_t sampler_period_ms();
+uint32_t sampler_seconds_until_next();
@@ -0,0 +1,65 @@
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "sensor.h"
+#if SENSOR_DHT_CHANNELS
+#include "dht.h"
+#endif
+#if SENSOR_BME280_CHANNELS
+#include "bme280.h"
+#endif
+
+#define TAG "SENSOR"
+
+#if SENSOR_CHANNELS == 0
+#error "Enable at least one sensor under Weather Station > Sensors"
+#endif
+
+void sensor_init() {
+#if SENSOR_DHT_CHANNELS
+    dht_init(CONFIG_WEATHER_STATION_DHT_GPIO);
+#endif
+#if SENSOR_BME280_CHANNELS
+    if (bme280_init(CONFIG_WEATHER_STATION_BME280_SDA_GPIO, CONFIG_WEATHER_STATION_BME280_SCL_GPIO, CONFIG_WEATHER_STATION_BME280_ADDRESS) != ESP_OK) {
+        ESP_LOGE(TAG, "BME280 Initialization Failed");
+    }
+#endif
+}
+
+esp_err_t sensor_read(struct sensor_data *sd) {
+    esp_err_t err = ESP_OK;
+    memset(sd, 0, sizeof(*sd));
+
+    // the BME280 converts while the DHT start pulse and frame are in progress
+#if SENSOR_BME280_CHANNELS
+    err = bme280_start();
+    if (err != ESP_OK) {
+        return err;
+    }
+#endif
+#if SENSOR_DHT_CHANNELS
+    err = dht_read(sd);
+    if (err != ESP_OK) {
+        return err;
+    }
+#endif
+#if SENSOR_BME280_CHANNELS
+    err = bme280_read(sd);
+#endif
+    return err;
+}
+
+const char *sensor_name() {
+#if CONFIG_WEATHER_STATION_SENSOR_DHT11 && SENSOR_BME280_CHANNELS
+    return "DHT11+BME280";
+#elif CONFIG_WEATHER_STATION_SENSOR_DHT22 && SENSOR_BME280_CHANNELS
+    return "DHT22+BME280";
+#elif CONFIG_WEATHER_STATION_SENSOR_DHT11
+    return "DHT11";
+#elif CONFIG_WEATHER_STATION_SENSOR_DHT22
+    return "DHT22";
+#else
+    return "BME280";
+#endif
+}
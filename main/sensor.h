@@ -0,0 +1,31 @@
+#pragma once
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#include "sensor_data.h"
+
+// Sensors are chosen in Kconfig and called directly, so the acquisition
+// path has no function pointers. All enabled sensors are read in one
+// batched cycle into a single record, and the cycle only succeeds if every
+// sensor does. When two sensors measure the same channel, the one read
+// later (the BME280) wins.
+
+#if CONFIG_WEATHER_STATION_SENSOR_DHT11 || CONFIG_WEATHER_STATION_SENSOR_DHT22
+#define SENSOR_DHT_CHANNELS (SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY)
+#else
+#define SENSOR_DHT_CHANNELS 0
+#endif
+
+#if CONFIG_WEATHER_STATION_SENSOR_BME280
+#define SENSOR_BME280_CHANNELS (SENSOR_CHANNEL_TEMPERATURE | SENSOR_CHANNEL_HUMIDITY | SENSOR_CHANNEL_PRESSURE)
+#else
+#define SENSOR_BME280_CHANNELS 0
+#endif
+
+// every channel present in a successful reading
+#define SENSOR_CHANNELS (SENSOR_DHT_CHANNELS | SENSOR_BME280_CHANNELS)
+
+void sensor_init();
+esp_err_t sensor_read(struct sensor_data *sd);
+const char *sensor_name();
@@ -1,18 +1,36 @@
 #pragma once
 
-struct sensor_data {
-    uint8_t humidity;
-    uint16_t temperature;
+#include <stdint.h>
+
+// Reading normalized to fixed point, so every sensor driver produces the
+// same record. Channels a sensor does not measure are left out of the mask
+// and read as zero.
+
+#define SENSOR_CHANNEL_TEMPERATURE 0x01
+#define SENSOR_CHANNEL_HUMIDITY 0x02
+#define SENSOR_CHANNEL_PRESSURE 0x04
+
+enum sensor_quality {
+    SENSOR_QUALITY_GOOD,
+    // reads earlier in the same period failed or were rejected
+    SENSOR_QUALITY_RETRIED,
+    // the value moved further than the filter allows and stayed there, so the filter restarted
+    SENSOR_QUALITY_RESTARTED,
+    NUM_SENSOR_QUALITIES
 };
 
-static inline uint8_t sensor_data_get_humidity(struct sensor_data sd) {
-    return sd.humidity;
-}
+struct sensor_data {
+    int16_t temperature;  // hundredths of a degree celsius
+    uint16_t humidity;    // hundredths of a percent relative humidity
+    uint32_t pressure;    // pascals
+    uint8_t channels;
+    uint8_t quality;      // enum sensor_quality
+};
 
-static inline float sensor_data_get_celsius(struct sensor_data sd) {
-    return ((sd.temperature & 0xFF00) >> 8) + (float)(sd.temperature & 0x00FF) / 10;
+static inline int sensor_data_has(struct sensor_data sd, uint8_t channel) {
+    return (sd.channels & channel) != 0;
 }
 
-static inline float sensor_data_get_fahrenheit(struct sensor_data sd) {
-    return sensor_data_get_celsius(sd) * 1.8 + 32;
+static inline int16_t sensor_data_get_centicelsius(struct sensor_data sd) {
+    return sd.temperature;
 }
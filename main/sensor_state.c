@@ -0,0 +1,86 @@
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "fixed_format.h"
+#include "retained.h"
+#include "sensor_state.h"
+#include "seqlock.h"
+
+// seqlock around the latest reading, the sequence is twice the snapshot's
+static seqlock_t seq = 0;
+static struct sensor_snapshot current = {0};
+static portMUX_TYPE writer_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const quality_names[NUM_SENSOR_QUALITIES] = {
+    [SENSOR_QUALITY_GOOD] = "good",
+    [SENSOR_QUALITY_RETRIED] = "retried",
+    [SENSOR_QUALITY_RESTARTED] = "restarted"
+};
+
+// last published reading, kept across resets so it can be served at boot
+RTC_NOINIT_ATTR static struct sensor_snapshot retained_snapshot;
+RTC_NOINIT_ATTR static struct retained_header retained_snapshot_header;
+
+struct sensor_snapshot sensor_state_publish(struct sensor_data sd) {
+    time_t now;
+    time(&now);
+
+    // keep the writer from being preempted by a reader spinning on its own core
+    taskENTER_CRITICAL(&writer_lock);
+    uint32_t s = seqlock_write_begin(&seq);
+
+    current.seq = (s + 2) / 2;
+    current.timestamp = now;
+    current.sd = sd;
+    struct sensor_snapshot published = current;
+
+    seqlock_write_end(&seq, s);
+    taskEXIT_CRITICAL(&writer_lock);
+
+    retained_snapshot = published;
+    retained_commit(&retained_snapshot_header, &retained_snapshot, sizeof(retained_snapshot));
+    return published;
+}
+
+// called once before any reader or writer starts
+bool sensor_state_restore() {
+    if (!retained_valid(&retained_snapshot_header, &retained_snapshot, sizeof(retained_snapshot))) {
+        return false;
+    }
+    current = retained_snapshot;
+    seqlock_init(&seq, current.seq * 2);
+    return true;
+}
+
+bool sensor_state_get(struct sensor_snapshot *snapshot) {
+    uint32_t s;
+    do {
+        s = seqlock_read_begin(&seq);
+        *snapshot = current;
+    } while (seqlock_read_retry(&seq, s));
+
+    return s != 0;
+}
+
+int sensor_state_format_json(const struct sensor_snapshot *snapshot, char *buf, size_t len) {
+    char celsius[FIXED_FORMAT_LEN];
+    char humidity[FIXED_FORMAT_LEN];
+    fixed_format_celsius(celsius, sizeof(celsius), snapshot->sd, 0, 1);
+    fixed_format_humidity(humidity, sizeof(humidity), snapshot->sd, 0, 1);
+
+    int n = snprintf(buf, len, "{\"seq\":%lu,\"time\":%lld,\"temperature\":%s,\"humidity\":%s",
+        (unsigned long)snapshot->seq,
+        (long long)snapshot->timestamp,
+        celsius,
+        humidity
+    );
+    if (sensor_data_has(snapshot->sd, SENSOR_CHANNEL_PRESSURE)) {
+        char hectopascals[FIXED_FORMAT_LEN];
+        fixed_format_hectopascals(hectopascals, sizeof(hectopascals), snapshot->sd, 0, 1);
+        n += snprintf(buf + n, len - n, ",\"pressure\":%s", hectopascals);
+    }
+    n += snprintf(buf + n, len - n, ",\"quality\":\"%s\"}",
+        snapshot->sd.quality < NUM_SENSOR_QUALITIES ? quality_names[snapshot->sd.quality] : "unknown");
+    return n;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "sensor_data.h"
+
+#define SENSOR_STATE_JSON_LEN 160
+
+struct sensor_snapshot {
+    uint32_t seq;
+    time_t timestamp;
+    struct sensor_data sd;
+};
+
+struct sensor_snapshot sensor_state_publish(struct sensor_data sd);
+bool sensor_state_get(struct sensor_snapshot *snapshot);
+bool sensor_state_restore();
+int sensor_state_format_json(const struct sensor_snapshot *snapshot, char *buf, size_t len);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sequence lock for one writer and readers that never block or take a
+// lock. The sequence is odd while the writer is mid-update; readers copy
+// the data and retry if the sequence moved underneath them. The writer
+// must not be preempted by a reader spinning on its own core, so it runs
+// in a critical section.
+
+typedef _Atomic uint32_t seqlock_t;
+
+// returns the sequence before the update
+static inline uint32_t seqlock_write_begin(seqlock_t *seq) {
+    uint32_t s = atomic_load_explicit(seq, memory_order_relaxed);
+    atomic_store_explicit(seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    return s;
+}
+
+static inline void seqlock_write_end(seqlock_t *seq, uint32_t s) {
+    atomic_store_explicit(seq, s + 2, memory_order_release);
+}
+
+static inline uint32_t seqlock_read_begin(seqlock_t *seq) {
+    return atomic_load_explicit(seq, memory_order_acquire);
+}
+
+// true when the copy made since seqlock_read_begin returned s may be torn
+static inline bool seqlock_read_retry(seqlock_t *seq, uint32_t s) {
+    atomic_thread_fence(memory_order_acquire);
+    return (s & 1) || s != atomic_load_explicit(seq, memory_order_relaxed);
+}
+
+// before any reader or writer starts
+static inline void seqlock_init(seqlock_t *seq, uint32_t s) {
+    atomic_store_explicit(seq, s, memory_order_release);
+}
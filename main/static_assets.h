@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Static files from filesystem/ other than the page templates. At build time
+// tools/build_assets.py gzips each one, names it after a hash of its content
+// and links it into the firmware through this table. A changed file gets a
+// new path, so responses are cacheable forever and a revalidation is
+// answered from the table alone.
+
+#define STATIC_ASSETS_URI "/assets/*"
+
+struct static_asset {
+    const char *path;
+    const char *content_type;
+    // strong, quoted
+    const char *etag;
+    // gzip
+    const uint8_t *data;
+    size_t len;
+};
+
+extern const struct static_asset static_assets[];
+extern const size_t num_static_assets;
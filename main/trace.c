@@ -0,0 +1,129 @@
+#include "sdkconfig.h"
+
+#if CONFIG_WEATHER_STATION_TRACE
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "trace.h"
+
+#define TAG "TRACE"
+
+#define TRACE_EVENTS CONFIG_WEATHER_STATION_TRACE_EVENTS
+#define MAX_TRACED_TASKS 24
+#define DUMP_HEADER_LEN 16
+
+struct trace_event {
+    uint32_t time_us;
+    uint16_t task;
+    uint8_t probe;
+    uint8_t phase;
+};
+
+struct trace_ring {
+    atomic_uint recorded;
+    struct trace_event events[TRACE_EVENTS];
+};
+
+static const char *const probe_names[NUM_TRACE_PROBES] = {
+    [TRACE_PROBE_SENSOR_READ] = "sensor_read",
+    [TRACE_PROBE_PUBLISH] = "publish",
+    [TRACE_PROBE_HISTORY_APPEND] = "history_append",
+    [TRACE_PROBE_LCD_DRAW] = "lcd_draw",
+    [TRACE_PROBE_LCD_COMMAND] = "lcd_command",
+    [TRACE_PROBE_BLE_NOTIFY] = "ble_notify",
+    [TRACE_PROBE_HTTP_INDEX] = "http_index",
+    [TRACE_PROBE_HTTP_DOWNLOAD] = "http_download"
+};
+
+// a task is numbered by its first probe, the name is copied so it outlives the task
+static char task_names[MAX_TRACED_TASKS][configMAX_TASK_NAME_LEN];
+static atomic_uint num_tasks = 0;
+
+static struct trace_ring rings[portNUM_PROCESSORS];
+static atomic_bool frozen = false;
+
+static uint16_t task_number() {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    UBaseType_t number = uxTaskGetTaskNumber(task);
+    if (number != 0) return number;
+
+    unsigned i = atomic_fetch_add_explicit(&num_tasks, 1, memory_order_relaxed);
+    if (i >= MAX_TRACED_TASKS) {
+        atomic_store_explicit(&num_tasks, MAX_TRACED_TASKS, memory_order_relaxed);
+        return 0;
+    }
+    strlcpy(task_names[i], pcTaskGetName(task), sizeof(task_names[i]));
+    vTaskSetTaskNumber(task, i + 1);
+    return i + 1;
+}
+
+void trace_record(enum trace_probe probe, bool begin) {
+    if (atomic_load_explicit(&frozen, memory_order_relaxed)) return;
+
+    // a task moved to the other core in between only lands in the other ring, the slot is still its own
+    struct trace_ring *ring = &rings[xPortGetCoreID()];
+    unsigned i = atomic_fetch_add_explicit(&ring->recorded, 1, memory_order_relaxed) % TRACE_EVENTS;
+    ring->events[i] = (struct trace_event){
+        .time_us = esp_timer_get_time(),
+        .task = task_number(),
+        .probe = probe,
+        .phase = begin
+    };
+}
+
+static esp_err_t send_ring(httpd_req_t *req, struct trace_ring *ring) {
+    uint32_t recorded = atomic_load_explicit(&ring->recorded, memory_order_relaxed);
+    uint32_t header[2] = {recorded, recorded < TRACE_EVENTS ? recorded : TRACE_EVENTS};
+    esp_err_t err = httpd_resp_send_chunk(req, (const char *)header, sizeof(header));
+
+    // events are written in the layout of the dump, the ESP32 is little endian
+    if (recorded > TRACE_EVENTS && err == ESP_OK) {
+        uint32_t oldest = recorded % TRACE_EVENTS;
+        err = httpd_resp_send_chunk(req, (const char *)&ring->events[oldest], (TRACE_EVENTS - oldest) * sizeof(struct trace_event));
+        recorded = oldest;
+    }
+    if (recorded > 0 && err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, (const char *)ring->events, recorded * sizeof(struct trace_event));
+    }
+    return err;
+}
+
+esp_err_t trace_send(httpd_req_t *req) {
+    // stop recording for a consistent snapshot, one tick lets probes that were mid-write finish
+    atomic_store_explicit(&frozen, true, memory_order_relaxed);
+    vTaskDelay(1);
+
+    unsigned tasks = atomic_load_explicit(&num_tasks, memory_order_relaxed);
+    tasks = tasks < MAX_TRACED_TASKS ? tasks : MAX_TRACED_TASKS;
+    uint64_t now_us = esp_timer_get_time();
+    uint8_t header[DUMP_HEADER_LEN] = {'W', 'S', 'T', 'R', TRACE_DUMP_VERSION, portNUM_PROCESSORS, NUM_TRACE_PROBES, tasks};
+    memcpy(header + 8, &now_us, sizeof(now_us));
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"trace.bin\"");
+    esp_err_t err = httpd_resp_send_chunk(req, (const char *)header, sizeof(header));
+    for (int i = 0; i < NUM_TRACE_PROBES && err == ESP_OK; i++) {
+        err = httpd_resp_send_chunk(req, probe_names[i], strlen(probe_names[i]) + 1);
+    }
+    for (unsigned i = 0; i < tasks && err == ESP_OK; i++) {
+        err = httpd_resp_send_chunk(req, task_names[i], strlen(task_names[i]) + 1);
+    }
+    for (int core = 0; core < portNUM_PROCESSORS && err == ESP_OK; core++) {
+        err = send_ring(req, &rings[core]);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+
+    atomic_store_explicit(&frozen, false, memory_order_relaxed);
+    ESP_LOGI(TAG, "Sent Trace Dump");
+    return err;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "sdkconfig.h"
+
+// Begin and end events from fixed probe points, kept in one ring per core so
+// recording is a single atomic increment and a few stores. The rings are
+// served as a binary dump at /api/trace, tools/trace_to_chrome.py turns it
+// into Chrome trace JSON. Without CONFIG_WEATHER_STATION_TRACE the probes
+// are empty inline functions and compile to nothing.
+//
+// Dump layout, little endian:
+//   "WSTR", version (1 byte), cores, probes, tasks, dump time (8 bytes, us)
+//   the probe names, then the names of tasks 1 to tasks, each NUL terminated
+//   per core: events recorded since boot (4), events that follow (4),
+//   then the events oldest first, each time (4, low bits of us since boot),
+//   task number (2, 0 once the task table is full), probe (1),
+//   phase (1, 1 for begin and 0 for end)
+
+#define TRACE_DUMP_VERSION 1
+
+enum trace_probe {
+    TRACE_PROBE_SENSOR_READ,
+    TRACE_PROBE_PUBLISH,
+    TRACE_PROBE_HISTORY_APPEND,
+    TRACE_PROBE_LCD_DRAW,
+    TRACE_PROBE_LCD_COMMAND,
+    TRACE_PROBE_BLE_NOTIFY,
+    TRACE_PROBE_HTTP_INDEX,
+    TRACE_PROBE_HTTP_DOWNLOAD,
+    NUM_TRACE_PROBES
+};
+
+#if CONFIG_WEATHER_STATION_TRACE
+
+void trace_record(enum trace_probe probe, bool begin);
+esp_err_t trace_send(httpd_req_t *req);
+
+static inline void trace_begin(enum trace_probe probe) {
+    trace_record(probe, true);
+}
+
+static inline void trace_end(enum trace_probe probe) {
+    trace_record(probe, false);
+}
+
+#else
+
+static inline void trace_begin(enum trace_probe probe) {}
+static inline void trace_end(enum trace_probe probe) {}
+
+#endif
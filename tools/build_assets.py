@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Prepare filesystem/ for the firmware, run by main/CMakeLists.txt.
+
+Pages (.html) are templates filled in on the device, so they are copied to
+the SPIFFS image directory. Every other known file type is gzipped, named
+after a hash of its content and written to a C source that is linked into
+the firmware, together with a manifest table. References to the original
+names in the pages are rewritten to the hashed URLs, so a changed asset gets
+a new URL and browsers can cache each one forever.
+"""
+
+import argparse
+import gzip
+import hashlib
+import json
+import os
+import re
+import shutil
+
+URL_PREFIX = "/assets/"
+FINGERPRINT_LEN = 8
+ETAG_LEN = 32
+BYTES_PER_LINE = 16
+
+PAGE_EXTENSIONS = {".html"}
+CONTENT_TYPES = {
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+    ".png": "image/png",
+    ".txt": "text/plain",
+}
+
+
+def find_files(source_dir):
+    for root, dirs, files in os.walk(source_dir):
+        dirs.sort()
+        for name in sorted(files):
+            path = os.path.join(root, name)
+            yield os.path.relpath(path, source_dir).replace(os.sep, "/"), path
+
+
+def build_asset(name, path):
+    with open(path, "rb") as f:
+        data = f.read()
+    digest = hashlib.sha256(data).hexdigest()
+    stem, ext = os.path.splitext(name)
+    return {
+        "name": name,
+        "path": f"{URL_PREFIX}{stem}.{digest[:FINGERPRINT_LEN]}{ext}",
+        "content_type": CONTENT_TYPES[ext.lower()],
+        "etag": f'"{digest[:ETAG_LEN]}"',
+        "size": len(data),
+        # fixed mtime so the same input always gives the same image
+        "data": gzip.compress(data, compresslevel=9, mtime=0),
+    }
+
+
+def rewrite_page(text, assets):
+    for asset in assets:
+        pattern = r"""(["'])(?:\./|/)?""" + re.escape(asset["name"]) + r"\1"
+        text = re.sub(pattern, lambda match: match.group(1) + asset["path"] + match.group(1), text)
+    return text
+
+
+def c_string(value):
+    return '"' + value.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def write_source(path, assets):
+    lines = [
+        "// generated by tools/build_assets.py, do not edit",
+        "",
+        '#include "static_assets.h"',
+        "",
+    ]
+    for i, asset in enumerate(assets):
+        data = asset["data"]
+        lines.append(f"static const uint8_t asset_{i}[{len(data)}] = {{")
+        for start in range(0, len(data), BYTES_PER_LINE):
+            chunk = data[start:start + BYTES_PER_LINE]
+            lines.append("    " + ", ".join(f"0x{byte:02x}" for byte in chunk) + ",")
+        lines.append("};")
+        lines.append("")
+
+    lines.append("const struct static_asset static_assets[] = {")
+    for i, asset in enumerate(assets):
+        lines.append("    {")
+        lines.append(f"        .path = {c_string(asset['path'])},")
+        lines.append(f"        .content_type = {c_string(asset['content_type'])},")
+        lines.append(f"        .etag = {c_string(asset['etag'])},")
+        lines.append(f"        .data = asset_{i},")
+        lines.append(f"        .len = sizeof(asset_{i})")
+        lines.append("    },")
+    if not assets:
+        lines.append("    {0}")
+    lines.append("};")
+    lines.append(f"const size_t num_static_assets = {len(assets)};")
+    with open(path, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source_dir", help="filesystem/ in the project")
+    parser.add_argument("spiffs_dir", help="directory the SPIFFS image is built from")
+    parser.add_argument("source", help="C source with the embedded assets")
+    parser.add_argument("manifest", help="JSON manifest of the embedded assets")
+    args = parser.parse_args()
+
+    pages = []
+    assets = []
+    for name, path in find_files(args.source_dir):
+        ext = os.path.splitext(name)[1].lower()
+        if ext in PAGE_EXTENSIONS:
+            pages.append((name, path))
+        elif ext in CONTENT_TYPES:
+            assets.append(build_asset(name, path))
+        else:
+            print(f"build_assets: skipping {name}, unknown type")
+
+    shutil.rmtree(args.spiffs_dir, ignore_errors=True)
+    for name, path in pages:
+        with open(path, encoding="utf-8") as f:
+            text = rewrite_page(f.read(), assets)
+        out_path = os.path.join(args.spiffs_dir, name)
+        os.makedirs(os.path.dirname(out_path), exist_ok=True)
+        with open(out_path, "w", encoding="utf-8") as f:
+            f.write(text)
+
+    write_source(args.source, assets)
+    manifest = [
+        {**{key: asset[key] for key in ("name", "path", "content_type", "etag", "size")}, "gzip_size": len(asset["data"])}
+        for asset in assets
+    ]
+    with open(args.manifest, "w") as f:
+        json.dump(manifest, f, indent=4)
+        f.write("\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,270 @@
+#!/usr/bin/env python3
+"""Load test the web server of a running weather station.
+
+Each path is requested by several concurrent clients for a fixed time, and
+the request rate, p50/p99 latency and the lowest free heap seen in /metrics
+during the run are reported. Results can be saved and later runs compared
+against them, flagging any path that got slower or used more memory. A mixed run then
+requests / while /log.csv is downloaded over and over, for the latency of
+the page during a long download:
+
+    python3 tools/http_bench.py http://192.168.1.20 --output baseline.json
+    python3 tools/http_bench.py http://192.168.1.20 --baseline baseline.json
+
+Against the host build of the server (host_test/sim_http_server) the peak
+resident memory of its process during each path is reported as well, see
+--server-pid.
+"""
+
+import argparse
+import http.client
+import json
+import re
+import sys
+import threading
+import time
+import urllib.parse
+
+DEFAULT_PATHS = ["/", "/api/current", "/api/summary?resolution=hour", "/log.csv", "/metrics"]
+# (path, path downloaded in the background meanwhile)
+MIXED_RUNS = [("/", "/log.csv")]
+MIXED_DOWNLOADS = 1
+HEAP_FREE = re.compile(r"^weather_heap_free_bytes (\d+)$", re.M)
+HEAP_LARGEST = re.compile(r"^weather_heap_largest_free_block_bytes (\d+)$", re.M)
+METRICS_INTERVAL_S = 0.5
+TIMEOUT_S = 30
+
+
+class Connection:
+    def __init__(self, base):
+        self.base = base
+        self.conn = None
+
+    def get(self, path):
+        # keep-alive like a browser, reconnect when the server closed the socket
+        for attempt in range(2):
+            if self.conn is None:
+                self.conn = http.client.HTTPConnection(self.base.hostname, self.base.port or 80, timeout=TIMEOUT_S)
+            try:
+                self.conn.request("GET", path)
+                response = self.conn.getresponse()
+                body = response.read()
+                if response.getheader("Connection", "").lower() == "close":
+                    self.close()
+                return response.status, body
+            except (OSError, http.client.HTTPException):
+                self.close()
+                if attempt == 1:
+                    raise
+
+    def close(self):
+        if self.conn is not None:
+            self.conn.close()
+            self.conn = None
+
+
+def percentile(sorted_values, fraction):
+    if not sorted_values:
+        return None
+    return sorted_values[min(len(sorted_values) - 1, int(fraction * len(sorted_values)))]
+
+
+def watch_heap(base, stop, samples):
+    conn = Connection(base)
+    while not stop.is_set():
+        try:
+            status, body = conn.get("/metrics")
+            text = body.decode("utf-8", "replace")
+            free = HEAP_FREE.search(text)
+            largest = HEAP_LARGEST.search(text)
+            if status == 200 and free and largest:
+                samples.append((int(free.group(1)), int(largest.group(1))))
+        except (OSError, http.client.HTTPException):
+            pass
+        stop.wait(METRICS_INTERVAL_S)
+    conn.close()
+
+
+def run_client(base, path, deadline, latencies, statuses, lock):
+    conn = Connection(base)
+    while time.monotonic() < deadline:
+        start = time.monotonic()
+        try:
+            status, _ = conn.get(path)
+        except (OSError, http.client.HTTPException):
+            status = "error"
+        elapsed = time.monotonic() - start
+        with lock:
+            statuses[status] = statuses.get(status, 0) + 1
+            if status == 200 or status == 304:
+                latencies.append(elapsed)
+        if status == 503:
+            # the worker pool is full, back off the way Retry-After asks instead of hammering it
+            time.sleep(1)
+    conn.close()
+
+
+def reset_peak_rss(pid):
+    # writing 5 to clear_refs resets VmHWM to the current resident size (Linux 4.0 and later)
+    try:
+        with open(f"/proc/{pid}/clear_refs", "w") as f:
+            f.write("5")
+    except OSError:
+        pass
+
+
+def peak_rss_kb(pid):
+    with open(f"/proc/{pid}/status") as f:
+        for line in f:
+            if line.startswith("VmHWM:"):
+                return int(line.split()[1])
+    return None
+
+
+def bench_path(base, path, clients, duration, watch_memory, server_pid=None, during=None):
+    latencies = []
+    statuses = {}
+    lock = threading.Lock()
+    heap = []
+    stop = threading.Event()
+    watcher = None
+    if watch_memory:
+        watcher = threading.Thread(target=watch_heap, args=(base, stop, heap))
+        watcher.start()
+
+    if server_pid is not None:
+        reset_peak_rss(server_pid)
+    deadline = time.monotonic() + duration
+    threads = [
+        threading.Thread(target=run_client, args=(base, path, deadline, latencies, statuses, lock))
+        for _ in range(clients)
+    ]
+    downloads = []
+    if during is not None:
+        # only the latencies of path are reported, the downloads are just counted
+        threads += [
+            threading.Thread(target=run_client, args=(base, during, deadline, downloads, {}, lock))
+            for _ in range(MIXED_DOWNLOADS)
+        ]
+    start = time.monotonic()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.monotonic() - start
+    stop.set()
+    if watcher is not None:
+        watcher.join()
+
+    latencies.sort()
+    result = {
+        "requests": len(latencies),
+        "requests_per_s": len(latencies) / elapsed,
+        "p50_ms": percentile(latencies, 0.50) * 1000 if latencies else None,
+        "p99_ms": percentile(latencies, 0.99) * 1000 if latencies else None,
+        "statuses": {str(status): count for status, count in sorted(statuses.items(), key=str)},
+        "min_heap_free": min((free for free, _ in heap), default=None),
+        "min_heap_largest_block": min((largest for _, largest in heap), default=None),
+        "peak_rss_kb": peak_rss_kb(server_pid) if server_pid is not None else None,
+    }
+    if during is not None:
+        result["during"] = during
+        result["during_requests"] = len(downloads)
+    return result
+
+
+def compare(results, baseline, tolerance):
+    regressions = []
+    # (metric, True when higher is better)
+    checks = [
+        ("requests_per_s", True),
+        ("p50_ms", False),
+        ("p99_ms", False),
+        ("min_heap_free", True),
+        ("peak_rss_kb", False),
+    ]
+    runs = [(section, name, result) for section in ("paths", "mixed") for name, result in results.get(section, {}).items()]
+    for section, path, result in runs:
+        previous = baseline.get(section, {}).get(path)
+        if previous is None:
+            continue
+        for metric, higher_is_better in checks:
+            old = previous.get(metric)
+            new = result.get(metric)
+            if old is None or new is None or old <= 0:
+                continue
+            # how many times worse, so the tolerance means the same for rates and times,
+            # a path that no longer answers at all is infinitely worse
+            if new <= 0:
+                worse = float("inf") if higher_is_better else 0
+            else:
+                worse = old / new if higher_is_better else new / old
+            if worse > 1 + tolerance:
+                regressions.append(f"{path}: {metric} {old:.1f} -> {new:.1f} ({worse:.2f}x worse)")
+    return regressions
+
+
+def print_table(results):
+    print(f"{'path':32} {'req/s':>8} {'p50 ms':>8} {'p99 ms':>8} {'min free':>9} {'largest':>8} {'peak KB':>8}  statuses")
+    for path, result in [*results["paths"].items(), *results.get("mixed", {}).items()]:
+        def field(name, width, fmt):
+            value = result[name]
+            return format(value, f"{width}{fmt}") if value is not None else format("-", f">{width}")
+        print(f"{path:32} {field('requests_per_s', 8, '.1f')} {field('p50_ms', 8, '.1f')} {field('p99_ms', 8, '.1f')} "
+              f"{field('min_heap_free', 9, 'd')} {field('min_heap_largest_block', 8, 'd')} {field('peak_rss_kb', 8, 'd')}"
+              f"  {result['statuses']}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("url", help="base URL of the station, e.g. http://192.168.1.20")
+    parser.add_argument("-p", "--path", action="append", help="path to request, repeatable (default: every endpoint)")
+    parser.add_argument("-c", "--clients", type=int, default=3, help="concurrent clients per path (default 3)")
+    parser.add_argument("-d", "--duration", type=float, default=10, help="seconds per path (default 10)")
+    parser.add_argument("--no-memory", action="store_true", help="don't poll /metrics for the free heap")
+    parser.add_argument("--no-mixed", action="store_true", help="skip requesting / during log downloads")
+    parser.add_argument("-o", "--output", help="save the results as JSON")
+    parser.add_argument("-b", "--baseline", help="earlier results to compare against")
+    parser.add_argument("-t", "--tolerance", type=float, default=0.2,
+                        help="allowed fraction worse before flagging, 1 allows twice as bad (default 0.2)")
+    parser.add_argument("--server-pid", type=int, help="process of a host server to report the peak memory of")
+    args = parser.parse_args()
+
+    base = urllib.parse.urlsplit(args.url)
+    results = {
+        "url": args.url,
+        "clients": args.clients,
+        "duration_s": args.duration,
+        "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        "paths": {},
+        "mixed": {},
+    }
+    for path in args.path or DEFAULT_PATHS:
+        print(f"{path}: {args.clients} clients for {args.duration:g} s", file=sys.stderr)
+        results["paths"][path] = bench_path(base, path, args.clients, args.duration, not args.no_memory, args.server_pid)
+    for path, during in [] if args.no_mixed else MIXED_RUNS:
+        print(f"{path}: {args.clients} clients for {args.duration:g} s during {during}", file=sys.stderr)
+        results["mixed"][f"{path} during {during}"] = bench_path(
+            base, path, args.clients, args.duration, not args.no_memory, args.server_pid, during)
+
+    print_table(results)
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(results, f, indent=4)
+            f.write("\n")
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        if baseline.get("clients") != args.clients or baseline.get("duration_s") != args.duration:
+            print("warning: baseline was run with different clients or duration", file=sys.stderr)
+        regressions = compare(results, baseline, args.tolerance)
+        for regression in regressions:
+            print(f"REGRESSION {regression}")
+        if regressions:
+            sys.exit(1)
+        print("no regressions against", args.baseline)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Convert a trace dump from /api/trace into Chrome trace JSON.
+
+Open the output in chrome://tracing or https://ui.perfetto.dev. The dump is
+read from a file, or fetched when the input is a URL:
+
+    python3 tools/trace_to_chrome.py http://192.168.1.20/api/trace -o trace.json
+"""
+
+import argparse
+import json
+import struct
+import sys
+import urllib.request
+
+MAGIC = b"WSTR"
+VERSION = 1
+EVENT = struct.Struct("<IHBB")
+
+
+def read_names(data, offset, count):
+    names = []
+    for _ in range(count):
+        end = data.index(b"\0", offset)
+        names.append(data[offset:end].decode("utf-8", "replace"))
+        offset = end + 1
+    return names, offset
+
+
+def parse(data):
+    if data[:4] != MAGIC:
+        raise ValueError("not a trace dump")
+    version, cores, num_probes, num_tasks = data[4:8]
+    if version != VERSION:
+        raise ValueError(f"unsupported dump version {version}")
+    (now_us,) = struct.unpack_from("<Q", data, 8)
+    probes, offset = read_names(data, 16, num_probes)
+    tasks, offset = read_names(data, offset, num_tasks)
+
+    events = []
+    for core in range(cores):
+        recorded, count = struct.unpack_from("<II", data, offset)
+        offset += 8
+        if recorded > count:
+            print(f"core {core}: kept the last {count} of {recorded} events", file=sys.stderr)
+        for _ in range(count):
+            time_us, task, probe, phase = EVENT.unpack_from(data, offset)
+            offset += EVENT.size
+            # timestamps are the low 32 bits, count back from the dump time
+            age_us = (now_us - time_us) & 0xFFFFFFFF
+            events.append((now_us - age_us, core, task, probe, phase))
+    # stable, so events of one core keep their recorded order when timestamps tie
+    events.sort(key=lambda event: event[0])
+    return probes, tasks, events
+
+
+def to_chrome(probes, tasks, events):
+    trace = []
+    for number, name in enumerate(tasks, 1):
+        trace.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": number, "args": {"name": name}})
+    trace.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": 0, "args": {"name": "untracked tasks"}})
+
+    # an end whose begin was overwritten would close the wrong slice
+    open_slices = {}
+    for time_us, core, task, probe, phase in events:
+        key = (task, probe)
+        if phase:
+            open_slices[key] = open_slices.get(key, 0) + 1
+        elif open_slices.get(key, 0) > 0:
+            open_slices[key] -= 1
+        else:
+            continue
+        name = probes[probe] if probe < len(probes) else f"probe {probe}"
+        trace.append({
+            "name": name,
+            "ph": "B" if phase else "E",
+            "ts": time_us,
+            "pid": 0,
+            "tid": task,
+            "args": {"core": core},
+        })
+    return {"traceEvents": trace, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="dump file or URL of /api/trace")
+    parser.add_argument("-o", "--output", help="output file, stdout by default")
+    args = parser.parse_args()
+
+    if args.input.startswith(("http://", "https://")):
+        with urllib.request.urlopen(args.input) as response:
+            data = response.read()
+    else:
+        with open(args.input, "rb") as f:
+            data = f.read()
+
+    trace = to_chrome(*parse(data))
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()